@@ -51,6 +51,9 @@ two phases. It is likely to screw up non-linear phase filter analysis.
 The -w option runs the response through smoothresponse with the given width
 before drawing. It is incompatible with phase mode.
 
+Without -f, -p, -w or -L, the graph is drawn by mkfilter --plot itself and
+gnuplot isn't needed.
+
 EOF
 }
 
@@ -88,15 +91,38 @@ die "Need input file(s)\n" unless @inputs;
 die "Mode must be either 'magnitude' or 'phase'.\n" unless $mode =~ /^(magnitude|phase)$/;
 die "Phase mode is incompatible with smoothing.\n" if $mode eq 'phase' and $smooth;
 
+# mkfilter draws the default view itself, without gnuplot
+if ( not exists $opts{'f'} and not exists $opts{'p'} and not $smooth and not $linearkill ) {
+    exec 'mkfilter', "--analyze-factor=$analyzefactor", "--plot=$outfile", "--plot-mode=$mode",
+        "--plot-size=$size", '--', @inputs;
+    die "Couldn't run mkfilter: $!\n";
+}
+
+# without smoothing, one mkfilter run analyzes every input, giving a pair of
+# columns per file
+my @perfile;
+if ( $smooth ) {
+    @perfile = map {
+            my @lines = grep { $_ =~ /^[\d\.]/ } (`mkfilter --analyze --analyzefactor=\Q$analyzefactor\E \Q$_\E | smoothresponse -w \Q$smooth\E`);
+            die "Couldn't analyze $_, mkfilter exited with status $?" if $?;
+            \@lines;
+        } @inputs;
+} else {
+    my $files = join ' ', map { "\Q$_\E" } @inputs;
+    my @lines = grep { $_ =~ /^[\d\.]/ } (`mkfilter --analyze --analyzefactor=\Q$analyzefactor\E -- $files`);
+    die "Couldn't analyze @inputs, mkfilter exited with status $?" if $?;
+    @perfile = map {
+            my $i = $_;
+            [ map { my @f = split /\s+/; "$f[0]\t$f[1+2*$i]\t$f[2+2*$i]\n" } @lines ];
+        } 0..$#inputs;
+}
+
 my @data = map {
-        my $smoothpipe = $smooth ? "| smoothresponse -w \Q$smooth\E" : "";
-        my @lines = grep { $_ =~ /^[\d\.]/ } (`mkfilter --analyze --analyzefactor=\Q$analyzefactor\E \Q$_\E $smoothpipe`);
-        die "Couldn't analyze $_, mkfilter exited with status $?" if $?;
+        my @lines = @$_;
         if ( $linearkill ) {
             my $b =  ($lines[0] =~ /\s([\d\.eE]+)\s*$/)[0];
             my $m = (($lines[1] =~ /\s([\d\.eE]+)\s*$/)[0]-$b);
             die unless defined $b and defined $m;
-            my @newlines = ();
             my $at = 0;
             for my $l ( @lines ) {
                 my @f = split /\s+/, $l, 3;
@@ -106,7 +132,7 @@ my @data = map {
             }
         }
         join '', @lines;
-    } @inputs;
+    } @perfile;
 
 $size =~ s/x/,/;
 
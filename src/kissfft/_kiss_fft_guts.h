@@ -25,10 +25,26 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
  4*4*4*2
  */
 
+/* transforms at least this long are done with the cache-blocked six-step
+   algorithm (see kf_sixstep) instead of the plain recursive kf_work */
+#ifndef KISS_FFT_SIXSTEP_MIN
+#define KISS_FFT_SIXSTEP_MIN (1<<18)
+#endif
+
+/* edge length of the square tiles used by the six-step transposes */
+#ifndef KISS_FFT_TRANSPOSE_BLOCK
+#define KISS_FFT_TRANSPOSE_BLOCK 32
+#endif
+
 struct kiss_fft_state{
     int nfft;
     int inverse;
     int factors[2*MAXFACTORS];
+    /* six-step split nfft = n1*n2 with its two sub-transforms, n1 == 0 if unused */
+    int n1;
+    int n2;
+    struct kiss_fft_state * sub1;
+    struct kiss_fft_state * sub2;
     kiss_fft_cpx twiddles[1];
 };
 
@@ -14,6 +14,9 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 
 #include "_kiss_fft_guts.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 /* The guts header contains all the multiplication and addition macros that are defined for
  fixed or floating point complex numbers.  It also delares the kf_ internal functions.
  */
@@ -251,8 +254,11 @@ void kf_work(
 
 #ifdef _OPENMP
     // use openmp extensions at the 
-    // top-level (not recursive)
-    if (fstride==1 && p<=5)
+    // top-level (not recursive), unless this is already one of the
+    // sub-transforms of a parallel six-step pass. a single radix
+    // (m==1) has no sub-transforms to split, and recursing would run
+    // off the end of the factors
+    if (fstride==1 && p<=5 && m>1 && !omp_in_parallel())
     {
         int k;
 
@@ -301,6 +307,133 @@ void kf_work(
     }
 }
 
+/*
+ * Six-step FFT for transforms too large to stay in cache.
+ *
+ * With nfft = n1*n2 the input is viewed as an n1 x n2 matrix. It is
+ * transposed, the n2 rows of length n1 are transformed and multiplied by the
+ * twiddles w^(j2*k1), the result is transposed again, the n1 rows of length
+ * n2 are transformed, and a final transpose puts the bins in natural order.
+ * Every sub-transform is roughly sqrt(nfft) long and works on contiguous
+ * memory, and the transposes walk the matrix in cache-sized tiles, so the
+ * whole transform makes a handful of streaming passes over memory instead of
+ * the log(nfft) strided passes of the plain recursion.
+ */
+
+/* largest divisor n1 <= sqrt(n), or 0 when n is too small (or splits too
+   unevenly) for the six-step path to pay off */
+static
+int kf_sixstep_split(int n)
+{
+    int n1;
+    if (n < KISS_FFT_SIXSTEP_MIN)
+        return 0;
+    for (n1 = (int)floor(sqrt((double)n)); n1 > 1; --n1)
+        if (n % n1 == 0)
+            break;
+    if (n1 < 64)
+        return 0;
+    return n1;
+}
+
+/* dst (cols x rows) = transpose of src (rows x cols, elements in_stride apart) */
+static
+void kf_transpose(kiss_fft_cpx * dst, const kiss_fft_cpx * src, int rows, int cols, int in_stride)
+{
+    const int b = KISS_FFT_TRANSPOSE_BLOCK;
+    int i0,j0,i,j,imax,jmax;
+
+#ifdef _OPENMP
+#   pragma omp parallel for private(j0,i,j,imax,jmax)
+#endif
+    for (i0=0; i0<rows; i0+=b) {
+        imax = i0+b < rows ? i0+b : rows;
+        for (j0=0; j0<cols; j0+=b) {
+            jmax = j0+b < cols ? j0+b : cols;
+            for (i=i0; i<imax; ++i)
+                for (j=j0; j<jmax; ++j)
+                    dst[(size_t)j*rows + i] = src[((size_t)i*cols + j)*in_stride];
+        }
+    }
+}
+
+/* transform each of the rows (of length st->nfft) of buf in place */
+static
+void kf_rows(kiss_fft_cpx * buf, int rows, const kiss_fft_cfg st)
+{
+    const int len = st->nfft;
+    int r;
+
+#ifdef _OPENMP
+#   pragma omp parallel private(r)
+#endif
+    {
+        kiss_fft_cpx * rowbuf = (kiss_fft_cpx*)KISS_FFT_TMP_ALLOC(sizeof(kiss_fft_cpx)*len);
+#ifdef _OPENMP
+#       pragma omp for
+#endif
+        for (r=0; r<rows; ++r) {
+            kf_work(rowbuf, buf + (size_t)r*len, 1, 1, st->factors, st);
+            memcpy(buf + (size_t)r*len, rowbuf, sizeof(kiss_fft_cpx)*len);
+        }
+        KISS_FFT_TMP_FREE(rowbuf);
+    }
+}
+
+static
+void kf_sixstep(const kiss_fft_cfg st, const kiss_fft_cpx * fin, kiss_fft_cpx * fout, int in_stride)
+{
+    const int n1 = st->n1;
+    const int n2 = st->n2;
+    kiss_fft_cpx * buf = (kiss_fft_cpx*)KISS_FFT_TMP_ALLOC(sizeof(kiss_fft_cpx)*st->nfft);
+    int j2,k1;
+
+    kf_transpose(buf, fin, n1, n2, in_stride);
+
+    /* rows of buf are now the length-n1 columns of the input. fout is free
+       at this point, so transform out of place into it and apply the
+       twiddles while each row is still in cache.
+
+       Walking the twiddle table at stride j2 would miss the cache on nearly
+       every element, so w^(j2*k1) is split as w^(j2*a*B) * w^(j2*b) with
+       k1 = a*B + b, and only B + n1/B entries are fetched per row. */
+#ifdef _OPENMP
+#   pragma omp parallel private(j2,k1)
+#endif
+    {
+        const int B = KISS_FFT_TRANSPOSE_BLOCK;
+        kiss_fft_cpx * lo = (kiss_fft_cpx*)KISS_FFT_TMP_ALLOC(sizeof(kiss_fft_cpx)*B);
+        kiss_fft_cpx hi,tw,t;
+        int a,b;
+
+#ifdef _OPENMP
+#       pragma omp for
+#endif
+        for (j2=0; j2<n2; ++j2) {
+            kiss_fft_cpx * row = fout + (size_t)j2*n1;
+            kf_work(row, buf + (size_t)j2*n1, 1, 1, st->sub1->factors, st->sub1);
+
+            for (b=0; b<B; ++b)
+                lo[b] = st->twiddles[(size_t)j2*b];
+            for (k1=0, a=0; k1<n1; ++a) {
+                hi = st->twiddles[(size_t)j2*a*B];
+                for (b=0; b<B && k1<n1; ++b, ++k1) {
+                    C_MUL(tw, hi, lo[b]);
+                    C_MUL(t, row[k1], tw);
+                    row[k1] = t;
+                }
+            }
+        }
+        KISS_FFT_TMP_FREE(lo);
+    }
+
+    kf_transpose(buf, fout, n2, n1, 1);
+    kf_rows(buf, n1, st->sub2);
+    kf_transpose(fout, buf, n1, n2, 1);
+
+    KISS_FFT_TMP_FREE(buf);
+}
+
 /*  facbuf is populated by p1,m1,p2,m2, ...
     where 
     p[i] * m[i] = m[i-1]
@@ -329,6 +462,50 @@ void kf_factor(int n,int * facbuf)
     } while (n > 1);
 }
 
+static kiss_fft_table_source table_source = NULL;
+
+void kiss_fft_set_table_source(kiss_fft_table_source source)
+{
+    table_source = source;
+}
+
+size_t kiss_fft_table_len(int kind, int nfft)
+{
+    return kind == KISS_SUPER_TWIDDLES ? nfft/4 : nfft;
+}
+
+void kiss_fft_compute_table(int kind, int nfft, int inverse, kiss_fft_cpx *out)
+{
+    int i;
+    if (kind == KISS_SUPER_TWIDDLES) {
+        int ncfft = nfft/2;
+        for (i = 0; i < ncfft/2; ++i) {
+            double phase =
+                -3.14159265358979323846264338327 * ((double) (i+1) / ncfft + .5);
+            if (inverse)
+                phase *= -1;
+            kf_cexp (out+i,phase);
+        }
+    } else {
+        for (i=0;i<nfft;++i) {
+            const double pi=3.141592653589793238462643383279502884197169399375105820974944;
+            double phase = -2*pi*i / nfft;
+            if (inverse)
+                phase *= -1;
+            kf_cexp(out+i, phase );
+        }
+    }
+}
+
+const kiss_fft_cpx *kiss_fft_table(int kind, int nfft, int inverse, kiss_fft_cpx *buf)
+{
+    const kiss_fft_cpx *table = table_source ? table_source(kind, nfft, inverse) : NULL;
+    if (table)
+        return table;
+    kiss_fft_compute_table(kind, nfft, inverse, buf);
+    return buf;
+}
+
 /*
  *
  * User-callable function to allocate all necessary storage space for the fft.
@@ -341,6 +518,17 @@ kiss_fft_cfg kiss_fft_alloc(int nfft,int inverse_fft,void * mem,size_t * lenmem
     kiss_fft_cfg st=NULL;
     size_t memneeded = sizeof(struct kiss_fft_state)
         + sizeof(kiss_fft_cpx)*(nfft-1); /* twiddle factors*/
+    const int n1 = kf_sixstep_split(nfft);
+    size_t offset1=0,offset2=0,len1=0,len2=0;
+
+    if (n1) {
+        /* the two sub-transform states live just past the twiddles */
+        kiss_fft_alloc(n1, inverse_fft, NULL, &len1);
+        kiss_fft_alloc(nfft/n1, inverse_fft, NULL, &len2);
+        offset1 = (memneeded + 15) & ~(size_t)15;
+        offset2 = (offset1 + len1 + 15) & ~(size_t)15;
+        memneeded = offset2 + len2;
+    }
 
     if ( lenmem==NULL ) {
         st = ( kiss_fft_cfg)KISS_FFT_MALLOC( memneeded );
@@ -350,19 +538,23 @@ kiss_fft_cfg kiss_fft_alloc(int nfft,int inverse_fft,void * mem,size_t * lenmem
         *lenmem = memneeded;
     }
     if (st) {
-        int i;
+        const kiss_fft_cpx *tw;
         st->nfft=nfft;
         st->inverse = inverse_fft;
 
-        for (i=0;i<nfft;++i) {
-            const double pi=3.141592653589793238462643383279502884197169399375105820974944;
-            double phase = -2*pi*i / nfft;
-            if (st->inverse)
-                phase *= -1;
-            kf_cexp(st->twiddles+i, phase );
-        }
+        tw = kiss_fft_table(KISS_TWIDDLES, nfft, inverse_fft, st->twiddles);
+        if (tw != st->twiddles)
+            memcpy(st->twiddles, tw, sizeof(kiss_fft_cpx)*nfft);
 
         kf_factor(nfft,st->factors);
+
+        st->n1 = n1;
+        st->n2 = n1 ? nfft/n1 : 0;
+        st->sub1 = st->sub2 = NULL;
+        if (n1) {
+            st->sub1 = kiss_fft_alloc(n1, inverse_fft, (char*)st + offset1, &len1);
+            st->sub2 = kiss_fft_alloc(nfft/n1, inverse_fft, (char*)st + offset2, &len2);
+        }
     }
     return st;
 }
@@ -370,7 +562,11 @@ kiss_fft_cfg kiss_fft_alloc(int nfft,int inverse_fft,void * mem,size_t * lenmem
 
 void kiss_fft_stride(kiss_fft_cfg st,const kiss_fft_cpx *fin,kiss_fft_cpx *fout,int in_stride)
 {
-    if (fin == fout) {
+    if (st->n1) {
+        // the six-step path never reads fin after its first pass, so it
+        // handles fin == fout without the extra copy below
+        kf_sixstep(st,fin,fout,in_stride);
+    }else if (fin == fout) {
         //NOTE: this is not really an in-place FFT algorithm.
         //It just performs an out-of-place FFT into a temp buffer
         kiss_fft_cpx * tmpbuf = (kiss_fft_cpx*)KISS_FFT_TMP_ALLOC( sizeof(kiss_fft_cpx)*st->nfft);
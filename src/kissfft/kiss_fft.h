@@ -117,6 +117,30 @@ int kiss_fft_next_fast_size(int n);
 #define kiss_fftr_next_fast_size_real(n) \
         (kiss_fft_next_fast_size( ((n)+1)>>1)<<1)
 
+/*
+ * The tables kiss_fft_alloc and kiss_fftr_alloc compute with a cos and sin
+ * per entry: KISS_TWIDDLES is the nfft values e^(-+2 pi i k/nfft), and
+ * KISS_SUPER_TWIDDLES the nfft/4 values kiss_fftr uses to split a real
+ * transform of length nfft.
+ */
+#define KISS_TWIDDLES 1
+#define KISS_SUPER_TWIDDLES 2
+
+size_t kiss_fft_table_len(int kind, int nfft);
+void kiss_fft_compute_table(int kind, int nfft, int inverse, kiss_fft_cpx *out);
+
+/*
+ * An optional source of precomputed tables, such as ones loaded from a file.
+ * It returns exactly what kiss_fft_compute_table would, or NULL to have it
+ * computed. Set it before any plans are made; it may be called from several
+ * threads at once.
+ */
+typedef const kiss_fft_cpx *(*kiss_fft_table_source)(int kind, int nfft, int inverse);
+void kiss_fft_set_table_source(kiss_fft_table_source source);
+
+/* the table from the source, or else computed into buf */
+const kiss_fft_cpx *kiss_fft_table(int kind, int nfft, int inverse, kiss_fft_cpx *buf);
+
 #ifdef __cplusplus
 } 
 #endif
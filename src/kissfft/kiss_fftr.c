@@ -26,8 +26,8 @@ struct kiss_fftr_state{
 
 kiss_fftr_cfg kiss_fftr_alloc(int nfft,int inverse_fft,void * mem,size_t * lenmem)
 {
-    int i;
     kiss_fftr_cfg st = NULL;
+    const kiss_fft_cpx *tw;
     size_t subsize, memneeded;
 
     if (nfft & 1) {
@@ -54,13 +54,9 @@ kiss_fftr_cfg kiss_fftr_alloc(int nfft,int inverse_fft,void * mem,size_t * lenme
     st->super_twiddles = st->tmpbuf + nfft;
     kiss_fft_alloc(nfft, inverse_fft, st->substate, &subsize);
 
-    for (i = 0; i < nfft/2; ++i) {
-        double phase =
-            -3.14159265358979323846264338327 * ((double) (i+1) / nfft + .5);
-        if (inverse_fft)
-            phase *= -1;
-        kf_cexp (st->super_twiddles+i,phase);
-    }
+    tw = kiss_fft_table(KISS_SUPER_TWIDDLES, nfft*2, inverse_fft, st->super_twiddles);
+    if (tw != st->super_twiddles)
+        memcpy(st->super_twiddles, tw, sizeof(kiss_fft_cpx)*(nfft/2));
     return st;
 }
 
@@ -16,42 +16,293 @@
  */
 
 #include "analyze.h"
+#include "jobs.h"
+#include "fir.h"
+#include "file.h"
+#include "czt.h"
 
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
 
 #define PI 3.1415926535897932384626433832795028841971693993
 
-void analyze_filter(audiobuf *buf, FILE *fh, int analyzefactor) {
+static int analyze_size(audiobuf *buf, int analyzefactor) {
     int wantsize = 1 << (int)(ceil(log2(buf->len))+analyzefactor);
     if ( wantsize < 1<<14 )
         wantsize = 1<<14;
+    return wantsize;
+}
+
+static void unwrap_phase(float *phase, int bins) {
+    float lastphase = 0;
+    float runningphase = 0;
+    for (int i = 0; i < bins; i++) {
+        float phasediff = phase[i] - lastphase;
+        while ( phasediff >  PI ) phasediff -= 2*PI;
+        while ( phasediff < -PI ) phasediff += 2*PI;
+        runningphase += phasediff;
+        lastphase = phase[i];
+        phase[i] = runningphase;
+    }
+}
 
+// magnitude and unwrapped phase of the first size/2 bins of buf padded to size
+static void response(audiobuf *buf, int size, float *mag, float *phase) {
     convert_buf(buf, audiobuf_td);
-    expand_buf(buf, wantsize);
+    expand_buf(buf, size);
     convert_buf(buf, audiobuf_fd);
 
-    fprintf(fh, "# SAMPLERATE=%d\n", buf->sr);
-    fprintf(fh, "# frequency magnitude phase\n\n");
+    int bins = buf->len/2;
 
-    float lastphase = 0;
-    float runningphase = 0;
-    for (int i = 0; i < buf->len/2; i++) {
-        float freq = buf->sr*(float)i/(buf->len);
+    // to polar
+    PARALLEL_FOR
+    for (int i = 0; i < bins; i++) {
         float real = buf->fd[i*2];
         float imag = buf->fd[i*2+1];
+        mag[i] = sqrtf(real*real + imag*imag);
+        phase[i] = atan2f(real, imag);
+    }
 
-        // to polar
-        float mag = sqrtf(real*real + imag*imag);
-        float arg = atan2f(real, imag);
+    unwrap_phase(phase, bins);
+}
 
-        // unwrap phase
-        float phasediff = arg - lastphase;
-        while ( phasediff >  PI ) phasediff -= 2*PI;
-        while ( phasediff < -PI ) phasediff += 2*PI;
-        runningphase += phasediff;
-        lastphase = arg;
+// magnitude and unwrapped phase on the zoomed band
+static void response_zoom(audiobuf *buf, analyze_range *range, float *mag, float *phase) {
+    int len = fir_length(buf);
+    int bins = range->points;
+    double step = (range->to - range->from) / (bins-1);
+
+    fft_cpx *z;
+    if ( (z = malloc(sizeof(fft_cpx)*bins)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for zoomed response", sizeof(fft_cpx)*bins);
+
+    czt(buf->td, len, range->from, step, buf->sr, bins, z);
 
-        fprintf(fh, "%.14f\t%.14f\t%.14f\n", freq, mag, runningphase);
+    // same conventions as the full spectrum
+    for (int i = 0; i < bins; i++) {
+        mag[i] = sqrtf(z[i].r*z[i].r + z[i].i*z[i].i);
+        phase[i] = atan2f(z[i].r, z[i].i);
     }
+    unwrap_phase(phase, bins);
+
+    free(z);
 }
 
+/*
+ * The ramp is taken around the energy centroid so its product with h stays
+ * small, which keeps float precision for long filters. Rounding to half
+ * samples keeps linear phase filters centered exactly.
+ */
+static float delay_center(audiobuf *buf, int len) {
+    double energy = 0;
+    double moment = 0;
+    for (int i = 0; i < len; i++) {
+        energy += (double)buf->td[i]*buf->td[i];
+        moment += (double)i*buf->td[i]*buf->td[i];
+    }
+    return energy > 0 ? round(2*moment/energy) / 2 : 0;
+}
+
+// magnitude and group delay in samples of the first size/2 bins
+static void group_delay(audiobuf *buf, int size, float *mag, float *delay) {
+    int len = fir_length(buf);
+    float center = delay_center(buf, len);
+
+    fft_cpx *z;
+    if ( (z = malloc(sizeof(fft_cpx)*size)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for group delay transform", sizeof(fft_cpx)*size);
+
+    PARALLEL_FOR
+    for (int i = 0; i < size; i++) {
+        z[i].r = i < len ? buf->td[i] : 0;
+        z[i].i = i < len ? (i-center)*buf->td[i] : 0;
+    }
+
+    fft(size, false, z, z);
+
+    // with Z = H + iG for real h and g = (n-center) h,
+    // H[k] = (Z[k] + conj(Z[-k]))/2 and G[k] = (Z[k] - conj(Z[-k]))/2i
+    PARALLEL_FOR
+    for (int i = 0; i < size/2; i++) {
+        fft_cpx a = z[i];
+        fft_cpx b = z[i ? size-i : 0];
+        double hr = (a.r + b.r) / 2;
+        double hi = (a.i - b.i) / 2;
+        double gr = (a.i + b.i) / 2;
+        double gi = (b.r - a.r) / 2;
+
+        double power = hr*hr + hi*hi;
+        mag[i] = sqrt(power);
+        delay[i] = power > 0 ? center + (gr*hr + gi*hi) / power : NAN;
+    }
+
+    free(z);
+}
+
+// the zoomed group delay, with H and G as separate transforms since the
+// band has no mirror image to split Z = H + iG with
+static void group_delay_zoom(audiobuf *buf, analyze_range *range, float *mag, float *delay) {
+    int len = fir_length(buf);
+    float center = delay_center(buf, len);
+    int bins = range->points;
+    double step = (range->to - range->from) / (bins-1);
+
+    float *ramp;
+    fft_cpx *h, *g;
+    if ( (ramp = malloc(sizeof(float)*(len ? len : 1))) == NULL )
+        err(1, "Couldn't allocate %zu bytes for group delay ramp", sizeof(float)*len);
+    if ( (h = malloc(sizeof(fft_cpx)*bins)) == NULL || (g = malloc(sizeof(fft_cpx)*bins)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for zoomed group delay", sizeof(fft_cpx)*bins*2);
+
+    for (int i = 0; i < len; i++)
+        ramp[i] = (i-center)*buf->td[i];
+
+    czt(buf->td, len, range->from, step, buf->sr, bins, h);
+    czt(ramp, len, range->from, step, buf->sr, bins, g);
+
+    for (int i = 0; i < bins; i++) {
+        double power = (double)h[i].r*h[i].r + (double)h[i].i*h[i].i;
+        mag[i] = sqrt(power);
+        delay[i] = power > 0 ? center + ((double)g[i].r*h[i].r + (double)g[i].i*h[i].i) / power : NAN;
+    }
+
+    free(ramp);
+    free(h);
+    free(g);
+}
+
+static void analyze_columns(audiobuf *buf, int size, enum analyze_mode mode, analyze_range *range, float *mag, float *other) {
+    if ( range ) {
+        convert_buf(buf, audiobuf_td);
+        if ( mode == analyze_group_delay )
+            group_delay_zoom(buf, range, mag, other);
+        else
+            response_zoom(buf, range, mag, other);
+    } else if ( mode == analyze_group_delay ) {
+        group_delay(buf, size, mag, other);
+    } else {
+        response(buf, size, mag, other);
+    }
+}
+
+static analysis *alloc_analysis(int ct, int bins, int sr, enum analyze_mode mode) {
+    analysis *a;
+    if ( (a = malloc(sizeof(analysis))) == NULL )
+        err(1, "Couldn't allocate space for analysis");
+
+    a->ct = ct;
+    a->bins = bins;
+    a->sr = sr;
+    a->mode = mode;
+    a->zoom = false;
+    a->from = 0;
+    a->step = sr / (2.0*bins);
+
+    size_t bytes = sizeof(float)*bins*ct;
+    if ( (a->mag = malloc(bytes)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for magnitudes", bytes);
+    if ( (a->other = malloc(bytes)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for phases", bytes);
+
+    return a;
+}
+
+static analysis *alloc_zoom_analysis(int ct, int sr, enum analyze_mode mode, analyze_range *range) {
+    if ( range->from < 0 || range->to <= range->from || range->to > sr/2.0 || range->points < 2 )
+        errx(1, "Analysis range %g:%g with %d points doesn't fit in 0:%g", range->from, range->to, range->points, sr/2.0);
+
+    analysis *a = alloc_analysis(ct, range->points, sr, mode);
+    a->zoom = true;
+    a->from = range->from;
+    a->step = (range->to - range->from) / (range->points-1);
+    return a;
+}
+
+analysis *analyze_buf(audiobuf *buf, int analyzefactor, enum analyze_mode mode, analyze_range *range) {
+    if ( range ) {
+        analysis *a = alloc_zoom_analysis(1, buf->sr, mode, range);
+        analyze_columns(buf, 0, mode, range, a->mag, a->other);
+        return a;
+    }
+
+    int size = analyze_size(buf, analyzefactor);
+    analysis *a = alloc_analysis(1, size/2, buf->sr, mode);
+    analyze_columns(buf, size, mode, NULL, a->mag, a->other);
+    return a;
+}
+
+analysis *analyze_bufs(audiobuf **bufs, int ct, int analyzefactor, enum analyze_mode mode, analyze_range *range) {
+    // one size for all so the rows line up
+    int size = 0;
+    for (int f = 0; f < ct; f++) {
+        if ( bufs[f]->sr != bufs[0]->sr )
+            errx(1, "Sample rate %d of filter %d does not match %d of filter 1", bufs[f]->sr, f+1, bufs[0]->sr);
+        if ( size < analyze_size(bufs[f], analyzefactor) )
+            size = analyze_size(bufs[f], analyzefactor);
+    }
+
+    analysis *a = range ? alloc_zoom_analysis(ct, bufs[0]->sr, mode, range)
+                        : alloc_analysis(ct, size/2, bufs[0]->sr, mode);
+
+    // whole filters per thread; the loops inside run serially
+    PARALLEL_FOR
+    for (int f = 0; f < ct; f++)
+        analyze_columns(bufs[f], size, mode, range, a->mag+(size_t)f*a->bins, a->other+(size_t)f*a->bins);
+
+    return a;
+}
+
+analysis *analyze_paths(char **paths, int ct, int analyzefactor, enum analyze_mode mode, analyze_range *range) {
+    audiobuf **bufs;
+    if ( (bufs = malloc(sizeof(audiobuf*)*ct)) == NULL )
+        err(1, "Couldn't allocate space for input buffers");
+
+    PARALLEL_FOR
+    for (int f = 0; f < ct; f++)
+        bufs[f] = read_file(paths[f]);
+
+    for (int f = 0; f < ct; f++)
+        if ( bufs[f]->sr != bufs[0]->sr )
+            errx(1, "Sample rate %d of %s does not match %d of %s", bufs[f]->sr, paths[f], bufs[0]->sr, paths[0]);
+
+    analysis *a = analyze_bufs(bufs, ct, analyzefactor, mode, range);
+
+    for (int f = 0; f < ct; f++)
+        free_buf(bufs[f]);
+    free(bufs);
+
+    return a;
+}
+
+void print_analysis(analysis *a, char **names, FILE *fh) {
+    char *other = a->mode == analyze_group_delay ? "groupdelay" : "phase";
+    int bins = a->bins;
+
+    fprintf(fh, "# SAMPLERATE=%d\n", a->sr);
+    if ( a->ct == 1 && !names ) {
+        fprintf(fh, "# frequency magnitude %s\n", other);
+    } else {
+        fprintf(fh, "# column 1: frequency\n");
+        for (int f = 0; f < a->ct; f++)
+            fprintf(fh, "# columns %d,%d: %s magnitude %s\n", f*2+2, f*2+3, names[f], other);
+    }
+    fprintf(fh, "\n");
+
+    for (int i = 0; i < bins; i++) {
+        if ( a->zoom )
+            fprintf(fh, "%.14f", a->from + i*a->step);
+        else
+            fprintf(fh, "%.14f", a->sr*(float)i/(bins*2));
+        for (int f = 0; f < a->ct; f++)
+            fprintf(fh, "\t%.14f\t%.14f", a->mag[(size_t)f*bins+i], a->other[(size_t)f*bins+i]);
+        fprintf(fh, "\n");
+    }
+}
+
+void free_analysis(analysis *a) {
+    free(a->mag);
+    free(a->other);
+    free(a);
+}
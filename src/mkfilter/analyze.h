@@ -21,8 +21,57 @@
 #include "audiobuf.h"
 
 #include <stdio.h>
+#include <stdbool.h>
 
-void analyze_filter(audiobuf *buf, FILE *fh, int analyzefactor);
+enum analyze_mode {
+    analyze_response,   // magnitude and unwrapped phase
+    analyze_group_delay // magnitude and group delay in samples
+};
+
+// a band to zoom in on: points frequencies from from to to inclusive
+typedef struct analyze_range {
+    double from, to;
+    int points;
+} analyze_range;
+
+// spectra of one or more filters, bin i being at sr*i/(bins*2), or with
+// zoom at from + i*step
+typedef struct analysis {
+    int ct;       // number of filters
+    int bins;
+    int sr;
+    enum analyze_mode mode;
+    bool zoom;
+    double from, step;
+    float *mag;   // ct*bins magnitudes, one filter after another
+    float *other; // likewise, unwrapped phases or group delays
+} analysis;
+
+/*
+ * Group delay is computed as Re(FFT(n h[n]) / FFT(h[n])), with both transforms
+ * done as one complex FFT of h[n] + i n h[n]. It needs no phase unwrapping;
+ * bins where the response is exactly zero have no group delay and are nan.
+ *
+ * With a range, the spectrum is only taken on that band with the chirp-Z
+ * transform (see czt.h) instead of the full FFT, which gives any resolution
+ * there without the cost of the rest of the spectrum. analyzefactor is
+ * unused then.
+ */
+analysis *analyze_buf(audiobuf *buf, int analyzefactor, enum analyze_mode mode, analyze_range *range);
+
+// reads and analyzes many filter files in parallel, padding all of them to
+// the analysis size of the longest. they must share a sample rate.
+analysis *analyze_paths(char **paths, int ct, int analyzefactor, enum analyze_mode mode, analyze_range *range);
+
+// the same for filters already in memory, such as crossover bands. the
+// buffers are padded and left in the frequency domain (with a range, in the
+// time domain).
+analysis *analyze_bufs(audiobuf **bufs, int ct, int analyzefactor, enum analyze_mode mode, analyze_range *range);
+
+// a table of the frequency, then magnitude and phase (or group delay) column
+// pairs per filter. with names NULL, a single filter gets the plain header.
+void print_analysis(analysis *a, char **names, FILE *fh);
+void free_analysis(analysis *a);
 
 #endif
 
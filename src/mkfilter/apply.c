@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "apply.h"
+#include "fir.h"
+#include "tools.h"
+#include "jobs.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+static void apply_with_fir(audiobuf *filter, float *in, float *out, int frames, int outframes, int channels) {
+    fir *f = fir_alloc(filter, channels);
+
+    fir_process(f, in, out, frames);
+
+    // run zeros through to flush the tail
+    float *tail;
+    size_t tailsize = sizeof(float)*(outframes-frames)*channels;
+    if ( (tail = calloc(1, tailsize)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for filter tail", tailsize);
+    fir_process(f, tail, tail, outframes-frames);
+    memcpy(out+(size_t)frames*channels, tail, tailsize);
+    free(tail);
+
+    fir_free(f);
+}
+
+static void apply_with_fixedfir(int32_t *fixed, int bits, float *in, float *out, int frames, int outframes, int channels) {
+    fixedfir *f = fixedfir_alloc(fixed, outframes-frames+1, bits, channels);
+
+    fixedfir_process(f, in, out, frames);
+
+    float *tail;
+    size_t tailsize = sizeof(float)*(outframes-frames)*channels;
+    if ( (tail = calloc(1, tailsize)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for filter tail", tailsize);
+    fixedfir_process(f, tail, tail, outframes-frames);
+    memcpy(out+(size_t)frames*channels, tail, tailsize);
+    free(tail);
+
+    fixedfir_free(f);
+}
+
+static void apply_with_convolve(audiobuf *filter, float *in, float *out, int frames, int outframes, int channels) {
+    audiobuf chan;
+    chan.fd = NULL;
+    chan.len = frames;
+    chan.type = audiobuf_td;
+    chan.sr = filter->sr;
+    if ( (chan.td = malloc(sizeof(float)*frames)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for input channel", sizeof(float)*frames);
+
+    for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < frames; i++)
+            chan.td[i] = in[(size_t)i*channels+c];
+
+        audiobuf *res = convolve(&chan, filter);
+        for (int i = 0; i < outframes; i++)
+            out[(size_t)i*channels+c] = res->td[i];
+        free_buf(res);
+    }
+
+    free(chan.td);
+}
+
+void apply_file(audiobuf *filter, char *inpath, char *outpath, enum file_format format, enum apply_method method,
+                int32_t *fixed, enum quantize_mode quantize) {
+    int frames, channels, sr;
+    float *in = read_frames(inpath, &frames, &channels, &sr);
+
+    if ( sr != filter->sr )
+        fprintf(stderr, "mkfilter: WARNING: Filter sample rate %d does not match %d of %s.\n", filter->sr, sr, inpath);
+
+    int taps = fir_length(filter);
+    int outframes = frames + taps - 1;
+
+    float *out;
+    size_t outsize = sizeof(float)*outframes*channels;
+    if ( (out = malloc(outsize)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for output", outsize);
+
+    if ( fixed )
+        apply_with_fixedfir(fixed, quantize_bits(quantize), in, out, frames, outframes, channels);
+    else if ( method == apply_direct || (method == apply_auto && taps <= FIR_DIRECT_MAX) )
+        apply_with_fir(filter, in, out, frames, outframes, channels);
+    else
+        apply_with_convolve(filter, in, out, frames, outframes, channels);
+
+    write_frames(out, outframes, channels, sr, outpath, format);
+
+    free(in);
+    free(out);
+}
+
+void apply_bank(audiobuf **filters, int ct, char *inpath, char *outpath, enum file_format format) {
+    int frames, channels, sr;
+    float *in = read_frames(inpath, &frames, &channels, &sr);
+
+    int taps = 1;
+    for (int f = 0; f < ct; f++) {
+        if ( filters[f]->sr != sr )
+            fprintf(stderr, "mkfilter: WARNING: Filter %d sample rate %d does not match %d of %s.\n", f+1, filters[f]->sr, sr, inpath);
+        if ( taps < fir_length(filters[f]) )
+            taps = fir_length(filters[f]);
+    }
+    int outframes = frames + taps - 1;
+
+    // overlap-save: each block of n input samples ends in hop new ones, and
+    // the last hop samples of its circular convolution are exact
+    int n = 1 << (int)ceil(log2(2*taps));
+    if ( n < APPLY_BANK_MIN_FFT )
+        n = APPLY_BANK_MIN_FFT;
+    int hop = n - taps + 1;
+    int bins = n/2+1;
+
+    // the filter spectra, with the inverse transform's 1/n folded in
+    for (int f = 0; f < ct; f++) {
+        filters[f]->len = fir_length(filters[f]);
+        expand_buf(filters[f], n);
+        convert_buf(filters[f], audiobuf_fd);
+        for (int i = 0; i < bins*2; i++)
+            filters[f]->fd[i] /= n;
+    }
+
+    int outchannels = channels*ct;
+    float *out;
+    size_t outsize = sizeof(float)*outframes*outchannels;
+    if ( (out = malloc(outsize)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for output", outsize);
+
+    float *block;
+    fft_cpx *spectrum;
+    fft_cpx *products;
+    float *results;
+    if ( (block = malloc(sizeof(float)*n)) == NULL
+            || (spectrum = malloc(sizeof(fft_cpx)*bins)) == NULL
+            || (products = malloc(sizeof(fft_cpx)*bins*ct)) == NULL
+            || (results = malloc(sizeof(float)*n*ct)) == NULL )
+        err(1, "Couldn't allocate space for %d point blocks", n);
+
+    for (int c = 0; c < channels; c++) {
+        for (int start = 0; start < outframes; start += hop) {
+            for (int i = 0; i < n; i++) {
+                int at = start - (taps-1) + i;
+                block[i] = at >= 0 && at < frames ? in[(size_t)at*channels+c] : 0;
+            }
+
+            // the one forward transform this block gets, shared by every filter
+            fftr(n, block, spectrum);
+
+            PARALLEL_FOR
+            for (int f = 0; f < ct; f++) {
+                fft_cpx *h = (fft_cpx*) filters[f]->fd;
+                fft_cpx *p = products + (size_t)f*bins;
+                float *r = results + (size_t)f*n;
+                for (int i = 0; i < bins; i++) {
+                    p[i].r = spectrum[i].r*h[i].r - spectrum[i].i*h[i].i;
+                    p[i].i = spectrum[i].r*h[i].i + spectrum[i].i*h[i].r;
+                }
+                fftri(n, p, r);
+
+                for (int i = 0; i < hop && start+i < outframes; i++)
+                    out[(size_t)(start+i)*outchannels + f*channels + c] = r[taps-1+i];
+            }
+        }
+    }
+
+    write_frames(out, outframes, outchannels, sr, outpath, format);
+
+    free(block);
+    free(spectrum);
+    free(products);
+    free(results);
+    free(in);
+    free(out);
+}
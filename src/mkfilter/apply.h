@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __APPLY_H__
+#define __APPLY_H__
+
+#include "audiobuf.h"
+#include "file.h"
+#include "quantize.h"
+
+enum apply_method {
+    apply_auto,   // direct up to FIR_DIRECT_MAX taps, fft above
+    apply_direct,
+    apply_fft
+};
+
+// filters every channel of the audio file at inpath and writes the full
+// convolution (input length + taps - 1 frames) to outpath. when fixed is not
+// NULL it holds the filter in the quantize fixed point format, and the fixed
+// point kernel is used whatever the method.
+void apply_file(audiobuf *filter, char *inpath, char *outpath, enum file_format format, enum apply_method method,
+                int32_t *fixed, enum quantize_mode quantize);
+
+// smallest block transform apply_bank uses, however short the filters are
+#define APPLY_BANK_MIN_FFT 4096
+
+/*
+ * Filters every channel of inpath with each of the ct filters, giving
+ * channels*ct output channels: every input channel through the first filter,
+ * then through the second, and so on. Each input block is transformed once
+ * and multiplied against all of the filter spectra, so added filters only
+ * cost a multiply and an inverse transform. The filters are left padded and
+ * in the frequency domain.
+ */
+void apply_bank(audiobuf **filters, int ct, char *inpath, char *outpath, enum file_format format);
+
+#endif
@@ -16,8 +16,9 @@
  */
 
 #include "audiobuf.h"
-#include "../kissfft/kiss_fftr.h"
 
+#include <stdbool.h>
+#include <stdlib.h>
 #include <err.h>
 #include <string.h>
 
@@ -32,9 +33,7 @@ void convert_buf(audiobuf *buf, enum audiobuf_type target) {
             if ( (buf->fd = malloc(sizeof(float)*(buf->len/2+1)*2)) == NULL )
                 err(1, "Couldn't allocate %zu bytes for frequency domain samples", sizeof(float)*(buf->len/2+1)*2);
 
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(buf->len, 0, NULL, NULL);
-        kiss_fftr(cfg, buf->td, (kiss_fft_cpx*) buf->fd);
-        kiss_fftr_free(cfg);
+        fftr(buf->len, buf->td, (fft_cpx*) buf->fd);
 
         buf->type = audiobuf_fd;
     } else if ( target == audiobuf_td ) {
@@ -42,9 +41,7 @@ void convert_buf(audiobuf *buf, enum audiobuf_type target) {
             if ( (buf->td = malloc(sizeof(float)*buf->len)) == NULL )
                 err(1, "Couldn't allocate %zu bytes for time domain samples", sizeof(float)*buf->len);
 
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(buf->len, 1, NULL, NULL);
-        kiss_fftri(cfg, (kiss_fft_cpx*) buf->fd, buf->td);
-        kiss_fftr_free(cfg);
+        fftri(buf->len, (fft_cpx*) buf->fd, buf->td);
 
         buf->type = audiobuf_td;
     } else {
@@ -56,7 +53,7 @@ void expand_buf(audiobuf *buf, int minsize) {
     convert_buf(buf, audiobuf_td);
 
     int oldsize = buf->len;
-    int newsize = kiss_fftr_next_fast_size_real(oldsize > minsize ? oldsize : minsize);
+    int newsize = fft_fast_size(oldsize > minsize ? oldsize : minsize);
 
     if ( newsize > oldsize ) {
         if ( (buf->td = realloc(buf->td, sizeof(float)*newsize)) == NULL )
@@ -65,6 +62,10 @@ void expand_buf(audiobuf *buf, int minsize) {
         for (int i = oldsize; i < newsize; i++)
             buf->td[i] = 0;
 
+        // any old spectrum is too short for the new length
+        free(buf->fd);
+        buf->fd = NULL;
+
         buf->len = newsize;
     }
 }
@@ -18,6 +18,8 @@
 #ifndef __AUDIOBUF_H__
 #define __AUDIOBUF_H__
 
+#include "fft.h"
+
 #include <inttypes.h>
 
 enum audiobuf_type {
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "czt.h"
+#include "audiobuf.h"
+#include "jobs.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <err.h>
+
+#define PI 3.1415926535897932384626433832795028841971693993
+
+// e^(-2 pi i turns), with whole turns taken out first; the chirps reach
+// millions of turns, far past where float (or sin of a big double) is exact
+static fft_cpx turn(double turns) {
+    double a = -2*PI*(turns - floor(turns));
+    fft_cpx z = { cos(a), sin(a) };
+    return z;
+}
+
+static fft_cpx cmul(fft_cpx a, fft_cpx b) {
+    fft_cpx z = { a.r*b.r - a.i*b.i, a.r*b.i + a.i*b.r };
+    return z;
+}
+
+void czt(float *x, int n, double from, double step, int sr, int m, fft_cpx *out) {
+    // with jk = (j^2 + k^2 - (k-j)^2)/2 the transform is a chirp times the
+    // convolution of the chirped input with the conjugate chirp
+    int size = 1;
+    while ( size < n+m-1 )
+        size *= 2;
+
+    fft_cpx *y, *v;
+    if ( (y = malloc(sizeof(fft_cpx)*size)) == NULL || (v = malloc(sizeof(fft_cpx)*size)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for chirp-z transform", sizeof(fft_cpx)*size*2);
+
+    double chirp = step / (2.0*sr); // turns per j^2
+
+    PARALLEL_FOR
+    for (int j = 0; j < size; j++) {
+        if ( j < n ) {
+            fft_cpx w = turn(fmod(from*j/sr, 1.0) + fmod(chirp*j*j, 1.0));
+            y[j].r = x[j]*w.r;
+            y[j].i = x[j]*w.i;
+        } else {
+            y[j].r = y[j].i = 0;
+        }
+
+        // v[t] = e^(+i pi step t^2/sr) for t from -(n-1) to m-1, circularly
+        int t = j < m ? j : size-j;
+        if ( j < m || size-j < n )
+            v[j] = turn(-fmod(chirp*t*t, 1.0));
+        else
+            v[j].r = v[j].i = 0;
+    }
+
+    fft(size, false, y, y);
+    fft(size, false, v, v);
+
+    PARALLEL_FOR
+    for (int i = 0; i < size; i++) {
+        y[i] = cmul(y[i], v[i]);
+        y[i].r /= size;
+        y[i].i /= size;
+    }
+
+    fft(size, true, y, y);
+
+    PARALLEL_FOR
+    for (int k = 0; k < m; k++)
+        out[k] = cmul(y[k], turn(fmod(chirp*k*k, 1.0)));
+
+    free(y);
+    free(v);
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __CZT_H__
+#define __CZT_H__
+
+#include "fft.h"
+
+/*
+ * The chirp-Z transform of the n real samples x on m evenly spaced
+ * frequencies, out[k] = sum_j x[j] e^(-2 pi i (from + k step) j / sr).
+ *
+ * It is done with Bluestein's algorithm as one convolution of length
+ * n+m-1 rounded up to a power of two, so zooming in on a narrow band costs
+ * the same no matter how fine the steps are.
+ */
+void czt(float *x, int n, double from, double step, int sr, int m, fft_cpx *out);
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+
+#include "deconvolve.h"
+#include "tools.h"
+#include "jobs.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#define PI 3.1415926535897932384626433832795028841971693993
+
+// longest pre-roll kept before an impulse response's peak, in seconds
+#define DECONVOLVE_PREROLL 0.002
+
+static audiobuf *alloc_td(int len, int sr) {
+    audiobuf *buf;
+    if ( (buf = malloc(sizeof(audiobuf))) == NULL )
+        err(1, "Couldn't allocate space for audiobuf struct");
+    if ( (buf->td = calloc(len, sizeof(float))) == NULL )
+        err(1, "Couldn't allocate %zu bytes for time domain samples", sizeof(float)*len);
+    buf->fd = NULL;
+    buf->len = len;
+    buf->type = audiobuf_td;
+    buf->sr = sr;
+    return buf;
+}
+
+static int sweep_length(sweep *s, int sr) {
+    int len = round(s->seconds * sr);
+    if ( len < 2 )
+        errx(1, "Sweep of %g seconds is too short", s->seconds);
+    return len;
+}
+
+audiobuf *make_sweep(sweep *s, int sr) {
+    int len = sweep_length(s, sr);
+    double rate = log(s->f2 / s->f1);
+    audiobuf *buf = alloc_td(len, sr);
+
+    PARALLEL_FOR
+    for (int i = 0; i < len; i++) {
+        double t = (double)i / sr;
+        buf->td[i] = sin(2*PI * s->f1 * s->seconds / rate * (exp(t * rate / s->seconds) - 1));
+    }
+
+    return buf;
+}
+
+audiobuf *make_inverse_sweep(sweep *s, int sr, double regularize) {
+    audiobuf *x = make_sweep(s, sr);
+    int len = x->len;
+    double rate = log(s->f2 / s->f1);
+
+    if ( regularize <= 0 ) {
+        audiobuf *inv = alloc_td(len, sr);
+
+        // the reversed sweep runs from f2 down, so falling as e^(-tR/T)
+        // keeps its amplitude proportional to its frequency
+        for (int i = 0; i < len; i++)
+            inv->td[i] = x->td[len-1-i] * exp(-(double)i/sr * rate / s->seconds);
+
+        double fm = sqrt(s->f1 * s->f2);
+        double gain = frequency_power(x, fm) * frequency_power(inv, fm);
+        for (int i = 0; i < len; i++)
+            inv->td[i] /= gain;
+
+        free_buf(x);
+        return inv;
+    }
+
+    int n = 1 << (int)ceil(log2(2*len));
+    expand_buf(x, n);
+    convert_buf(x, audiobuf_fd);
+    fft_cpx *spec = (fft_cpx*) x->fd;
+
+    double peak = 0;
+    for (int i = 0; i <= n/2; i++) {
+        double p = spec[i].r*spec[i].r + spec[i].i*spec[i].i;
+        if ( peak < p )
+            peak = p;
+    }
+
+    // conj(X) is the sweep reversed about sample 0; delaying it by len-1
+    // makes it causal
+    for (int i = 0; i <= n/2; i++) {
+        double re = spec[i].r, im = -spec[i].i;
+        double scale = 1 / ((re*re + im*im + regularize*peak) * n);
+        double c = cos(2*PI*i*(len-1)/n);
+        double sn = -sin(2*PI*i*(len-1)/n);
+        spec[i].r = (re*c - im*sn) * scale;
+        spec[i].i = (re*sn + im*c) * scale;
+    }
+
+    convert_buf(x, audiobuf_td);
+    return x;
+}
+
+/*
+ * Keeps the samples around the largest peak seen so far. The peak is taken
+ * over all channels, so every channel's response starts at the same sample
+ * and their relative delays survive.
+ */
+typedef struct irtracker {
+    int channels;
+    int preroll;
+    int irlen;
+    float *ring;   // the last preroll frames
+    float *ir;     // irlen frames
+    int filled;    // frames of ir so far
+    float peak;
+    long long seen;
+} irtracker;
+
+static void track_frame(irtracker *t, float *y, size_t stride) {
+    int ch = t->channels;
+    int preroll = t->preroll;
+
+    float peak = 0;
+    for (int c = 0; c < ch; c++)
+        if ( peak < fabsf(y[c*stride]) )
+            peak = fabsf(y[c*stride]);
+
+    if ( peak > t->peak ) {
+        t->peak = peak;
+        int pre = t->seen < preroll ? t->seen : preroll;
+        memset(t->ir, 0, sizeof(float)*(preroll-pre)*ch);
+        for (int i = 0; i < pre; i++)
+            memcpy(t->ir + (size_t)(preroll-pre+i)*ch, t->ring + (size_t)((t->seen-pre+i) % preroll)*ch, sizeof(float)*ch);
+        t->filled = preroll;
+    }
+    if ( t->filled < t->irlen ) {
+        for (int c = 0; c < ch; c++)
+            t->ir[(size_t)t->filled*ch+c] = y[c*stride];
+        t->filled++;
+    }
+
+    if ( preroll )
+        for (int c = 0; c < ch; c++)
+            t->ring[(size_t)(t->seen % preroll)*ch+c] = y[c*stride];
+    t->seen++;
+}
+
+void deconvolve_file(sweep *s, double regularize, char *inpath, int irlen, char *outpath, enum file_format format) {
+    int frames, channels, sr;
+    framereader *r = open_frames(inpath, &frames, &channels, &sr);
+
+    audiobuf *inv = make_inverse_sweep(s, sr, regularize);
+    int taps = inv->len;
+
+    if ( irlen <= 0 )
+        irlen = sr;
+
+    // the 2nd harmonic's impulse comes T ln(2)/R before the linear one
+    double lead = s->seconds * log(2) / log(s->f2 / s->f1);
+    int preroll = DECONVOLVE_PREROLL*sr < lead/2*sr ? DECONVOLVE_PREROLL*sr : lead/2*sr;
+    if ( preroll >= irlen )
+        preroll = irlen-1;
+
+    // overlap-save, as in apply_bank, but reading the input as it goes
+    int n = 1 << (int)ceil(log2(2*taps));
+    int hop = n - taps + 1;
+    int bins = n/2+1;
+
+    expand_buf(inv, n);
+    convert_buf(inv, audiobuf_fd);
+    fft_cpx *h = (fft_cpx*) inv->fd;
+    for (int i = 0; i < bins; i++) {
+        h[i].r /= n;
+        h[i].i /= n;
+    }
+
+    float *chunk;
+    float *blocks;
+    float *results;
+    fft_cpx *spectra;
+    irtracker t;
+    if ( (chunk = malloc(sizeof(float)*hop*channels)) == NULL
+            || (blocks = calloc((size_t)n*channels, sizeof(float))) == NULL
+            || (results = malloc(sizeof(float)*n*channels)) == NULL
+            || (spectra = malloc(sizeof(fft_cpx)*bins*channels)) == NULL )
+        err(1, "Couldn't allocate space for %d point blocks", n);
+
+    t.channels = channels;
+    t.preroll = preroll;
+    t.irlen = irlen;
+    t.filled = 0;
+    t.peak = 0;
+    t.seen = 0;
+    if ( (t.ring = malloc(sizeof(float)*(preroll > 0 ? preroll : 1)*channels)) == NULL
+            || (t.ir = calloc((size_t)irlen*channels, sizeof(float))) == NULL )
+        err(1, "Couldn't allocate %zu bytes for impulse responses", sizeof(float)*irlen*channels);
+
+    long long outframes = (long long)frames + taps - 1;
+    for (long long start = 0; start < outframes; start += hop) {
+        int got = read_some_frames(r, chunk, hop);
+        if ( got < hop )
+            memset(chunk+(size_t)got*channels, 0, sizeof(float)*(hop-got)*channels);
+
+        PARALLEL_FOR
+        for (int c = 0; c < channels; c++) {
+            // each channel's block keeps its last taps-1 inputs for the next
+            float *b = blocks + (size_t)c*n;
+            float *y = results + (size_t)c*n;
+            fft_cpx *sp = spectra + (size_t)c*bins;
+            memmove(b, b+hop, sizeof(float)*(taps-1));
+            for (int i = 0; i < hop; i++)
+                b[taps-1+i] = chunk[(size_t)i*channels+c];
+
+            fftr(n, b, sp);
+            for (int i = 0; i < bins; i++) {
+                float re = sp[i].r*h[i].r - sp[i].i*h[i].i;
+                float im = sp[i].r*h[i].i + sp[i].i*h[i].r;
+                sp[i].r = re;
+                sp[i].i = im;
+            }
+            fftri(n, sp, y);
+        }
+
+        for (int i = 0; i < hop && start+i < outframes; i++)
+            track_frame(&t, results+taps-1+i, n);
+    }
+    close_frames(r);
+
+    // fade in over the pre-roll and out over the last tenth
+    int fade = irlen/10;
+    float *out;
+    if ( (out = malloc(sizeof(float)*irlen*channels)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for impulse responses", sizeof(float)*irlen*channels);
+    for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < irlen; i++) {
+            double w = 1;
+            if ( i < preroll )
+                w = 0.5 - 0.5*cos(PI * (i+0.5) / preroll);
+            if ( irlen-1-i < fade )
+                w *= 0.5 - 0.5*cos(PI * (irlen-i-0.5) / fade);
+            out[(size_t)i*channels+c] = t.ir[(size_t)i*channels+c] * w;
+        }
+    }
+    free(t.ring);
+    free(t.ir);
+
+    write_frames(out, irlen, channels, sr, outpath, format);
+
+    free(out);
+    free(chunk);
+    free(blocks);
+    free(results);
+    free(spectra);
+    free_buf(inv);
+}
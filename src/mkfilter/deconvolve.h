@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+
+#ifndef __DECONVOLVE_H__
+#define __DECONVOLVE_H__
+
+#include "audiobuf.h"
+#include "file.h"
+
+// an exponential sine sweep, sin(2 pi f1 T/R (e^(tR/T) - 1)) for 0 <= t < T
+// where R = ln(f2/f1)
+typedef struct sweep {
+    double f1;
+    double f2;
+    double seconds; // T
+} sweep;
+
+audiobuf *make_sweep(sweep *s, int sr);
+
+/*
+ * The filter that turns the sweep into an impulse at sample len-1 of the
+ * result, len being the sweep length. Without regularization it is the
+ * Farina inverse, the time reversed sweep falling 6dB per octave, scaled to
+ * unity gain at the center frequency. With it, it is the spectral inverse
+ * conj(X)/(|X|^2 + regularize*max|X|^2), which is flatter inside the sweep
+ * band and bounded outside it.
+ */
+audiobuf *make_inverse_sweep(sweep *s, int sr, double regularize);
+
+/*
+ * Deconvolves a recording of the sweep, streaming it through the inverse a
+ * block at a time, and writes irlen samples of impulse response per channel.
+ * Each response starts a short pre-roll before its peak, which is kept under
+ * half the lead of the 2nd harmonic's impulse so harmonic distortion is
+ * windowed out, and is faded in over the pre-roll and out over its last
+ * tenth. irlen 0 means one second.
+ */
+void deconvolve_file(sweep *s, double regularize, char *inpath, int irlen, char *outpath, enum file_format format);
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "explore.h"
+#include "metrics.h"
+#include "jobs.h"
+#include "fir.h"
+#include "warp.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+typedef struct candidate {
+    int len;
+    int taps; // what running it costs, the warped taps for a warped design
+    enum window window;
+    metrics m;
+    bool front;
+} candidate;
+
+static char *window_name(enum window window) {
+    switch ( window ) {
+        case window_blackman:    return "blackman";
+        case window_hamming:     return "hamming";
+        case window_barlett:     return "barlett";
+        case window_hanning:     return "hanning";
+        case window_rectangular: return "rectangular";
+    }
+    return "?";
+}
+
+bool handle_explore_lengths(char *spec, int **lens, int *ct) {
+    // count first, so the list can be allocated once
+    for (int pass = 0; pass < 2; pass++) {
+        char *s = spec;
+        *ct = 0;
+        while ( true ) {
+            long from = strtol(s, &s, 10);
+            long to = from;
+            long step = 0;
+            if ( *s == ':' ) {
+                to = strtol(s+1, &s, 10);
+                if ( *s == ':' ) {
+                    step = strtol(s+1, &s, 10);
+                    if ( step < 1 )
+                        return false;
+                }
+            }
+            if ( from < 1 || to < from || to > 1<<28 )
+                return false;
+
+            // doubling keeps odd lengths odd; 1 would stay 1, so it steps to 2
+            for (long l = from; l <= to; l = step ? l+step : (l*2 - l%2 > l ? l*2 - l%2 : l+1)) {
+                if ( pass )
+                    (*lens)[*ct] = l;
+                (*ct)++;
+            }
+
+            if ( *s == '\0' )
+                break;
+            if ( *s++ != ',' )
+                return false;
+        }
+
+        if ( !pass && (*lens = malloc(sizeof(int)*(*ct))) == NULL )
+            err(1, "Couldn't allocate space for lengths");
+    }
+    return true;
+}
+
+bool handle_explore_windows(char *spec, enum window **windows, int *ct) {
+    int malloced = 1;
+    for (char *s = spec; *s; s++)
+        if ( *s == ',' )
+            malloced++;
+    if ( (*windows = malloc(sizeof(enum window)*malloced)) == NULL )
+        err(1, "Couldn't allocate space for windows");
+
+    char *copy = strdup(spec);
+    *ct = 0;
+    for (char *name = strtok(copy, ","); name; name = strtok(NULL, ","))
+        if ( !handle_window(name, &(*windows)[(*ct)++]) ) {
+            free(copy);
+            return false;
+        }
+    free(copy);
+    return *ct > 0;
+}
+
+// nan (a figure that doesn't exist) counts as the worst value
+static double worst_if_nan(double v, double worst) {
+    return isnan(v) ? worst : v;
+}
+
+static bool dominates(candidate *a, candidate *b) {
+    double ar = worst_if_nan(a->m.ripple, INFINITY), br = worst_if_nan(b->m.ripple, INFINITY);
+    double aa = worst_if_nan(a->m.attenuation, -INFINITY), ba = worst_if_nan(b->m.attenuation, -INFINITY);
+    double at = worst_if_nan(a->m.transition, INFINITY), bt = worst_if_nan(b->m.transition, INFINITY);
+
+    if ( a->taps > b->taps || ar > br || aa < ba || at > bt )
+        return false;
+    return a->taps < b->taps || ar < br || aa > ba || at < bt;
+}
+
+static void print_number(double v, FILE *fh) {
+    if ( isnan(v) )
+        fprintf(fh, "\tnan");
+    else
+        fprintf(fh, "\t%.6f", v);
+}
+
+static void print_candidate(candidate *c, FILE *fh) {
+    fprintf(fh, "%d\t%s", c->taps, window_name(c->window));
+    print_number(c->m.ripple, fh);
+    print_number(c->m.attenuation, fh);
+    print_number(c->m.transition, fh);
+    fprintf(fh, "%s\n", c->front ? "\t*" : "");
+}
+
+static int by_taps(const void *a, const void *b) {
+    const candidate *x = *(const candidate **)a;
+    const candidate *y = *(const candidate **)b;
+    if ( x->taps != y->taps )
+        return x->taps < y->taps ? -1 : 1;
+    return x < y ? -1 : x > y; // keep table order between equals
+}
+
+void explore_designs(design *base, int *lens, int lenct, enum window *windows, int winct,
+                     int analyzefactor, analyze_range *range, FILE *fh) {
+    int ct = lenct*winct;
+    candidate *c;
+    candidate **front;
+    if ( (c = malloc(sizeof(candidate)*ct)) == NULL || (front = malloc(sizeof(candidate*)*ct)) == NULL )
+        err(1, "Couldn't allocate space for %d designs", ct);
+
+    // neighbouring designs share a length, so the contiguous blocks each
+    // thread gets mostly reuse the fft plans it has cached
+    PARALLEL_FOR
+    for (int i = 0; i < ct; i++) {
+        design d = *base;
+        d.len = c[i].len = lens[i / winct];
+        d.window = c[i].window = windows[i % winct];
+
+        // a warped design costs its warped taps, but its quality is that of
+        // the response they realize, which runs several times longer
+        if ( d.type == warped )
+            d.warp_export = warp_coefficients;
+        audiobuf *buf = make_design(&d);
+        if ( d.type == warped ) {
+            audiobuf *coefs = buf;
+            c[i].taps = fir_length(coefs);
+            buf = unwarp_fir(coefs, design_warp(&d), 0);
+            free_buf(coefs);
+        }
+        measure_filter(buf, analyzefactor, range, &c[i].m);
+        if ( d.type != warped )
+            c[i].taps = c[i].m.taps;
+        free_buf(buf);
+    }
+
+    int frontct = 0;
+    for (int i = 0; i < ct; i++) {
+        c[i].front = true;
+        for (int j = 0; j < ct && c[i].front; j++)
+            if ( dominates(&c[j], &c[i]) )
+                c[i].front = false;
+        if ( c[i].front )
+            front[frontct++] = &c[i];
+    }
+    qsort(front, frontct, sizeof(candidate*), by_taps);
+
+    fprintf(fh, "# SAMPLERATE=%d\n", base->sr);
+    fprintf(fh, "# taps window ripple_db attenuation_db transition_hz, * on the pareto front\n");
+    fprintf(fh, "\n");
+    for (int i = 0; i < ct; i++)
+        print_candidate(&c[i], fh);
+
+    fprintf(fh, "\n# pareto front, fewest taps first\n");
+    for (int i = 0; i < frontct; i++)
+        print_candidate(front[i], fh);
+
+    for (int i = 0; i < ct; i++) {
+        free(c[i].m.edges3);
+        free(c[i].m.edges6);
+    }
+    free(c);
+    free(front);
+}
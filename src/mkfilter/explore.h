@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __EXPLORE_H__
+#define __EXPLORE_H__
+
+#include "make.h"
+#include "analyze.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * Lengths to explore, as a comma separated list of lengths and ranges. A
+ * range from:to:step steps linearly, from:to doubles from from up to to
+ * (odd lengths to twice less one, so 1001:8001 gives 1001, 2001, 4001, 8001).
+ */
+bool handle_explore_lengths(char *spec, int **lens, int *ct);
+
+// a comma separated list of window names
+bool handle_explore_windows(char *spec, enum window **windows, int *ct);
+
+/*
+ * Designs base with every combination of the lengths and windows in
+ * parallel, measures each like --metrics and prints a table of the taps,
+ * window, ripple, attenuation and transition width. Then the Pareto front:
+ * the designs where no other design is at least as good on taps, ripple,
+ * attenuation and transition width and better on one of them, fewest taps
+ * first, so the first line meeting a spec is the cheapest filter that does.
+ * A warped design counts its warped taps, since that is what a warped runtime
+ * runs, and is measured on the longer response they realize.
+ */
+void explore_designs(design *base, int *lens, int lenct, enum window *windows, int winct,
+                     int analyzefactor, analyze_range *range, FILE *fh);
+
+#endif
@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "fft.h"
+
+#include "../kissfft/kiss_fft.h"
+#include "../kissfft/kiss_fftr.h"
+
+#ifdef HAVE_FFTW3
+#include <fftw3.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+
+static enum fft_backend backend = fft_kiss;
+
+/*
+ * The Stockham autosort FFT: each stage does radix point butterflies on
+ * elements stride apart and writes them back in order, ping-ponging between
+ * two buffers, so there is no bit reversal pass. For a stage over length len
+ * with m = len/radix,
+ *
+ *     y[q + stride(radix p + t)] = w_len^(pt) sum_r x[q + stride(p + rm)] w_radix^(rt)
+ *
+ * for p < m and q < stride, then len /= radix and stride *= radix.
+ */
+typedef struct stage {
+    int radix;
+    int m;
+    int stride;
+    fft_cpx *twiddles; // w_len^(pt) at p*(radix-1) + t-1
+    fft_cpx *roots;    // w_radix^k, for radices without their own butterfly
+} stage;
+
+typedef struct stockham {
+    int n;
+    int ct;
+    stage *stages;
+    fft_cpx *scratch; // one radix of inputs
+    fft_cpx *work[2];
+} stockham;
+
+// w holds w_n^k at k*wstride, in the plan's direction; every stage's
+// twiddles and roots are taken from it
+static stockham *stockham_alloc(int n, const fft_cpx *w, int wstride) {
+    stockham *s;
+    if ( (s = malloc(sizeof(stockham))) == NULL || (s->stages = malloc(sizeof(stage)*32)) == NULL )
+        err(1, "Couldn't allocate fft plan");
+    s->n = n;
+    s->ct = 0;
+
+    // 4s first, then any 2 left over, then odd factors
+    int left = n;
+    int maxradix = 1;
+    int len = n;
+    int stride = 1;
+    while ( left > 1 ) {
+        int radix;
+        if ( left % 4 == 0 )
+            radix = 4;
+        else if ( left % 2 == 0 )
+            radix = 2;
+        else
+            for (radix = 3; left % radix; radix += 2)
+                ;
+        left /= radix;
+        if ( radix > maxradix )
+            maxradix = radix;
+
+        stage *st = &s->stages[s->ct++];
+        st->radix = radix;
+        st->m = len/radix;
+        st->stride = stride;
+        if ( (st->twiddles = malloc(sizeof(fft_cpx)*(st->m*(radix-1) > 0 ? st->m*(radix-1) : 1))) == NULL )
+            err(1, "Couldn't allocate fft twiddles");
+        for (int p = 0; p < st->m; p++)
+            for (int t = 1; t < radix; t++)
+                st->twiddles[p*(radix-1) + t-1] = w[(size_t)p*t * (n/len) * wstride];
+
+        st->roots = NULL;
+        if ( radix > 5 ) {
+            if ( (st->roots = malloc(sizeof(fft_cpx)*radix)) == NULL )
+                err(1, "Couldn't allocate fft roots");
+            for (int k = 0; k < radix; k++)
+                st->roots[k] = w[(size_t)k * (n/radix) * wstride];
+        }
+
+        len /= radix;
+        stride *= radix;
+    }
+
+    if ( (s->scratch = malloc(sizeof(fft_cpx)*maxradix)) == NULL ||
+         (s->work[0] = malloc(sizeof(fft_cpx)*n)) == NULL || (s->work[1] = malloc(sizeof(fft_cpx)*n)) == NULL )
+        err(1, "Couldn't allocate fft plan");
+
+    return s;
+}
+
+static void stockham_free(stockham *s) {
+    for (int i = 0; i < s->ct; i++) {
+        free(s->stages[i].twiddles);
+        free(s->stages[i].roots);
+    }
+    free(s->stages);
+    free(s->scratch);
+    free(s->work[0]);
+    free(s->work[1]);
+    free(s);
+}
+
+static inline fft_cpx cmul(fft_cpx a, fft_cpx b) {
+    fft_cpx z = { a.r*b.r - a.i*b.i, a.r*b.i + a.i*b.r };
+    return z;
+}
+
+static inline fft_cpx cadd(fft_cpx a, fft_cpx b) {
+    fft_cpx z = { a.r + b.r, a.i + b.i };
+    return z;
+}
+
+static inline fft_cpx csub(fft_cpx a, fft_cpx b) {
+    fft_cpx z = { a.r - b.r, a.i - b.i };
+    return z;
+}
+
+static inline fft_cpx cscale(fft_cpx a, float k) {
+    fft_cpx z = { a.r*k, a.i*k };
+    return z;
+}
+
+// times -i, or i for the inverse
+static inline fft_cpx cturn(fft_cpx a, bool inverse) {
+    fft_cpx z = inverse ? (fft_cpx){ -a.i, a.r } : (fft_cpx){ a.i, -a.r };
+    return z;
+}
+
+/*
+ * The butterflies for one p, over every q. in[stride*m*r] is input r and
+ * out[stride*t] is output t; the first output never needs a twiddle, and
+ * none do for p = 0.
+ */
+static void butterfly2(stage *st, fft_cpx *in, fft_cpx *out, fft_cpx *w, bool p) {
+    int d = st->stride*st->m;
+    for (int q = 0; q < st->stride; q++, in++, out++) {
+        fft_cpx a = in[0];
+        fft_cpx b = in[d];
+        out[0] = cadd(a, b);
+        out[st->stride] = p ? cmul(csub(a, b), w[0]) : csub(a, b);
+    }
+}
+
+static void butterfly3(stage *st, fft_cpx *in, fft_cpx *out, fft_cpx *w, bool p, bool inverse) {
+    int d = st->stride*st->m;
+    int os = st->stride;
+    const float h = 0.86602540378443864676; // sin(2 pi/3)
+    for (int q = 0; q < st->stride; q++, in++, out++) {
+        fft_cpx s = cadd(in[d], in[d*2]);
+        fft_cpx t = csub(in[0], cscale(s, 0.5));
+        fft_cpx u = cturn(cscale(csub(in[d], in[d*2]), h), inverse);
+        out[0] = cadd(in[0], s);
+        out[os] = p ? cmul(cadd(t, u), w[0]) : cadd(t, u);
+        out[os*2] = p ? cmul(csub(t, u), w[1]) : csub(t, u);
+    }
+}
+
+static void butterfly4(stage *st, fft_cpx *in, fft_cpx *out, fft_cpx *w, bool p, bool inverse) {
+    int d = st->stride*st->m;
+    int os = st->stride;
+    for (int q = 0; q < st->stride; q++, in++, out++) {
+        fft_cpx b0 = cadd(in[0], in[d*2]);
+        fft_cpx b1 = csub(in[0], in[d*2]);
+        fft_cpx b2 = cadd(in[d], in[d*3]);
+        fft_cpx b3 = cturn(csub(in[d], in[d*3]), inverse);
+        out[0] = cadd(b0, b2);
+        out[os] = p ? cmul(cadd(b1, b3), w[0]) : cadd(b1, b3);
+        out[os*2] = p ? cmul(csub(b0, b2), w[1]) : csub(b0, b2);
+        out[os*3] = p ? cmul(csub(b1, b3), w[2]) : csub(b1, b3);
+    }
+}
+
+static void butterfly5(stage *st, fft_cpx *in, fft_cpx *out, fft_cpx *w, bool p, bool inverse) {
+    int d = st->stride*st->m;
+    int os = st->stride;
+    const float c1 = 0.30901699437494742410;  // cos(2 pi/5)
+    const float c2 = -0.80901699437494742410; // cos(4 pi/5)
+    const float s1 = 0.95105651629515357212;  // sin(2 pi/5)
+    const float s2 = 0.58778525229247312917;  // sin(4 pi/5)
+    for (int q = 0; q < st->stride; q++, in++, out++) {
+        fft_cpx a0 = in[0];
+        fft_cpx sa = cadd(in[d], in[d*4]);
+        fft_cpx da = csub(in[d], in[d*4]);
+        fft_cpx sb = cadd(in[d*2], in[d*3]);
+        fft_cpx db = csub(in[d*2], in[d*3]);
+        fft_cpx t1 = cadd(a0, cadd(cscale(sa, c1), cscale(sb, c2)));
+        fft_cpx t2 = cadd(a0, cadd(cscale(sa, c2), cscale(sb, c1)));
+        fft_cpx u1 = cturn(cadd(cscale(da, s1), cscale(db, s2)), inverse);
+        fft_cpx u2 = cturn(csub(cscale(da, s2), cscale(db, s1)), inverse);
+        fft_cpx y[4] = { cadd(t1, u1), cadd(t2, u2), csub(t2, u2), csub(t1, u1) };
+        out[0] = cadd(a0, cadd(sa, sb));
+        for (int t = 0; t < 4; t++)
+            out[os*(t+1)] = p ? cmul(y[t], w[t]) : y[t];
+    }
+}
+
+// a plain DFT of the radix
+static void butterfly_generic(stockham *s, stage *st, fft_cpx *in, fft_cpx *out, fft_cpx *w, bool p) {
+    int radix = st->radix;
+    int d = st->stride*st->m;
+    fft_cpx *a = s->scratch;
+    for (int q = 0; q < st->stride; q++, in++, out++) {
+        for (int r = 0; r < radix; r++)
+            a[r] = in[d*r];
+        for (int t = 0; t < radix; t++) {
+            fft_cpx sum = a[0];
+            int k = 0; // r*t mod radix
+            for (int r = 1; r < radix; r++) {
+                k += t;
+                if ( k >= radix )
+                    k -= radix;
+                sum = cadd(sum, cmul(a[r], st->roots[k]));
+            }
+            out[st->stride*t] = t && p ? cmul(sum, w[t-1]) : sum;
+        }
+    }
+}
+
+static void stockham_stage(stockham *s, stage *st, fft_cpx *x, fft_cpx *y, bool inverse) {
+    int radix = st->radix;
+    for (int p = 0; p < st->m; p++) {
+        fft_cpx *w = st->twiddles + p*(radix-1);
+        fft_cpx *in = x + st->stride*p;
+        fft_cpx *out = y + st->stride*radix*p;
+        switch ( radix ) {
+            case 2: butterfly2(st, in, out, w, p); break;
+            case 3: butterfly3(st, in, out, w, p, inverse); break;
+            case 4: butterfly4(st, in, out, w, p, inverse); break;
+            case 5: butterfly5(st, in, out, w, p, inverse); break;
+            default: butterfly_generic(s, st, in, out, w, p); break;
+        }
+    }
+}
+
+static void stockham_fft(stockham *s, bool inverse, fft_cpx *in, fft_cpx *out) {
+    if ( s->ct == 0 ) {
+        out[0] = in[0];
+        return;
+    }
+
+    fft_cpx *x = in;
+    if ( in == out ) {
+        memcpy(s->work[1], in, sizeof(fft_cpx)*s->n);
+        x = s->work[1];
+    }
+
+    // the last stage writes out
+    for (int i = 0; i < s->ct; i++) {
+        fft_cpx *y = (s->ct-1-i) % 2 == 0 ? out : s->work[0];
+        stockham_stage(s, &s->stages[i], x, y, inverse);
+        x = y;
+    }
+}
+
+/*
+ * A real transform of length n is a complex one of n/2 over the even and odd
+ * samples as real and imaginary parts, z, untangled after: with Z its
+ * transform and w = w_n,
+ *
+ *     X[k] = (Z[k] + conj Z[n/2-k])/2 + w^k (Z[k] - conj Z[n/2-k])/2i
+ *
+ * and the inverse tangles them back the same way.
+ */
+static void stockham_fftr(stockham *s, fft_cpx *w, fft_cpx *z, float *in, fft_cpx *out) {
+    int h = s->n;
+    stockham_fft(s, false, (fft_cpx*) in, z);
+    for (int k = 0; k <= h; k++) {
+        fft_cpx a = z[k < h ? k : 0];
+        fft_cpx b = z[k > 0 ? h-k : 0];
+        float er = (a.r + b.r)/2;
+        float ei = (a.i - b.i)/2;
+        float or = (a.i + b.i)/2;
+        float oi = (b.r - a.r)/2;
+        out[k].r = er + w[k].r*or - w[k].i*oi;
+        out[k].i = ei + w[k].r*oi + w[k].i*or;
+    }
+}
+
+static void stockham_fftri(stockham *s, fft_cpx *w, fft_cpx *z, fft_cpx *in, float *out) {
+    int h = s->n;
+    for (int k = 0; k < h; k++) {
+        fft_cpx a = in[k];
+        fft_cpx b = in[h-k];
+        float er = a.r + b.r;
+        float ei = a.i - b.i;
+        float dr = a.r - b.r;
+        float di = a.i + b.i;
+        float or = dr*w[k].r + di*w[k].i;
+        float oi = di*w[k].r - dr*w[k].i;
+        z[k].r = er - oi;
+        z[k].i = ei + or;
+    }
+    stockham_fft(s, true, z, (fft_cpx*) out);
+}
+
+typedef struct plan {
+    enum fft_backend backend;
+    int n;
+    bool inverse;
+    bool real;
+    bool inplace; // FFTW plans are for one or the other
+    void *kiss;   // kiss_fft_cfg, or kiss_fftr_cfg when real
+    stockham *sh; // of n, or n/2 when real
+    fft_cpx *w;   // real only, w_n^k for k <= n/2
+    fft_cpx *z;   // real only, n/2 of scratch
+#ifdef HAVE_FFTW3
+    fftwf_plan fftw;
+#endif
+} plan;
+
+// each thread needs its own plans: kiss_fftr and the Stockham plans keep
+// scratch space in them
+static __thread plan *plans[PLAN_CACHE_SIZE];
+static __thread int nextplan;
+
+static void free_plan(plan *p) {
+    switch ( p->backend ) {
+        case fft_kiss:
+            if ( p->real )
+                kiss_fftr_free(p->kiss);
+            else
+                kiss_fft_free(p->kiss);
+            break;
+
+        case fft_stockham:
+            stockham_free(p->sh);
+            free(p->w);
+            free(p->z);
+            break;
+
+        case fft_fftw:
+#ifdef HAVE_FFTW3
+            #pragma omp critical (fftw_planner)
+            fftwf_destroy_plan(p->fftw);
+#endif
+            break;
+    }
+    free(p);
+}
+
+static plan *make_plan(int n, bool inverse, bool real, bool inplace) {
+    if ( real && n % 2 )
+        errx(1, "Real fft of odd size %d", n);
+
+    plan *p;
+    if ( (p = malloc(sizeof(plan))) == NULL )
+        err(1, "Couldn't allocate fft plan");
+    p->backend = backend;
+    p->n = n;
+    p->inverse = inverse;
+    p->real = real;
+    p->inplace = inplace;
+
+    switch ( backend ) {
+        case fft_kiss:
+            p->kiss = real ? (void*)kiss_fftr_alloc(n, inverse, NULL, NULL) : (void*)kiss_fft_alloc(n, inverse, NULL, NULL);
+            if ( p->kiss == NULL )
+                errx(1, "Couldn't allocate fft plan for size %d", n);
+            break;
+
+        case fft_stockham: {
+            // the twiddles kissfft uses, so a wisdom file serves both
+            fft_cpx *buf;
+            if ( (buf = malloc(sizeof(fft_cpx)*n)) == NULL )
+                err(1, "Couldn't allocate fft plan");
+            const fft_cpx *w = (const fft_cpx*) kiss_fft_table(KISS_TWIDDLES, n, inverse, (kiss_fft_cpx*) buf);
+
+            p->sh = real ? stockham_alloc(n/2, w, 2) : stockham_alloc(n, w, 1);
+            p->w = p->z = NULL;
+            if ( real ) {
+                if ( (p->w = malloc(sizeof(fft_cpx)*(n/2+1))) == NULL || (p->z = malloc(sizeof(fft_cpx)*(n/2))) == NULL )
+                    err(1, "Couldn't allocate fft plan");
+                // always the forward roots, the inverse split conjugates them itself
+                for (int k = 0; k <= n/2; k++) {
+                    p->w[k].r = w[k].r;
+                    p->w[k].i = inverse ? -w[k].i : w[k].i;
+                }
+            }
+            free(buf);
+            break;
+        }
+
+        case fft_fftw: {
+#ifdef HAVE_FFTW3
+            // planned on scratch arrays and run on others with the new-array
+            // execute functions, so nothing can assume alignment
+            unsigned flags = FFTW_ESTIMATE | FFTW_UNALIGNED;
+            if ( real && inverse )
+                flags |= FFTW_PRESERVE_INPUT; // c2r would scribble on the spectrum
+            float *a = fftwf_malloc(sizeof(fftwf_complex)*(n+1));
+            float *b = inplace ? a : fftwf_malloc(sizeof(fftwf_complex)*(n+1));
+            if ( a == NULL || b == NULL )
+                err(1, "Couldn't allocate fft plan");
+            #pragma omp critical (fftw_planner)
+            {
+                if ( real && !inverse )
+                    p->fftw = fftwf_plan_dft_r2c_1d(n, a, (fftwf_complex*) b, flags);
+                else if ( real )
+                    p->fftw = fftwf_plan_dft_c2r_1d(n, (fftwf_complex*) a, b, flags);
+                else
+                    p->fftw = fftwf_plan_dft_1d(n, (fftwf_complex*) a, (fftwf_complex*) b,
+                                                inverse ? FFTW_BACKWARD : FFTW_FORWARD, flags);
+            }
+            if ( p->fftw == NULL )
+                errx(1, "Couldn't make FFTW plan for size %d", n);
+            fftwf_free(a);
+            if ( b != a )
+                fftwf_free(b);
+            break;
+#endif
+        }
+
+        default:
+            errx(1, "Not reached");
+    }
+
+    return p;
+}
+
+static plan *cached_plan(int n, bool inverse, bool real, bool inplace) {
+    if ( backend != fft_fftw )
+        inplace = false; // the others plan the same either way
+
+    for (int i = 0; i < PLAN_CACHE_SIZE; i++) {
+        plan *p = plans[i];
+        if ( p && p->backend == backend && p->n == n && p->inverse == inverse && p->real == real && p->inplace == inplace )
+            return p;
+    }
+
+    // replace the oldest
+    if ( plans[nextplan] )
+        free_plan(plans[nextplan]);
+    plan *p = plans[nextplan] = make_plan(n, inverse, real, inplace);
+    nextplan = (nextplan+1) % PLAN_CACHE_SIZE;
+    return p;
+}
+
+void fft(int n, bool inverse, fft_cpx *in, fft_cpx *out) {
+    plan *p = cached_plan(n, inverse, false, in == out);
+    switch ( p->backend ) {
+        case fft_kiss:
+            kiss_fft(p->kiss, (kiss_fft_cpx*) in, (kiss_fft_cpx*) out);
+            break;
+        case fft_stockham:
+            stockham_fft(p->sh, inverse, in, out);
+            break;
+        case fft_fftw:
+#ifdef HAVE_FFTW3
+            fftwf_execute_dft(p->fftw, (fftwf_complex*) in, (fftwf_complex*) out);
+#endif
+            break;
+    }
+}
+
+void fftr(int n, float *in, fft_cpx *out) {
+    plan *p = cached_plan(n, false, true, false);
+    switch ( p->backend ) {
+        case fft_kiss:
+            kiss_fftr(p->kiss, in, (kiss_fft_cpx*) out);
+            break;
+        case fft_stockham:
+            stockham_fftr(p->sh, p->w, p->z, in, out);
+            break;
+        case fft_fftw:
+#ifdef HAVE_FFTW3
+            fftwf_execute_dft_r2c(p->fftw, in, (fftwf_complex*) out);
+#endif
+            break;
+    }
+}
+
+void fftri(int n, fft_cpx *in, float *out) {
+    plan *p = cached_plan(n, true, true, false);
+    switch ( p->backend ) {
+        case fft_kiss:
+            kiss_fftri(p->kiss, (kiss_fft_cpx*) in, out);
+            break;
+        case fft_stockham:
+            stockham_fftri(p->sh, p->w, p->z, in, out);
+            break;
+        case fft_fftw:
+#ifdef HAVE_FFTW3
+            fftwf_execute_dft_c2r(p->fftw, (fftwf_complex*) in, out);
+#endif
+            break;
+    }
+}
+
+int fft_fast_size(int n) {
+    return kiss_fftr_next_fast_size_real(n);
+}
+
+static bool built_in(enum fft_backend b) {
+#ifndef HAVE_FFTW3
+    if ( b == fft_fftw )
+        return false;
+#endif
+    return true;
+}
+
+bool set_fft_backend(enum fft_backend b) {
+    if ( !built_in(b) )
+        return false;
+    backend = b;
+    return true;
+}
+
+bool handle_fft_backend(char *name, enum fft_backend *b) {
+    if ( strcmp(name, "kiss") == 0 || strcmp(name, "kissfft") == 0 ) {
+        *b = fft_kiss;
+    } else if ( strcmp(name, "stockham") == 0 ) {
+        *b = fft_stockham;
+    } else if ( strcmp(name, "fftw") == 0 || strcmp(name, "fftw3") == 0 ) {
+        *b = fft_fftw;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// a forward and inverse real transform of each size, repeated for this long
+#define BENCHMARK_SECONDS 0.2
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+void fft_benchmark(FILE *fh) {
+    static const int sizes[] = { 256, 1024, 4096, 16384, 65536, 262144, 1048576, 44100, 48000, 192000 };
+    static const char *names[] = { "kiss", "stockham", "fftw" };
+    enum fft_backend chosen = backend;
+
+    fprintf(fh, "# size backend usec_per_pair mflops max_error\n");
+    for (int s = 0; s < (int)(sizeof(sizes)/sizeof(sizes[0])); s++) {
+        int n = sizes[s];
+        float *x, *y;
+        fft_cpx *ref, *spec;
+        if ( (x = malloc(sizeof(float)*n)) == NULL || (y = malloc(sizeof(float)*n)) == NULL ||
+             (ref = malloc(sizeof(fft_cpx)*(n/2+1))) == NULL || (spec = malloc(sizeof(fft_cpx)*(n/2+1))) == NULL )
+            err(1, "Couldn't allocate space for fft benchmark");
+
+        unsigned seed = 1;
+        for (int i = 0; i < n; i++) {
+            seed = seed*1103515245 + 12345;
+            x[i] = (seed >> 8) / (double)(1 << 24) - 0.5;
+        }
+
+        backend = fft_kiss;
+        fftr(n, x, ref);
+        double peak = 0;
+        for (int k = 0; k <= n/2; k++)
+            peak = fmax(peak, hypot(ref[k].r, ref[k].i));
+
+        for (enum fft_backend b = fft_kiss; b <= fft_fftw; b++) {
+            if ( !built_in(b) )
+                continue;
+            backend = b;
+
+            fftr(n, x, spec);
+            double error = 0;
+            for (int k = 0; k <= n/2; k++)
+                error = fmax(error, hypot(spec[k].r - ref[k].r, spec[k].i - ref[k].i));
+
+            int reps = 0;
+            double start = now();
+            double elapsed;
+            do {
+                fftr(n, x, spec);
+                fftri(n, spec, y);
+                reps++;
+            } while ( (elapsed = now() - start) < BENCHMARK_SECONDS );
+
+            double usec = elapsed/reps * 1e6;
+            fprintf(fh, "%d %s %.3f %.1f %.3g\n", n, names[b], usec, 5*n*log2(n)/usec, error/peak);
+        }
+
+        free(x);
+        free(y);
+        free(ref);
+        free(spec);
+    }
+    backend = chosen;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * The FFT everything goes through. The layout is kissfft's, which is also
+ * FFTW's fftwf_complex: complex values are interleaved float real and
+ * imaginary parts. A real transform of even length n gives n/2+1 bins, DC
+ * to nyquist. Nothing is scaled, so an inverse after a forward transform
+ * gives the input times n.
+ *
+ * Plans are made on first use and cached per thread, so repeated sizes are
+ * cheap and threads don't share scratch space.
+ */
+
+// plans kept per thread
+#define PLAN_CACHE_SIZE 8
+
+typedef struct fft_cpx {
+    float r;
+    float i;
+} fft_cpx;
+
+enum fft_backend {
+    fft_kiss,     // kissfft, the default
+    fft_stockham, // in-tree mixed radix Stockham autosort
+    fft_fftw      // FFTW, when built with HAVE_FFTW3
+};
+
+// complex, of any length; in may be out
+void fft(int n, bool inverse, fft_cpx *in, fft_cpx *out);
+
+// real forward of even length n into n/2+1 bins, and back
+void fftr(int n, float *in, fft_cpx *out);
+void fftri(int n, fft_cpx *in, float *out);
+
+// the next length at or above n that transforms quickly. it's the same for
+// every backend, so output doesn't depend on which one ran.
+int fft_fast_size(int n);
+
+// chosen before any threads start; false if not built in
+bool set_fft_backend(enum fft_backend backend);
+bool handle_fft_backend(char *name, enum fft_backend *backend);
+
+// times every backend built in at a range of sizes, with each one's largest
+// error against kissfft
+void fft_benchmark(FILE *fh);
+
+#endif
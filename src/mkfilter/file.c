@@ -19,59 +19,709 @@
 
 #include <sndfile.h>
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <err.h>
 #include <string.h>
+#include <ctype.h>
+
+static void put_le(unsigned char *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        p[i] = (v >> (8*i)) & 0xff;
+}
+
+static uint64_t get_le(unsigned char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = bytes-1; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+// converts ct samples of a raw or bank sample type to floats
+static void read_samples(FILE *fh, int type, float *dst, size_t ct, char *path) {
+    int bytes = type == RAW_SAMPLE_INT16 ? 2 : 4;
+    unsigned char block[4096];
+    size_t at = 0;
+    while ( at < ct ) {
+        size_t n = ct-at < 1024 ? ct-at : 1024;
+        if ( fread(block, bytes, n, fh) != n )
+            errx(1, "Bad input file %s: truncated", path);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t bits = get_le(block+i*bytes, bytes);
+            if ( type == RAW_SAMPLE_INT16 )
+                dst[at+i] = (int16_t)bits / 32768.0;
+            else if ( type == RAW_SAMPLE_INT32 )
+                dst[at+i] = (int32_t)bits / 2147483648.0;
+            else
+                memcpy(&dst[at+i], &bits, 4);
+        }
+        at += n;
+    }
+}
+
+static void check_sample_type(int type, char *path) {
+    if ( type != RAW_SAMPLE_FLOAT32 && type != RAW_SAMPLE_INT16 && type != RAW_SAMPLE_INT32 )
+        errx(1, "Bad input file %s: unsupported raw sample type %d", path, type);
+}
+
+// opens path if it starts with the given magic, otherwise returns NULL
+static FILE *open_with_magic(char *path, char *magic) {
+    FILE *fh;
+    if ( (fh = fopen(path, "rb")) == NULL )
+        return NULL;
+    char got[8];
+    if ( fread(got, 1, 8, fh) != 8 || memcmp(got, magic, 8) != 0 ) {
+        fclose(fh);
+        return NULL;
+    }
+    rewind(fh);
+    return fh;
+}
 
 audiobuf *read_file(char *path) {
+    int frames, channels, sr;
+    float *samples = read_frames(path, &frames, &channels, &sr);
+
+    if ( channels > 1 )
+        errx(1, "Bad input file %s: has too many channels (%d, need 1)", path, channels);
+
     audiobuf *buf;
     if ( (buf = malloc(sizeof(audiobuf))) == NULL )
         err(1, "Couldn't malloc space for audiobuf struct");
 
-    SF_INFO info;
-    memset(&info, 0, sizeof(SF_INFO));
+    buf->sr = sr;
+    buf->len = frames;
+    buf->fd = NULL;
+    buf->type = audiobuf_td;
+    buf->td = samples;
 
-    SNDFILE *sf;
-    if ( (sf = sf_open(path, SFM_READ, &info)) == NULL )
-        errx(1, "Couldn't open input file %s for reading", path);
+    expand_buf(buf, 0);
 
-    if ( info.channels > 1 )
-        errx(1, "Bad input file %s: has too many channels (%d, need 1)", path, info.channels);
+    return buf;
+}
 
-    buf->sr = info.samplerate;
-    buf->len = info.frames;
-    buf->fd = NULL;
-    buf->type = audiobuf_td;
+struct framereader {
+    char *path;
+    int channels;
+    SNDFILE *sf;  // sndfile input, or
+    FILE *raw;    // raw input, positioned at the next sample
+    int rawtype;
+    int64_t left; // frames not yet read from raw
+};
 
-    if ( (buf->td = malloc(sizeof(float)*buf->len)) == NULL )
-        err(1, "Couldn't malloc %zu bytes for input buffer for %s", sizeof(float)*buf->len, path);
+framereader *open_frames(char *path, int *frames, int *channels, int *sr) {
+    framereader *r;
+    if ( (r = malloc(sizeof(framereader))) == NULL )
+        err(1, "Couldn't malloc space for reader of %s", path);
+    r->path = path;
+    r->sf = NULL;
+    r->raw = NULL;
 
-    sf_readf_float(sf, buf->td, buf->len);
-    
-    sf_close(sf);
+    if ( (r->raw = open_with_magic(path, RAW_MAGIC)) != NULL ) {
+        unsigned char header[RAW_HEADER_SIZE];
+        if ( fread(header, 1, RAW_HEADER_SIZE, r->raw) != RAW_HEADER_SIZE )
+            errx(1, "Couldn't read raw header from %s", path);
 
-    expand_buf(buf, 0);
+        if ( get_le(header+8, 4) != RAW_VERSION )
+            errx(1, "Bad input file %s: unknown raw format version %d", path, (int)get_le(header+8, 4));
+        r->rawtype = get_le(header+16, 4);
+        check_sample_type(r->rawtype, path);
 
-    return buf;
+        *channels = get_le(header+20, 4);
+        *sr = get_le(header+24, 4);
+        *frames = get_le(header+32, 8);
+        r->left = *frames;
+
+        if ( fseek(r->raw, get_le(header+12, 4), SEEK_SET) )
+            err(1, "Couldn't seek in %s", path);
+    } else {
+        SF_INFO info;
+        memset(&info, 0, sizeof(SF_INFO));
+
+        if ( (r->sf = sf_open(path, SFM_READ, &info)) == NULL )
+            errx(1, "Couldn't open input file %s for reading", path);
+
+        *frames = info.frames;
+        *channels = info.channels;
+        *sr = info.samplerate;
+    }
+
+    r->channels = *channels;
+    return r;
 }
 
-void write_file(audiobuf *buf, char *path) {
-    convert_buf(buf, audiobuf_td);
+int read_some_frames(framereader *r, float *samples, int ct) {
+    if ( r->sf )
+        return sf_readf_float(r->sf, samples, ct);
+
+    if ( ct > r->left )
+        ct = r->left;
+    read_samples(r->raw, r->rawtype, samples, (size_t)ct*r->channels, r->path);
+    r->left -= ct;
+    return ct;
+}
+
+void close_frames(framereader *r) {
+    if ( r->sf )
+        sf_close(r->sf);
+    else
+        fclose(r->raw);
+    free(r);
+}
+
+float *read_frames(char *path, int *frames, int *channels, int *sr) {
+    framereader *r = open_frames(path, frames, channels, sr);
+
+    float *samples;
+    size_t bytes = sizeof(float)*(size_t)*frames * *channels;
+    if ( (samples = malloc(bytes > 0 ? bytes : 1)) == NULL )
+        err(1, "Couldn't malloc %zu bytes for input buffer for %s", bytes, path);
 
+    read_some_frames(r, samples, *frames);
+
+    close_frames(r);
+
+    return samples;
+}
+
+static audiobuf **read_bank(FILE *fh, char *path, int *ct) {
+    unsigned char header[BANK_HEADER_SIZE];
+    if ( fread(header, 1, BANK_HEADER_SIZE, fh) != BANK_HEADER_SIZE )
+        errx(1, "Couldn't read bank header from %s", path);
+
+    if ( get_le(header+8, 4) != BANK_VERSION )
+        errx(1, "Bad bank %s: unknown format version %d", path, (int)get_le(header+8, 4));
+    int type = get_le(header+16, 4);
+    check_sample_type(type, path);
+    *ct = get_le(header+20, 4);
+    int entrysize = get_le(header+24, 4);
+    if ( *ct < 1 || entrysize < 20 )
+        errx(1, "Bad bank %s: has %d filters of %d byte entries", path, *ct, entrysize);
+
+    unsigned char *table;
+    size_t tablesize = (size_t)entrysize * *ct;
+    if ( (table = malloc(tablesize)) == NULL )
+        err(1, "Couldn't malloc %zu bytes for the table of %s", tablesize, path);
+    if ( fseek(fh, get_le(header+12, 4), SEEK_SET) || fread(table, 1, tablesize, fh) != tablesize )
+        errx(1, "Bad bank %s: truncated table", path);
+
+    audiobuf **bufs;
+    if ( (bufs = malloc(sizeof(audiobuf*) * *ct)) == NULL )
+        err(1, "Couldn't malloc space for the filters of %s", path);
+
+    for (int i = 0; i < *ct; i++) {
+        unsigned char *entry = table + (size_t)entrysize*i;
+
+        audiobuf *buf;
+        if ( (buf = malloc(sizeof(audiobuf))) == NULL )
+            err(1, "Couldn't malloc space for audiobuf struct");
+        buf->len = get_le(entry+8, 8);
+        buf->sr = get_le(entry+16, 4);
+        buf->fd = NULL;
+        buf->type = audiobuf_td;
+        if ( (buf->td = malloc(sizeof(float)*(buf->len > 0 ? buf->len : 1))) == NULL )
+            err(1, "Couldn't malloc %zu bytes for filter %d of %s", sizeof(float)*buf->len, i+1, path);
+
+        if ( fseek(fh, get_le(entry, 8), SEEK_SET) )
+            err(1, "Couldn't seek in %s", path);
+        read_samples(fh, type, buf->td, buf->len, path);
+
+        expand_buf(buf, 0);
+        bufs[i] = buf;
+    }
+
+    free(table);
+    return bufs;
+}
+
+audiobuf **read_filters(char *path, int *ct) {
+    FILE *fh;
+    if ( (fh = open_with_magic(path, BANK_MAGIC)) != NULL ) {
+        audiobuf **bufs = read_bank(fh, path, ct);
+        fclose(fh);
+        return bufs;
+    }
+
+    int frames, channels, sr;
+    float *samples = read_frames(path, &frames, &channels, &sr);
+
+    audiobuf **bufs;
+    if ( (bufs = malloc(sizeof(audiobuf*)*channels)) == NULL )
+        err(1, "Couldn't malloc space for the filters of %s", path);
+
+    for (int c = 0; c < channels; c++) {
+        audiobuf *buf;
+        if ( (buf = malloc(sizeof(audiobuf))) == NULL )
+            err(1, "Couldn't malloc space for audiobuf struct");
+        buf->len = frames;
+        buf->sr = sr;
+        buf->fd = NULL;
+        buf->type = audiobuf_td;
+        if ( (buf->td = malloc(sizeof(float)*(frames > 0 ? frames : 1))) == NULL )
+            err(1, "Couldn't malloc %zu bytes for filter %d of %s", sizeof(float)*frames, c+1, path);
+        for (int i = 0; i < frames; i++)
+            buf->td[i] = samples[(size_t)i*channels+c];
+
+        expand_buf(buf, 0);
+        bufs[c] = buf;
+    }
+
+    free(samples);
+    *ct = channels;
+    return bufs;
+}
+
+char **read_file_list(char *path, int *ct) {
+    FILE *fh;
+    if ( strcmp(path, "-") == 0 )
+        fh = stdin;
+    else if ( (fh = fopen(path, "r")) == NULL )
+        err(1, "Couldn't open file list %s", path);
+
+    int malloced = 16;
+    char **paths;
+    if ( (paths = malloc(sizeof(char*)*malloced)) == NULL )
+        err(1, "Couldn't allocate space for file list");
+    *ct = 0;
+
+    char *line = NULL;
+    size_t linesize = 0;
+    ssize_t got;
+    while ( (got = getline(&line, &linesize, fh)) != -1 ) {
+        while ( got > 0 && (line[got-1] == '\n' || line[got-1] == '\r') )
+            line[--got] = '\0';
+        if ( got == 0 || line[0] == '#' )
+            continue;
+
+        if ( *ct == malloced ) {
+            malloced *= 2;
+            if ( (paths = realloc(paths, sizeof(char*)*malloced)) == NULL )
+                err(1, "Couldn't allocate space for file list");
+        }
+        paths[(*ct)++] = strdup(line);
+    }
+    if ( ferror(fh) )
+        err(1, "Couldn't read file list %s", path);
+
+    free(line);
+    if ( fh != stdin )
+        fclose(fh);
+
+    return paths;
+}
+
+static void write_sndfile(float *samples, int frames, int channels, int sr, char *path, int format) {
     SF_INFO info;
     memset(&info, 0, sizeof(SF_INFO));
 
-    info.samplerate = buf->sr;
-    info.channels = 1;
-    info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_24 | SF_ENDIAN_FILE;
+    info.samplerate = sr;
+    info.channels = channels;
+    info.format = format;
 
     SNDFILE *sf;
     if ( (sf = sf_open(path, SFM_WRITE, &info)) == NULL )
         errx(1, "Couldn't open output file %s for writing", path);
 
-    sf_writef_float(sf, buf->td, buf->len);
+    sf_writef_float(sf, samples, frames);
 
     if ( sf_close(sf) )
         errx(1, "Couldn't close output file for %s: %s", path, sf_strerror(sf));
 }
 
+static FILE *open_output(char *path) {
+    FILE *fh;
+    if ( (fh = fopen(path, "wb")) == NULL )
+        err(1, "Couldn't open output file %s for writing", path);
+    return fh;
+}
+
+static void close_output(FILE *fh, char *path) {
+    if ( fclose(fh) )
+        err(1, "Couldn't close output file %s", path);
+}
+
+// writes ct floats as little-endian IEEE singles
+static void write_floats_le(FILE *fh, float *samples, size_t ct, char *path) {
+    unsigned char block[4096];
+    while ( ct > 0 ) {
+        size_t n = ct < 1024 ? ct : 1024;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t bits;
+            memcpy(&bits, &samples[i], 4);
+            put_le(block+i*4, bits, 4);
+        }
+        if ( fwrite(block, 4, n, fh) != n )
+            err(1, "Couldn't write to %s", path);
+        samples += n;
+        ct -= n;
+    }
+}
+
+// writes ct integers as little-endian two's complement of the given size
+static void write_ints_le(FILE *fh, int32_t *samples, size_t ct, int bytes, char *path) {
+    unsigned char block[4096];
+    while ( ct > 0 ) {
+        size_t n = ct < 1024 ? ct : 1024;
+        for (size_t i = 0; i < n; i++)
+            put_le(block+i*bytes, (uint32_t)samples[i], bytes);
+        if ( fwrite(block, bytes, n, fh) != n )
+            err(1, "Couldn't write to %s", path);
+        samples += n;
+        ct -= n;
+    }
+}
+
+/*
+ * The writers below take either float samples, or fixed point samples when
+ * fixed is not NULL, with bits being 16 or 32.
+ */
+
+static void write_raw(float *samples, int32_t *fixed, int bits, int frames, int channels, int sr, char *path) {
+    unsigned char header[RAW_HEADER_SIZE];
+    memset(header, 0, RAW_HEADER_SIZE);
+
+    memcpy(header, RAW_MAGIC, 8);
+    put_le(header+8,  RAW_VERSION, 4);
+    put_le(header+12, RAW_HEADER_SIZE, 4);
+    put_le(header+16, !fixed ? RAW_SAMPLE_FLOAT32 : bits == 16 ? RAW_SAMPLE_INT16 : RAW_SAMPLE_INT32, 4);
+    put_le(header+20, channels, 4);
+    put_le(header+24, sr, 4);
+    put_le(header+32, frames, 8);
+
+    FILE *fh = open_output(path);
+    if ( fwrite(header, 1, RAW_HEADER_SIZE, fh) != RAW_HEADER_SIZE )
+        err(1, "Couldn't write to %s", path);
+    if ( fixed )
+        write_ints_le(fh, fixed, (size_t)frames*channels, bits/8, path);
+    else
+        write_floats_le(fh, samples, (size_t)frames*channels, path);
+    close_output(fh, path);
+}
+
+static void write_npy(float *samples, int32_t *fixed, int bits, int frames, int channels, char *path) {
+    char *descr = !fixed ? "<f4" : bits == 16 ? "<i2" : "<i4";
+    char dict[128];
+    if ( channels == 1 )
+        snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%d,), }", descr, frames);
+    else
+        snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %d), }", descr, frames, channels);
+
+    // magic, version and length take 10 bytes; the dict is padded with
+    // spaces and a newline so the data starts 64 byte aligned
+    int dictlen = strlen(dict);
+    int headerlen = (10 + dictlen + 1 + 63) / 64 * 64 - 10;
+
+    unsigned char header[10];
+    memcpy(header, "\x93NUMPY\x01\x00", 8);
+    put_le(header+8, headerlen, 2);
+
+    FILE *fh = open_output(path);
+    fwrite(header, 1, 10, fh);
+    fprintf(fh, "%-*s\n", headerlen-1, dict);
+    if ( fixed )
+        write_ints_le(fh, fixed, (size_t)frames*channels, bits/8, path);
+    else
+        write_floats_le(fh, samples, (size_t)frames*channels, path);
+    close_output(fh, path);
+}
+
+// one array element, as a literal
+static void print_sample(FILE *fh, float *samples, int32_t *fixed, int bits, size_t i) {
+    if ( !fixed )
+        fprintf(fh, "%.9ef", samples[i]);
+    else if ( bits == 32 && fixed[i] == INT32_MIN )
+        fprintf(fh, "INT32_MIN"); // -2147483648 is a negated long
+    else
+        fprintf(fh, "%*d", bits == 16 ? 6 : 11, (int)fixed[i]);
+}
+
+static void write_header(float *samples, int32_t *fixed, int bits, int frames, int channels, int sr, char *path) {
+    // the array is named after the file: foo/low-pass.h becomes low_pass
+    char *base = strrchr(path, '/') ? strrchr(path, '/')+1 : path;
+    char *name;
+    if ( (name = malloc(strlen(base)+2)) == NULL )
+        err(1, "Couldn't malloc space for array name");
+    char *n = name;
+    if ( isdigit(*base) )
+        *n++ = '_';
+    for (char *b = base; *b && *b != '.'; b++)
+        *n++ = isalnum(*b) ? *b : '_';
+    *n = '\0';
+    if ( n == name )
+        strcpy(name, "filter");
+
+    char *upper = strdup(name);
+    for (char *u = upper; *u; u++)
+        *u = toupper(*u);
+
+    FILE *fh = open_output(path);
+    fprintf(fh, "/* generated by mkfilter */\n\n");
+    fprintf(fh, "#ifndef %s_H\n#define %s_H\n\n", upper, upper);
+    fprintf(fh, "#define %s_LENGTH %d\n", upper, frames);
+    fprintf(fh, "#define %s_CHANNELS %d\n", upper, channels);
+    fprintf(fh, "#define %s_SAMPLERATE %d\n", upper, sr);
+    if ( fixed )
+        fprintf(fh, "#define %s_FRACTIONAL_BITS %d\n", upper, bits-1);
+    fprintf(fh, "\n");
+
+    char *type = "float";
+    int perline = 6;
+    if ( fixed ) {
+        fprintf(fh, "#include <stdint.h>\n\n");
+        type = bits == 16 ? "int16_t" : "int32_t";
+        perline = bits == 16 ? 10 : 6;
+    }
+
+    if ( channels == 1 )
+        fprintf(fh, "static const %s %s[%d] = {", type, name, frames);
+    else
+        fprintf(fh, "static const %s %s[%d][%d] = {", type, name, frames, channels);
+
+    for (int i = 0; i < frames; i++) {
+        if ( channels == 1 ) {
+            fprintf(fh, "%s", i % perline ? " " : "\n    ");
+            print_sample(fh, samples, fixed, bits, i);
+            fprintf(fh, ",");
+        } else {
+            fprintf(fh, "\n    {");
+            for (int c = 0; c < channels; c++) {
+                fprintf(fh, "%s", c ? ", " : "");
+                print_sample(fh, samples, fixed, bits, (size_t)i*channels+c);
+            }
+            fprintf(fh, "},");
+        }
+    }
+    fprintf(fh, "\n};\n\n#endif\n");
+
+    close_output(fh, path);
+    free(name);
+    free(upper);
+}
+
+void write_frames(float *samples, int frames, int channels, int sr, char *path, enum file_format format) {
+    switch ( format ) {
+        case format_wav24:
+            write_sndfile(samples, frames, channels, sr, path, SF_FORMAT_WAV | SF_FORMAT_PCM_24 | SF_ENDIAN_FILE);
+            break;
+
+        case format_wav32f:
+            write_sndfile(samples, frames, channels, sr, path, SF_FORMAT_WAV | SF_FORMAT_FLOAT | SF_ENDIAN_FILE);
+            break;
+
+        case format_wav64f:
+            write_sndfile(samples, frames, channels, sr, path, SF_FORMAT_WAV | SF_FORMAT_DOUBLE | SF_ENDIAN_FILE);
+            break;
+
+        case format_raw:
+            write_raw(samples, NULL, 0, frames, channels, sr, path);
+            break;
+
+        case format_npy:
+            write_npy(samples, NULL, 0, frames, channels, path);
+            break;
+
+        case format_header:
+            write_header(samples, NULL, 0, frames, channels, sr, path);
+            break;
+
+        case format_bank:
+            errx(1, "The bank format holds filters, not audio");
+
+        default:
+            errx(1, "not reached");
+    }
+}
+
+void write_fixed_frames(int32_t *samples, int bits, int frames, int channels, int sr, char *path, enum file_format format) {
+    switch ( format ) {
+        case format_wav24:
+        case format_wav32f:
+        case format_wav64f: {
+            // libsndfile wants integers left justified in an int
+            size_t ct = (size_t)frames*channels;
+            int *left;
+            if ( (left = malloc(sizeof(int)*ct)) == NULL )
+                err(1, "Couldn't malloc %zu bytes for output samples", sizeof(int)*ct);
+            for (size_t i = 0; i < ct; i++)
+                left[i] = (uint32_t)samples[i] << (32-bits);
+
+            SF_INFO info;
+            memset(&info, 0, sizeof(SF_INFO));
+            info.samplerate = sr;
+            info.channels = channels;
+            info.format = SF_FORMAT_WAV | (bits == 16 ? SF_FORMAT_PCM_16 : SF_FORMAT_PCM_32) | SF_ENDIAN_FILE;
+
+            SNDFILE *sf;
+            if ( (sf = sf_open(path, SFM_WRITE, &info)) == NULL )
+                errx(1, "Couldn't open output file %s for writing", path);
+
+            sf_writef_int(sf, left, frames);
+
+            if ( sf_close(sf) )
+                errx(1, "Couldn't close output file for %s: %s", path, sf_strerror(sf));
+            free(left);
+            break;
+        }
+
+        case format_raw:
+            write_raw(NULL, samples, bits, frames, channels, sr, path);
+            break;
+
+        case format_npy:
+            write_npy(NULL, samples, bits, frames, channels, path);
+            break;
+
+        case format_header:
+            write_header(NULL, samples, bits, frames, channels, sr, path);
+            break;
+
+        case format_bank:
+            errx(1, "The bank format holds filters, not audio");
+
+        default:
+            errx(1, "not reached");
+    }
+}
+
+void write_file(audiobuf *buf, char *path, enum file_format format) {
+    convert_buf(buf, audiobuf_td);
+    write_frames(buf->td, buf->len, 1, buf->sr, path, format);
+}
+
+static void write_bank(audiobuf **bufs, int32_t **fixed, int bits, int ct, char *path) {
+    int bytes = fixed ? bits/8 : 4;
+
+    size_t tablesize = (size_t)BANK_ENTRY_SIZE*ct;
+    unsigned char *head;
+    size_t headsize = (BANK_HEADER_SIZE + tablesize + BANK_ALIGN-1) / BANK_ALIGN * BANK_ALIGN;
+    if ( (head = calloc(headsize, 1)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for bank header", headsize);
+
+    memcpy(head, BANK_MAGIC, 8);
+    put_le(head+8,  BANK_VERSION, 4);
+    put_le(head+12, BANK_HEADER_SIZE, 4);
+    put_le(head+16, !fixed ? RAW_SAMPLE_FLOAT32 : bits == 16 ? RAW_SAMPLE_INT16 : RAW_SAMPLE_INT32, 4);
+    put_le(head+20, ct, 4);
+    put_le(head+24, BANK_ENTRY_SIZE, 4);
+
+    uint64_t offset = headsize;
+    for (int i = 0; i < ct; i++) {
+        unsigned char *entry = head + BANK_HEADER_SIZE + (size_t)BANK_ENTRY_SIZE*i;
+        put_le(entry,    offset, 8);
+        put_le(entry+8,  bufs[i]->len, 8);
+        put_le(entry+16, bufs[i]->sr, 4);
+        offset += ((uint64_t)bufs[i]->len*bytes + BANK_ALIGN-1) / BANK_ALIGN * BANK_ALIGN;
+    }
+
+    FILE *fh = open_output(path);
+    if ( fwrite(head, 1, headsize, fh) != headsize )
+        err(1, "Couldn't write to %s", path);
+
+    unsigned char zeros[BANK_ALIGN];
+    memset(zeros, 0, BANK_ALIGN);
+    for (int i = 0; i < ct; i++) {
+        if ( fixed )
+            write_ints_le(fh, fixed[i], bufs[i]->len, bytes, path);
+        else
+            write_floats_le(fh, bufs[i]->td, bufs[i]->len, path);
+        size_t pad = (BANK_ALIGN - (size_t)bufs[i]->len*bytes % BANK_ALIGN) % BANK_ALIGN;
+        if ( fwrite(zeros, 1, pad, fh) != pad )
+            err(1, "Couldn't write to %s", path);
+    }
+
+    close_output(fh, path);
+    free(head);
+}
+
+void write_filters(audiobuf **bufs, int32_t **fixed, int bits, int ct, char *path, enum file_format format) {
+    for (int i = 0; i < ct; i++)
+        convert_buf(bufs[i], audiobuf_td);
+
+    if ( format == format_bank ) {
+        write_bank(bufs, fixed, bits, ct, path);
+        return;
+    }
+
+    int frames = 0;
+    for (int i = 0; i < ct; i++) {
+        if ( bufs[i]->sr != bufs[0]->sr )
+            errx(1, "Filter %d has sample rate %d, not %d; only a bank can mix sample rates", i+1, bufs[i]->sr, bufs[0]->sr);
+        if ( frames < bufs[i]->len )
+            frames = bufs[i]->len;
+    }
+
+    // interleave, zero padding the shorter filters at the end
+    size_t total = (size_t)frames*ct;
+    float *samples = NULL;
+    int32_t *ints = NULL;
+    if ( fixed ) {
+        if ( (ints = calloc(total, sizeof(int32_t))) == NULL )
+            err(1, "Couldn't allocate %zu bytes for output samples", sizeof(int32_t)*total);
+    } else {
+        if ( (samples = calloc(total, sizeof(float))) == NULL )
+            err(1, "Couldn't allocate %zu bytes for output samples", sizeof(float)*total);
+    }
+
+    for (int c = 0; c < ct; c++)
+        for (int i = 0; i < bufs[c]->len; i++) {
+            if ( fixed )
+                ints[(size_t)i*ct+c] = fixed[c][i];
+            else
+                samples[(size_t)i*ct+c] = bufs[c]->td[i];
+        }
+
+    if ( fixed )
+        write_fixed_frames(ints, bits, frames, ct, bufs[0]->sr, path, format);
+    else
+        write_frames(samples, frames, ct, bufs[0]->sr, path, format);
+
+    free(samples);
+    free(ints);
+}
+
+void write_partitions(partitions *p, char *path) {
+    size_t tablesize = (size_t)PARTS_ENTRY_SIZE*p->ct;
+    size_t headsize = (PARTS_HEADER_SIZE + tablesize + PARTS_ALIGN-1) / PARTS_ALIGN * PARTS_ALIGN;
+    unsigned char *head;
+    if ( (head = calloc(headsize, 1)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for partitions header", headsize);
+
+    memcpy(head, PARTS_MAGIC, 8);
+    put_le(head+8,  PARTS_VERSION, 4);
+    put_le(head+12, PARTS_HEADER_SIZE, 4);
+    put_le(head+16, PARTS_FFT_KISS_REAL, 4);
+    put_le(head+20, p->ct, 4);
+    put_le(head+24, PARTS_ENTRY_SIZE, 4);
+    put_le(head+28, p->sr, 4);
+    put_le(head+32, p->block, 4);
+    put_le(head+40, p->taps, 8);
+
+    uint64_t offset = headsize;
+    for (int i = 0; i < p->ct; i++) {
+        unsigned char *entry = head + PARTS_HEADER_SIZE + (size_t)PARTS_ENTRY_SIZE*i;
+        put_le(entry,    offset, 8);
+        put_le(entry+8,  p->start[i], 8);
+        put_le(entry+16, p->size[i], 4);
+        put_le(entry+20, p->size[i]+1, 4);
+        offset += ((uint64_t)(p->size[i]+1)*8 + PARTS_ALIGN-1) / PARTS_ALIGN * PARTS_ALIGN;
+    }
+
+    FILE *fh = open_output(path);
+    if ( fwrite(head, 1, headsize, fh) != headsize )
+        err(1, "Couldn't write to %s", path);
+
+    unsigned char zeros[PARTS_ALIGN];
+    memset(zeros, 0, PARTS_ALIGN);
+    for (int i = 0; i < p->ct; i++) {
+        size_t floats = (size_t)(p->size[i]+1)*2;
+        write_floats_le(fh, (float*)p->spectra[i], floats, path);
+        size_t pad = (PARTS_ALIGN - floats*4 % PARTS_ALIGN) % PARTS_ALIGN;
+        if ( fwrite(zeros, 1, pad, fh) != pad )
+            err(1, "Couldn't write to %s", path);
+    }
+
+    close_output(fh, path);
+    free(head);
+}
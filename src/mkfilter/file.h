@@ -19,9 +19,139 @@
 #define __FILE_H__
 
 #include "audiobuf.h"
+#include "partition.h"
+
+#include <stdint.h>
+
+enum file_format {
+    format_wav24,   // 24 bit integer WAV
+    format_wav32f,  // 32 bit float WAV
+    format_wav64f,  // 64 bit float WAV
+    format_raw,     // mkfilter raw format, see below
+    format_npy,     // NumPy .npy array
+    format_header,  // C header with a static const array
+    format_bank     // mkfilter indexed filter bank, see below
+};
+
+/*
+ * The raw format is a 64 byte little-endian header followed directly by the
+ * interleaved samples, so the data is 64 byte aligned in a mapped file:
+ *
+ *     offset  size  contents
+ *          0     8  magic, "MKFILTER"
+ *          8     4  format version, currently 1
+ *         12     4  header size in bytes (offset of the samples)
+ *         16     4  sample type, see RAW_SAMPLE_*
+ *         20     4  channels
+ *         24     4  sample rate
+ *         28     4  reserved, 0
+ *         32     8  frames
+ *         40    24  reserved, 0
+ */
+#define RAW_MAGIC "MKFILTER"
+#define RAW_VERSION 1
+#define RAW_HEADER_SIZE 64
+#define RAW_SAMPLE_FLOAT32 1
+#define RAW_SAMPLE_INT16 2 // Q15 fixed point
+#define RAW_SAMPLE_INT32 3 // Q31 fixed point
+
+/*
+ * A bank holds several filters, each of its own length, for a runtime to map
+ * and look up by index. It is a 64 byte little-endian header, a table with one
+ * entry per filter, then the samples of each filter starting 64 byte aligned:
+ *
+ *     offset  size  contents
+ *          0     8  magic, "MKFLTBNK"
+ *          8     4  format version, currently 1
+ *         12     4  header size in bytes (offset of the table)
+ *         16     4  sample type, see RAW_SAMPLE_*
+ *         20     4  filters
+ *         24     4  table entry size in bytes
+ *         28    36  reserved, 0
+ *
+ * and each table entry is
+ *
+ *          0     8  offset of the samples from the start of the file
+ *          8     8  length in samples
+ *         16     4  sample rate
+ *         20    12  reserved, 0
+ */
+#define BANK_MAGIC "MKFLTBNK"
+#define BANK_VERSION 1
+#define BANK_HEADER_SIZE 64
+#define BANK_ENTRY_SIZE 32
+#define BANK_ALIGN 64
+
+/*
+ * A partitions file holds a filter already transformed for partitioned
+ * convolution, so a runtime can map it and start without any transforms. It
+ * is a 64 byte little-endian header, a table with one entry per partition,
+ * then the spectrum of each partition starting 64 byte aligned:
+ *
+ *     offset  size  contents
+ *          0     8  magic, "MKFPARTS"
+ *          8     4  format version, currently 1
+ *         12     4  header size in bytes (offset of the table)
+ *         16     4  fft convention, see PARTS_FFT_*
+ *         20     4  partitions
+ *         24     4  table entry size in bytes
+ *         28     4  sample rate
+ *         32     4  block size (of the first partition)
+ *         36     4  reserved, 0
+ *         40     8  filter length in taps
+ *         48    16  reserved, 0
+ *
+ * and each table entry is
+ *
+ *          0     8  offset of the spectrum from the start of the file
+ *          8     8  first tap of the partition
+ *         16     4  partition size P in taps; the transform size is 2P
+ *         20     4  bins, P+1
+ *         24     8  reserved, 0
+ *
+ * A spectrum is its bins as interleaved real and imaginary float32s.
+ */
+#define PARTS_MAGIC "MKFPARTS"
+#define PARTS_VERSION 1
+#define PARTS_HEADER_SIZE 64
+#define PARTS_ENTRY_SIZE 32
+#define PARTS_ALIGN 64
+
+// bins 0 to N/2 of the unscaled forward transform X[k] = sum x[n] e^(-2 pi i kn/N),
+// as fftr gives them. an unscaled inverse must be divided by N.
+#define PARTS_FFT_KISS_REAL 1
 
 audiobuf *read_file(char *path);
-void write_file(audiobuf *buf, char *path);
 
-#endif
+// reads all channels of an audio file as interleaved samples, the caller frees
+float *read_frames(char *path, int *frames, int *channels, int *sr);
+
+// reads an audio file a block at a time, for inputs too long to hold at once
+typedef struct framereader framereader;
+framereader *open_frames(char *path, int *frames, int *channels, int *sr);
+// reads up to ct frames of interleaved samples, returning how many were read
+int read_some_frames(framereader *r, float *samples, int ct);
+void close_frames(framereader *r);
+
+// every filter of a bank, or one filter per channel of any other file
+audiobuf **read_filters(char *path, int *ct);
+void write_file(audiobuf *buf, char *path, enum file_format format);
+
+// one path per line, skipping blank lines and # comments. "-" reads stdin.
+char **read_file_list(char *path, int *ct);
 
+// samples holds frames*channels interleaved samples
+void write_frames(float *samples, int frames, int channels, int sr, char *path, enum file_format format);
+
+// integer samples in Q15 (bits = 16) or Q31 (bits = 32). the WAV formats all
+// become 16 or 32 bit PCM.
+void write_fixed_frames(int32_t *samples, int bits, int frames, int channels, int sr, char *path, enum file_format format);
+
+// ct filters in one file: a bank with format_bank, otherwise one channel per
+// filter, zero padded to the longest. fixed is NULL, or holds the Q15/Q31
+// coefficients of each filter.
+void write_filters(audiobuf **bufs, int32_t **fixed, int bits, int ct, char *path, enum file_format format);
+
+void write_partitions(partitions *p, char *path);
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "fir.h"
+#include "quantize.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <err.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIR_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+int fir_length(audiobuf *filter) {
+    convert_buf(filter, audiobuf_td);
+
+    // loaded filters are zero padded up to a fast fft size; those taps
+    // would only cost time
+    int len = filter->len;
+    while ( len > 1 && filter->td[len-1] == 0 )
+        len--;
+
+    // windows that are zero at both ends lose the last tap to that, and
+    // with it the symmetry the folded kernel needs. the leading zeros
+    // can't go without moving the delay, so the trailing ones come back.
+    int lead = 0;
+    while ( lead < len && filter->td[lead] == 0 )
+        lead++;
+    if ( lead > 0 && lead < len && len+lead <= filter->len && fir_is_symmetric(filter->td, len+lead) )
+        len += lead;
+    return len;
+}
+
+bool fir_is_symmetric(float *h, int len) {
+    float max = 0;
+    for (int i = 0; i < len; i++)
+        if ( max < fabsf(h[i]) )
+            max = fabsf(h[i]);
+
+    // symmetric up to float rounding, as the sinc based designs are
+    for (int i = 0; i < len/2; i++)
+        if ( fabsf(h[i] - h[len-1-i]) > max*1e-6 )
+            return false;
+    return true;
+}
+
+fir *fir_alloc(audiobuf *filter, int channels) {
+    fir *f;
+    if ( (f = malloc(sizeof(fir))) == NULL )
+        err(1, "Couldn't allocate space for fir struct");
+
+    int len = fir_length(filter);
+
+    float *h = filter->td;
+    f->symmetric = fir_is_symmetric(h, len);
+
+    f->len = len;
+    f->channels = channels;
+
+    if ( (f->taps = malloc(sizeof(float)*len)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for fir taps", sizeof(float)*len);
+
+    if ( f->symmetric ) {
+        for (int i = 0; i < len/2; i++)
+            f->taps[i] = (h[i] + h[len-1-i]) / 2;
+        if ( len % 2 )
+            f->taps[len/2] = h[len/2];
+    } else {
+        for (int i = 0; i < len; i++)
+            f->taps[i] = h[len-1-i];
+    }
+
+    if ( (f->hist = malloc(sizeof(float*)*channels)) == NULL )
+        err(1, "Couldn't allocate space for fir history");
+    for (int c = 0; c < channels; c++)
+        if ( (f->hist[c] = calloc(len-1+FIR_BLOCK, sizeof(float))) == NULL )
+            err(1, "Couldn't allocate %zu bytes for fir history", sizeof(float)*(len-1+FIR_BLOCK));
+
+#ifdef FIR_HAVE_AVX2
+    f->avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    f->avx2 = false;
+#endif
+
+    return f;
+}
+
+void fir_free(fir *f) {
+    for (int c = 0; c < f->channels; c++)
+        free(f->hist[c]);
+    free(f->hist);
+    free(f->taps);
+    free(f);
+}
+
+// y[j] for j < n from x[j .. j+len-1], x holding the oldest sample first
+static void fir_block_scalar(fir *f, const float *x, float *y, int n) {
+    int len = f->len;
+    float *t = f->taps;
+
+    if ( f->symmetric ) {
+        for (int j = 0; j < n; j++) {
+            float acc = 0;
+            for (int k = 0; k < len/2; k++)
+                acc += t[k] * (x[j+k] + x[j+len-1-k]);
+            if ( len % 2 )
+                acc += t[len/2] * x[j+len/2];
+            y[j] = acc;
+        }
+    } else {
+        for (int j = 0; j < n; j++) {
+            float acc = 0;
+            for (int k = 0; k < len; k++)
+                acc += t[k] * x[j+k];
+            y[j] = acc;
+        }
+    }
+}
+
+#ifdef FIR_HAVE_AVX2
+// 16 outputs at a time, each tap broadcast once against two vectors
+__attribute__((target("avx2,fma")))
+static void fir_block_avx2(fir *f, const float *x, float *y, int n) {
+    int len = f->len;
+    float *t = f->taps;
+    int j = 0;
+
+    for (; j+16 <= n; j += 16) {
+        const float *xj = x+j;
+        __m256 a0 = _mm256_setzero_ps();
+        __m256 a1 = _mm256_setzero_ps();
+
+        if ( f->symmetric ) {
+            for (int k = 0; k < len/2; k++) {
+                __m256 tk = _mm256_broadcast_ss(t+k);
+                __m256 s0 = _mm256_add_ps(_mm256_loadu_ps(xj+k),   _mm256_loadu_ps(xj+len-1-k));
+                __m256 s1 = _mm256_add_ps(_mm256_loadu_ps(xj+k+8), _mm256_loadu_ps(xj+len-1-k+8));
+                a0 = _mm256_fmadd_ps(tk, s0, a0);
+                a1 = _mm256_fmadd_ps(tk, s1, a1);
+            }
+            if ( len % 2 ) {
+                __m256 tk = _mm256_broadcast_ss(t+len/2);
+                a0 = _mm256_fmadd_ps(tk, _mm256_loadu_ps(xj+len/2),   a0);
+                a1 = _mm256_fmadd_ps(tk, _mm256_loadu_ps(xj+len/2+8), a1);
+            }
+        } else {
+            for (int k = 0; k < len; k++) {
+                __m256 tk = _mm256_broadcast_ss(t+k);
+                a0 = _mm256_fmadd_ps(tk, _mm256_loadu_ps(xj+k),   a0);
+                a1 = _mm256_fmadd_ps(tk, _mm256_loadu_ps(xj+k+8), a1);
+            }
+        }
+
+        _mm256_storeu_ps(y+j,   a0);
+        _mm256_storeu_ps(y+j+8, a1);
+    }
+
+    fir_block_scalar(f, x+j, y+j, n-j);
+}
+#endif
+
+void fir_process(fir *f, const float *in, float *out, int frames) {
+    int keep = f->len-1;
+    float y[FIR_BLOCK];
+
+    for (int at = 0; at < frames; at += FIR_BLOCK) {
+        int n = frames-at < FIR_BLOCK ? frames-at : FIR_BLOCK;
+
+        for (int c = 0; c < f->channels; c++) {
+            float *x = f->hist[c];
+
+            // deinterleave behind the history
+            for (int i = 0; i < n; i++)
+                x[keep+i] = in[(size_t)(at+i)*f->channels + c];
+
+#ifdef FIR_HAVE_AVX2
+            if ( f->avx2 )
+                fir_block_avx2(f, x, y, n);
+            else
+#endif
+                fir_block_scalar(f, x, y, n);
+
+            for (int i = 0; i < n; i++)
+                out[(size_t)(at+i)*f->channels + c] = y[i];
+
+            memmove(x, x+n, sizeof(float)*keep);
+        }
+    }
+}
+
+fixedfir *fixedfir_alloc(int32_t *coeffs, int len, int bits, int channels) {
+    fixedfir *f;
+    if ( (f = malloc(sizeof(fixedfir))) == NULL )
+        err(1, "Couldn't allocate space for fixedfir struct");
+
+    while ( len > 1 && coeffs[len-1] == 0 )
+        len--;
+
+    f->len = len;
+    f->bits = bits;
+    f->channels = channels;
+
+    if ( (f->taps = malloc(sizeof(int32_t)*len)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for fir taps", sizeof(int32_t)*len);
+    for (int i = 0; i < len; i++)
+        f->taps[i] = coeffs[len-1-i];
+
+    if ( (f->hist = malloc(sizeof(int32_t*)*channels)) == NULL )
+        err(1, "Couldn't allocate space for fir history");
+    for (int c = 0; c < channels; c++)
+        if ( (f->hist[c] = calloc(len-1+FIR_BLOCK, sizeof(int32_t))) == NULL )
+            err(1, "Couldn't allocate %zu bytes for fir history", sizeof(int32_t)*(len-1+FIR_BLOCK));
+
+    return f;
+}
+
+void fixedfir_free(fixedfir *f) {
+    for (int c = 0; c < f->channels; c++)
+        free(f->hist[c]);
+    free(f->hist);
+    free(f->taps);
+    free(f);
+}
+
+static int32_t fixedfir_sample(fixedfir *f, const int32_t *x) {
+    int len = f->len;
+    int32_t *t = f->taps;
+    int64_t acc = 0;
+
+    if ( f->bits == 16 ) {
+        // Q15 * Q15 products summed exactly as Q30
+        for (int k = 0; k < len; k++)
+            acc += (int64_t)t[k] * x[k];
+        acc = (acc + (1 << 14)) >> 15;
+    } else {
+        // Q31 * Q31 products rounded to Q31, then summed
+        for (int k = 0; k < len; k++)
+            acc += ((int64_t)t[k] * x[k] + (1 << 30)) >> 31;
+    }
+
+    int64_t max = ((int64_t)1 << (f->bits-1)) - 1;
+    if ( acc > max )
+        return max;
+    if ( acc < -max-1 )
+        return -max-1;
+    return acc;
+}
+
+void fixedfir_process(fixedfir *f, const float *in, float *out, int frames) {
+    int keep = f->len-1;
+    double scale = ldexp(1, f->bits-1);
+
+    for (int at = 0; at < frames; at += FIR_BLOCK) {
+        int n = frames-at < FIR_BLOCK ? frames-at : FIR_BLOCK;
+
+        for (int c = 0; c < f->channels; c++) {
+            int32_t *x = f->hist[c];
+
+            for (int i = 0; i < n; i++)
+                x[keep+i] = to_fixed(in[(size_t)(at+i)*f->channels + c], f->bits);
+
+            for (int i = 0; i < n; i++)
+                out[(size_t)(at+i)*f->channels + c] = fixedfir_sample(f, x+i) / scale;
+
+            memmove(x, x+n, sizeof(int32_t)*keep);
+        }
+    }
+}
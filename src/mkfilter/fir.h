@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __FIR_H__
+#define __FIR_H__
+
+#include "audiobuf.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// filters up to this many taps are applied with the direct form kernel,
+// longer ones with FFT convolution
+#define FIR_DIRECT_MAX 256
+
+// frames processed per pass over the taps
+#define FIR_BLOCK 1024
+
+typedef struct fir {
+    float *taps;    // folded taps when symmetric, reversed order otherwise
+    int len;        // number of taps in the filter
+    bool symmetric; // linear phase, taps[k] applies to x[n-k] and x[n-len+1+k]
+    bool avx2;
+    int channels;
+    float **hist;   // per channel, len-1 samples of history plus one block
+} fir;
+
+// integer taps in Q15 (bits = 16) or Q31 (bits = 32), applied the way an
+// integer MAC with a 64 bit accumulator would, saturating the output
+typedef struct fixedfir {
+    int32_t *taps;  // reversed order
+    int len;
+    int bits;
+    int channels;
+    int32_t **hist; // per channel, len-1 samples of history plus one block
+} fixedfir;
+
+// length of the filter without trailing zero taps, except those mirroring
+// leading zeros in a symmetric filter
+int fir_length(audiobuf *filter);
+
+// whether h[i] == h[len-1-i], allowing for float rounding
+bool fir_is_symmetric(float *h, int len);
+
+fir *fir_alloc(audiobuf *filter, int channels);
+void fir_free(fir *f);
+
+// filter frames*channels interleaved samples from in into out, keeping
+// state between calls. in and out may be the same buffer.
+void fir_process(fir *f, const float *in, float *out, int frames);
+
+fixedfir *fixedfir_alloc(int32_t *coeffs, int len, int bits, int channels);
+void fixedfir_free(fixedfir *f);
+
+// as fir_process; samples are rounded to the fixed point format on the way
+// in and the output holds exact fixed point values
+void fixedfir_process(fixedfir *f, const float *in, float *out, int frames);
+
+#endif
@@ -0,0 +1,609 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "iir.h"
+#include "fft.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <err.h>
+
+#define PI 3.1415926535897932384626433832795028841971693993
+
+// resolution of the minimum phase target
+#define CEPSTRUM_SIZE 16384
+
+// log spaced frequencies the cascade is fit on
+#define FIT_POINTS 512
+
+// Steiglitz-McBride style reweighting passes
+#define FIT_ITERATIONS 30
+
+// magnitudes are floored this far below the peak before taking logs
+#define MAG_FLOOR 1e-6
+
+// frequencies a section's peak gain is looked for at, besides its poles'
+#define PEAK_POINTS 1024
+
+/*
+ * The phase of the minimum phase filter with the wanted magnitude, from the
+ * folded real cepstrum of the log magnitude. phase gets CEPSTRUM_SIZE/2+1
+ * points from 0 to sr/2.
+ */
+static void minimum_phase(int sr, wantcurve *curve, double *phase) {
+    int n = CEPSTRUM_SIZE;
+
+    fft_cpx *buf;
+    if ( (buf = malloc(sizeof(fft_cpx)*n)) == NULL )
+        err(1, "Couldn't malloc space for cepstrum");
+
+    float max = 0;
+    for (int i = 0; i < curve->ct; i++)
+        if ( max < fabsf(curve->pts[i].power) )
+            max = fabsf(curve->pts[i].power);
+
+    for (int i = 0; i < n; i++) {
+        float f = (float)(i <= n/2 ? i : n-i)/n*sr;
+        float mag = fabsf(wantcurve_power_at(curve, f));
+        buf[i].r = log(mag > max*MAG_FLOOR ? mag : max*MAG_FLOOR);
+        buf[i].i = 0;
+    }
+
+    fft(n, true, buf, buf);
+
+    // fold the anticausal part of the cepstrum onto the causal part
+    for (int i = 1; i < n/2; i++) {
+        buf[i].r *= 2.0/n;
+        buf[i].i *= 2.0/n;
+    }
+    buf[0].r /= n;
+    buf[0].i /= n;
+    buf[n/2].r /= n;
+    buf[n/2].i /= n;
+    for (int i = n/2+1; i < n; i++)
+        buf[i].r = buf[i].i = 0;
+
+    fft(n, false, buf, buf);
+
+    for (int i = 0; i <= n/2; i++)
+        phase[i] = buf[i].i;
+
+    free(buf);
+}
+
+/*
+ * Least squares solution of the m by n system a x = b (m >= n) by Householder
+ * QR. a is stored column major and is destroyed, as is b.
+ */
+static void lstsq(double *a, double *b, int m, int n, double *x) {
+    // equilibrate the columns, they differ wildly in scale
+    double *scale;
+    if ( (scale = malloc(sizeof(double)*n)) == NULL )
+        err(1, "Couldn't malloc space for least squares");
+    for (int j = 0; j < n; j++) {
+        double norm = 0;
+        for (int i = 0; i < m; i++)
+            norm += a[j*m+i]*a[j*m+i];
+        scale[j] = norm > 0 ? 1/sqrt(norm) : 1;
+        for (int i = 0; i < m; i++)
+            a[j*m+i] *= scale[j];
+    }
+
+    for (int k = 0; k < n; k++) {
+        double *col = a + k*m;
+        double norm = 0;
+        for (int i = k; i < m; i++)
+            norm += col[i]*col[i];
+        norm = sqrt(norm);
+        if ( norm == 0 )
+            continue;
+
+        double alpha = col[k] > 0 ? -norm : norm;
+        col[k] -= alpha;
+        double vnorm2 = 0;
+        for (int i = k; i < m; i++)
+            vnorm2 += col[i]*col[i];
+
+        // apply the reflection to the remaining columns and to b
+        for (int j = k+1; j <= n; j++) {
+            double *c = j < n ? a + j*m : b;
+            double dot = 0;
+            for (int i = k; i < m; i++)
+                dot += col[i]*c[i];
+            dot *= 2/vnorm2;
+            for (int i = k; i < m; i++)
+                c[i] -= dot*col[i];
+        }
+
+        col[k] = alpha; // diagonal of R
+    }
+
+    for (int k = n-1; k >= 0; k--) {
+        double sum = b[k];
+        for (int j = k+1; j < n; j++)
+            sum -= a[j*m+k]*x[j];
+        x[k] = a[k*m+k] != 0 ? sum / a[k*m+k] : 0;
+    }
+
+    for (int j = 0; j < n; j++)
+        x[j] *= scale[j];
+
+    free(scale);
+}
+
+// c[0] + c[1] z^-1 + ... + c[n] z^-n at z
+static double complex poly_eval(double *c, int n, double complex z) {
+    double complex zi = 1/z;
+    double complex sum = 0;
+    for (int i = n; i >= 0; i--)
+        sum = sum*zi + c[i];
+    return sum;
+}
+
+/*
+ * Roots of c[0] z^n + c[1] z^(n-1) + ... + c[n] by Aberth's method.
+ */
+static void poly_roots(double *c, int n, double complex *roots) {
+    if ( n == 0 )
+        return;
+
+    double radius = pow(fabs(c[n]/c[0]), 1.0/n);
+    if ( !(radius > 1e-3) || !isfinite(radius) )
+        radius = 1e-3;
+    for (int i = 0; i < n; i++)
+        roots[i] = radius * cexp(I*(2*PI*i/n + 0.4));
+
+    for (int iter = 0; iter < 1000; iter++) {
+        double maxstep = 0;
+        for (int i = 0; i < n; i++) {
+            double complex z = roots[i];
+            double complex p = 0;
+            double complex dp = 0;
+            for (int k = 0; k <= n; k++) {
+                dp = dp*z + p;
+                p = p*z + c[k];
+            }
+            if ( p == 0 )
+                continue;
+
+            double complex ratio = p/dp;
+            double complex sum = 0;
+            for (int j = 0; j < n; j++)
+                if ( j != i )
+                    sum += 1/(z - roots[j]);
+            double complex step = ratio / (1 - ratio*sum);
+            roots[i] -= step;
+
+            double rel = cabs(step) / (cabs(roots[i]) > 1e-300 ? cabs(roots[i]) : 1e-300);
+            if ( rel > maxstep )
+                maxstep = rel;
+        }
+        if ( maxstep < 1e-15 )
+            break;
+    }
+}
+
+// c[0..n] = c[0] * prod (1 - roots[i] z^-1)
+static void poly_from_roots(double complex *roots, int n, double lead, double *c) {
+    double complex *p;
+    if ( (p = malloc(sizeof(double complex)*(n+1))) == NULL )
+        err(1, "Couldn't malloc space for polynomial");
+    p[0] = 1;
+    for (int i = 1; i <= n; i++)
+        p[i] = 0;
+    for (int i = 0; i < n; i++)
+        for (int k = i+1; k >= 1; k--)
+            p[k] -= roots[i]*p[k-1];
+    for (int i = 0; i <= n; i++)
+        c[i] = lead*creal(p[i]);
+    free(p);
+}
+
+// moves roots outside the unit circle to their reciprocal conjugates, which
+// keeps the shape of the magnitude response
+static void reflect_roots(double complex *roots, int n, double maxradius) {
+    for (int i = 0; i < n; i++) {
+        if ( cabs(roots[i]) > 1 )
+            roots[i] = 1/conj(roots[i]);
+        if ( cabs(roots[i]) > maxradius )
+            roots[i] *= maxradius/cabs(roots[i]);
+    }
+}
+
+/*
+ * Groups roots into quadratic factors 1 + q[0] z^-1 + q[1] z^-2, pairing
+ * conjugates and then the real roots from the largest down. A lone real root
+ * gets q[1] = 0. Returns the number of factors, (n+1)/2.
+ *
+ * Each complex root is matched with the nearest root below the real axis,
+ * rather than each being classified on its own, so a near-real pair split
+ * across the threshold by rounding still pairs up. Roots left unmatched
+ * count as real.
+ */
+static int quadratic_factors(double complex *roots, int n, double (*q)[2]) {
+    double *real;
+    bool *used;
+    if ( (real = malloc(sizeof(double)*n)) == NULL || (used = calloc(n, sizeof(bool))) == NULL )
+        err(1, "Couldn't malloc space for real roots");
+
+    int ct = 0;
+    for (int i = 0; i < n; i++) {
+        double complex r = roots[i];
+        if ( used[i] || cimag(r) <= 1e-9*(cabs(r) > 1e-9 ? cabs(r) : 1e-9) )
+            continue;
+
+        int best = -1;
+        for (int j = 0; j < n; j++)
+            if ( !used[j] && j != i && cimag(roots[j]) < 0 &&
+                    (best < 0 || cabs(roots[j] - conj(r)) < cabs(roots[best] - conj(r))) )
+                best = j;
+        if ( best < 0 )
+            continue;
+
+        used[i] = used[best] = true;
+        q[ct][0] = -2*creal(r);
+        q[ct][1] = creal(r)*creal(r) + cimag(r)*cimag(r);
+        ct++;
+    }
+
+    int realct = 0;
+    for (int i = 0; i < n; i++)
+        if ( !used[i] )
+            real[realct++] = creal(roots[i]);
+
+    for (int i = 0; i < realct; i++)
+        for (int j = i+1; j < realct; j++)
+            if ( real[j] > real[i] ) {
+                double t = real[i];
+                real[i] = real[j];
+                real[j] = t;
+            }
+
+    for (int i = 0; i < realct; i += 2) {
+        if ( i+1 < realct ) {
+            q[ct][0] = -(real[i]+real[i+1]);
+            q[ct][1] = real[i]*real[i+1];
+        } else {
+            q[ct][0] = -real[i];
+            q[ct][1] = 0;
+        }
+        ct++;
+    }
+
+    free(real);
+    free(used);
+
+    return ct;
+}
+
+// the roots of z^2 + q[0] z + q[1]
+static void factor_roots(double *q, double complex *r) {
+    double complex s = csqrt(q[0]*q[0]/4 - q[1]);
+    r[0] = -q[0]/2 + s;
+    r[1] = -q[0]/2 - s;
+}
+
+// how far the roots of two factors are from each other, matched either way
+static double factor_distance(double *a, double *b) {
+    double complex ra[2], rb[2];
+    factor_roots(a, ra);
+    factor_roots(b, rb);
+    return fmin(cabs(ra[0]-rb[0]) + cabs(ra[1]-rb[1]), cabs(ra[0]-rb[1]) + cabs(ra[1]-rb[0]));
+}
+
+static double factor_radius(double *q) {
+    double complex r[2];
+    factor_roots(q, r);
+    return fmax(cabs(r[0]), cabs(r[1]));
+}
+
+/*
+ * Builds the sections from the pole and zero factors. The poles closest to
+ * the unit circle pick the nearest zeros first, since theirs are the peaks
+ * worth cancelling, and the sections run from the poles furthest from the
+ * circle to the closest, so the sharpest peaks come last.
+ */
+static void pair_sections(double (*pq)[2], double (*zq)[2], int n, biquad *sections) {
+    int *order;
+    double *radius;
+    bool *used;
+    if ( (order = malloc(sizeof(int)*n)) == NULL || (radius = malloc(sizeof(double)*n)) == NULL ||
+         (used = calloc(n, sizeof(bool))) == NULL )
+        err(1, "Couldn't malloc space for pairing sections");
+
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+        radius[i] = factor_radius(pq[i]);
+    }
+    for (int i = 0; i < n; i++)
+        for (int j = i+1; j < n; j++)
+            if ( radius[order[j]] < radius[order[i]] ) {
+                int t = order[i];
+                order[i] = order[j];
+                order[j] = t;
+            }
+
+    for (int i = n-1; i >= 0; i--) {
+        double *p = pq[order[i]];
+        int best = -1;
+        for (int j = 0; j < n; j++)
+            if ( !used[j] && (best < 0 || factor_distance(p, zq[j]) < factor_distance(p, zq[best])) )
+                best = j;
+        used[best] = true;
+
+        sections[i].b0 = 1;
+        sections[i].b1 = zq[best][0];
+        sections[i].b2 = zq[best][1];
+        sections[i].a1 = p[0];
+        sections[i].a2 = p[1];
+    }
+
+    free(order);
+    free(radius);
+    free(used);
+}
+
+static double complex section_response(biquad *s, double w) {
+    double complex z1 = cexp(-I*w);
+    double complex z2 = z1*z1;
+    return (s->b0 + s->b1*z1 + s->b2*z2) / (1 + s->a1*z1 + s->a2*z2);
+}
+
+// of the first ct sections
+static double complex cascade_response(iircascade *c, int ct, double w) {
+    double complex h = 1;
+    for (int i = 0; i < ct; i++)
+        h *= section_response(&c->sections[i], w);
+    return h;
+}
+
+// the largest gain of the first ct sections, on a grid and at their poles'
+// angles, where narrow peaks between grid points are
+static double cascade_peak(iircascade *c, int ct) {
+    double peak = 0;
+    for (int k = 0; k <= PEAK_POINTS; k++)
+        peak = fmax(peak, cabs(cascade_response(c, ct, PI*k/PEAK_POINTS)));
+
+    for (int i = 0; i < ct; i++) {
+        double q[2] = { c->sections[i].a1, c->sections[i].a2 };
+        double complex r[2];
+        factor_roots(q, r);
+        for (int k = 0; k < 2; k++)
+            peak = fmax(peak, cabs(cascade_response(c, ct, fabs(carg(r[k])))));
+    }
+    return peak;
+}
+
+iircascade *fit_iir_cascade(int sr, wantcurve *curve, int sections) {
+    int order = sections*2;
+    int m = FIT_POINTS;
+    int unknowns = 2*order+1; // b0..b[order], a1..a[order]
+
+    double *phase;
+    if ( (phase = malloc(sizeof(double)*(CEPSTRUM_SIZE/2+1))) == NULL )
+        err(1, "Couldn't malloc space for minimum phase target");
+    minimum_phase(sr, curve, phase);
+
+    // log spaced fit grid from the first curve point (or a few Hz) to just
+    // below nyquist, which gives the error a log frequency weighting
+    double flo = curve->pts[0].freq;
+    if ( flo < sr*1e-4 )
+        flo = sr*1e-4;
+    double fhi = sr*0.49;
+    if ( flo >= fhi )
+        flo = fhi/1000;
+
+    double *w = malloc(sizeof(double)*m);
+    double complex *d = malloc(sizeof(double complex)*m);
+    double *weight = malloc(sizeof(double)*m);
+    double *mat = malloc(sizeof(double)*2*m*unknowns);
+    double *rhs = malloc(sizeof(double)*2*m);
+    double *x = malloc(sizeof(double)*unknowns);
+    double *a = malloc(sizeof(double)*(order+1));
+    double *b = malloc(sizeof(double)*(order+1));
+    double complex *roots = malloc(sizeof(double complex)*order);
+    if ( !w || !d || !weight || !mat || !rhs || !x || !a || !b || !roots )
+        err(1, "Couldn't malloc space for iir fit");
+
+    float max = 0;
+    for (int i = 0; i < curve->ct; i++)
+        if ( max < fabsf(curve->pts[i].power) )
+            max = fabsf(curve->pts[i].power);
+
+    for (int k = 0; k < m; k++) {
+        double f = flo * pow(fhi/flo, (double)k/(m-1));
+        w[k] = 2*PI*f/sr;
+
+        double mag = fabs(wantcurve_power_at(curve, f));
+        if ( mag < max*MAG_FLOOR )
+            mag = max*MAG_FLOOR;
+
+        double pos = f/sr*CEPSTRUM_SIZE;
+        int i = (int)pos;
+        if ( i >= CEPSTRUM_SIZE/2 )
+            i = CEPSTRUM_SIZE/2-1;
+        double frac = pos-i;
+        double ph = phase[i]*(1-frac) + phase[i+1]*frac;
+
+        d[k] = mag*cexp(I*ph);
+        weight[k] = 1/mag; // relative error, roughly error in dB
+    }
+
+    a[0] = 1;
+    for (int i = 1; i <= order; i++)
+        a[i] = 0;
+
+    for (int iter = 0; iter < FIT_ITERATIONS; iter++) {
+        // minimize |B - D A| / |A_previous|, linear in the coefficients
+        for (int k = 0; k < m; k++) {
+            double sw = weight[k] / cabs(poly_eval(a, order, cexp(I*w[k])));
+            for (int n = 0; n <= order; n++) {
+                double complex e = cexp(-I*w[k]*n);
+                mat[n*2*m + 2*k]   =  sw*creal(e);
+                mat[n*2*m + 2*k+1] =  sw*cimag(e);
+                if ( n > 0 ) {
+                    double complex de = d[k]*e;
+                    mat[(order+n)*2*m + 2*k]   = -sw*creal(de);
+                    mat[(order+n)*2*m + 2*k+1] = -sw*cimag(de);
+                }
+            }
+            rhs[2*k]   = sw*creal(d[k]);
+            rhs[2*k+1] = sw*cimag(d[k]);
+        }
+
+        lstsq(mat, rhs, 2*m, unknowns, x);
+
+        for (int i = 0; i <= order; i++)
+            b[i] = x[i];
+        for (int i = 1; i <= order; i++)
+            a[i] = x[order+i];
+
+        // keep the denominator stable for the next weighting
+        poly_roots(a, order, roots);
+        reflect_roots(roots, order, 1-1e-9);
+        poly_from_roots(roots, order, 1, a);
+    }
+
+    iircascade *c;
+    if ( (c = malloc(sizeof(iircascade))) == NULL )
+        err(1, "Couldn't malloc space for iir cascade");
+    if ( (c->sections = malloc(sizeof(biquad)*sections)) == NULL )
+        err(1, "Couldn't malloc space for biquads");
+    c->ct = sections;
+    c->sr = sr;
+
+    double (*pq)[2] = malloc(sizeof(double[2])*sections);
+    double (*zq)[2] = malloc(sizeof(double[2])*sections);
+    if ( !pq || !zq )
+        err(1, "Couldn't malloc space for biquads");
+
+    poly_roots(a, order, roots);
+    reflect_roots(roots, order, 1-1e-9);
+    quadratic_factors(roots, order, pq);
+
+    // zeros go inside the circle too, for minimum phase. a vanishing leading
+    // coefficient means zeros at infinity, which reflect to the origin.
+    int zorder = order;
+    while ( zorder > 0 && fabs(b[0]) < 1e-300 ) {
+        memmove(b, b+1, sizeof(double)*zorder);
+        zorder--;
+    }
+    poly_roots(b, zorder, roots);
+    reflect_roots(roots, zorder, 1);
+    for (int i = zorder; i < order; i++)
+        roots[i] = 0;
+    quadratic_factors(roots, order, zq);
+
+    pair_sections(pq, zq, sections, c->sections);
+
+    // the reflections changed the gain, so set it to the least squares fit
+    // of the log magnitudes
+    double logerr = 0;
+    for (int k = 0; k < m; k++)
+        logerr += log(cabs(d[k])) - log(cabs(cascade_response(c, sections, w[k])));
+    double gain = exp(logerr/m);
+
+    // spread it so the signal after every section peaks where the output
+    // does: each section in turn is scaled to that, and the last takes
+    // whatever gain is left
+    double applied = 1;
+    c->sections[0].b0 *= gain;
+    c->sections[0].b1 *= gain;
+    c->sections[0].b2 *= gain;
+    double target = cascade_peak(c, sections);
+    for (int i = 0; i < sections; i++) {
+        double g = i < sections-1 ? target/cascade_peak(c, i+1) : 1/applied;
+        c->sections[i].b0 *= g;
+        c->sections[i].b1 *= g;
+        c->sections[i].b2 *= g;
+        applied *= g;
+    }
+
+    free(phase);
+    free(w);
+    free(d);
+    free(weight);
+    free(mat);
+    free(rhs);
+    free(x);
+    free(a);
+    free(b);
+    free(roots);
+    free(pq);
+    free(zq);
+
+    return c;
+}
+
+void free_iir_cascade(iircascade *c) {
+    free(c->sections);
+    free(c);
+}
+
+audiobuf *render_iir_cascade(iircascade *c, int len) {
+    audiobuf *buf;
+    if ( (buf = malloc(sizeof(audiobuf))) == NULL )
+        err(1, "Couldn't malloc space for audiobuf structure");
+    if ( (buf->td = malloc(sizeof(float)*len)) == NULL )
+        err(1, "Couldn't malloc %zu bytes for impulse response", sizeof(float)*len);
+    buf->fd = NULL;
+    buf->len = len;
+    buf->sr = c->sr;
+    buf->type = audiobuf_td;
+
+    double *s1 = calloc(c->ct, sizeof(double));
+    double *s2 = calloc(c->ct, sizeof(double));
+    if ( !s1 || !s2 )
+        err(1, "Couldn't malloc space for biquad state");
+
+    // transposed direct form II, fed an impulse
+    for (int n = 0; n < len; n++) {
+        double v = n == 0 ? 1 : 0;
+        for (int i = 0; i < c->ct; i++) {
+            biquad *s = &c->sections[i];
+            double y = s->b0*v + s1[i];
+            s1[i] = s->b1*v - s->a1*y + s2[i];
+            s2[i] = s->b2*v - s->a2*y;
+            v = y;
+        }
+        buf->td[n] = v;
+    }
+
+    free(s1);
+    free(s2);
+
+    return buf;
+}
+
+void write_sos(iircascade *c, char *path) {
+    FILE *fh;
+    if ( (fh = fopen(path, "w")) == NULL )
+        err(1, "Couldn't open %s for writing", path);
+
+    fprintf(fh, "# SAMPLERATE=%d\n", c->sr);
+    fprintf(fh, "# b0 b1 b2 a0 a1 a2\n\n");
+    for (int i = 0; i < c->ct; i++) {
+        biquad *s = &c->sections[i];
+        fprintf(fh, "%.17g\t%.17g\t%.17g\t1\t%.17g\t%.17g\n", s->b0, s->b1, s->b2, s->a1, s->a2);
+    }
+
+    if ( fclose(fh) )
+        err(1, "Couldn't close %s", path);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __IIR_H__
+#define __IIR_H__
+
+#include "audiobuf.h"
+#include "wantcurve.h"
+
+// one second order section, normalized so that a0 = 1
+typedef struct biquad {
+    double b0, b1, b2;
+    double a1, a2;
+} biquad;
+
+typedef struct iircascade {
+    biquad *sections;
+    int ct;
+    int sr;
+} iircascade;
+
+// fits a stable, minimum phase cascade of the given number of biquads to the
+// magnitude of the wantcurve. each pole pair shares a section with its
+// nearest zero pair, the sections run in order of pole radius, and the gain
+// is spread so the signal after each section peaks at the output's level.
+iircascade *fit_iir_cascade(int sr, wantcurve *curve, int sections);
+void free_iir_cascade(iircascade *c);
+
+// impulse response of the cascade, for analysis and for FIR output
+audiobuf *render_iir_cascade(iircascade *c, int len);
+
+// one "b0 b1 b2 a0 a1 a2" line per section
+void write_sos(iircascade *c, char *path);
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "jobs.h"
+
+#include <stdio.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+void set_jobs(int jobs) {
+#ifdef _OPENMP
+    if ( jobs == 0 )
+        jobs = omp_get_num_procs();
+    omp_set_num_threads(jobs);
+#else
+    if ( jobs != 1 )
+        fprintf(stderr, "mkfilter: WARNING: Built without OpenMP, ignoring job count of %d.\n", jobs);
+#endif
+}
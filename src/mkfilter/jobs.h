@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __JOBS_H__
+#define __JOBS_H__
+
+// Marks a loop whose iterations are independent so that it is split across
+// the --jobs threads. Only use it where every element is computed the same
+// way no matter which thread does it, never on sums or other reductions,
+// so that output is bit-identical for any job count.
+#ifdef _OPENMP
+#define PARALLEL_FOR _Pragma("omp parallel for")
+#else
+#define PARALLEL_FOR
+#endif
+
+// 0 means one thread per processor
+void set_jobs(int jobs);
+
+#endif
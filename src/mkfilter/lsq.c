@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "lsq.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <err.h>
+
+#define PI 3.1415926535897932384626433832795028841971693993
+
+// frequency grid points per cosine term
+#define LSQ_GRID 8
+
+/*
+ * Weights are floored at this fraction of the largest. A band weighted zero
+ * leaves the fit free to grow without bound there, extrapolating the
+ * weighted band's polynomial, and rounding in the taps then swamps the
+ * weighted band too; -40dB keeps it near the curve at no visible cost to
+ * the fit where it's weighted.
+ */
+#define LSQ_FLOOR 1e-4
+
+audiobuf *make_lsq(int sr, wantcurve *curve, wantcurve *weights, int len) {
+    if ( len % 2 == 0 ) len++; // odd size for a type I linear phase filter
+
+    int terms = len/2 + 1;
+    int grid = LSQ_GRID*terms;
+
+    // the curve, weights and x = cos(w) on the midpoints of grid bands
+    double *x, *want, *weight;
+    if ( (x = malloc(sizeof(double)*grid)) == NULL || (want = malloc(sizeof(double)*grid)) == NULL ||
+         (weight = malloc(sizeof(double)*grid)) == NULL )
+        err(1, "Couldn't allocate space for least squares grid");
+
+    double peak = 0;
+    for (int i = 0; i < grid; i++) {
+        double w = PI*(i+0.5)/grid;
+        float f = w/(2*PI) * sr;
+        x[i] = cos(w);
+        want[i] = wantcurve_power_at(curve, f);
+        weight[i] = weights ? wantcurve_power_at(weights, f) : 1;
+        if ( weight[i] < 0 )
+            errx(1, "Least squares weights can't be negative");
+        peak = fmax(peak, weight[i]);
+    }
+    if ( peak <= 0 )
+        errx(1, "Least squares weights are all zero");
+
+    double total = 0;
+    for (int i = 0; i < grid; i++) {
+        weight[i] = fmax(weight[i], peak*LSQ_FLOOR);
+        total += weight[i];
+    }
+
+    // the current and previous orthonormal polynomials and the fit so far,
+    // all on the grid
+    double *q, *qprev, *fit, *coefs;
+    if ( (q = malloc(sizeof(double)*grid)) == NULL || (qprev = malloc(sizeof(double)*grid)) == NULL ||
+         (fit = calloc(grid, sizeof(double))) == NULL || (coefs = calloc(terms, sizeof(double))) == NULL )
+        err(1, "Couldn't allocate space for least squares solve");
+
+    for (int i = 0; i < grid; i++) {
+        q[i] = 1/sqrt(total);
+        qprev[i] = 0;
+    }
+
+    double b = 0;
+    for (int k = 0; k < terms; k++) {
+        // the projection of the curve onto q
+        double proj = 0;
+        for (int i = 0; i < grid; i++)
+            proj += weight[i] * want[i] * q[i];
+        for (int i = 0; i < grid; i++)
+            fit[i] += proj * q[i];
+
+        if ( k == terms-1 )
+            break;
+
+        // the next one is (x - alpha) q - b qprev, normalized
+        double alpha = 0;
+        for (int i = 0; i < grid; i++)
+            alpha += weight[i] * x[i] * q[i]*q[i];
+
+        double norm = 0;
+        for (int i = 0; i < grid; i++) {
+            double v = (x[i] - alpha)*q[i] - b*qprev[i];
+            qprev[i] = q[i];
+            q[i] = v;
+            norm += weight[i] * v*v;
+        }
+        double next = sqrt(norm);
+
+        for (int i = 0; i < grid; i++)
+            q[i] /= next;
+        b = next;
+    }
+
+    // the fit is a cosine series with fewer terms than grid points, where
+    // the cosines are orthogonal, so each coefficient is one sum over the
+    // grid (cos(k w) by the Chebyshev recurrence in x)
+    for (int i = 0; i < grid; i++) {
+        double t = 1, tprev = x[i];
+        for (int k = 0; k < terms; k++) {
+            coefs[k] += fit[i] * t;
+            double tnext = 2*x[i]*t - tprev;
+            tprev = t;
+            t = tnext;
+        }
+    }
+    coefs[0] /= grid;
+    for (int k = 1; k < terms; k++)
+        coefs[k] *= 2.0/grid;
+
+    // sum c_k cos(k w) is the symmetric taps at k from the center, halved
+    // except for the center itself
+    audiobuf *buf;
+    if ( (buf = malloc(sizeof(audiobuf))) == NULL )
+        err(1, "Couldn't malloc space for audiobuf structure");
+    if ( (buf->td = malloc(sizeof(float)*len)) == NULL )
+        err(1, "Couldn't malloc space for audio");
+
+    int center = len/2;
+    buf->td[center] = coefs[0];
+    for (int k = 1; k < terms; k++)
+        buf->td[center+k] = buf->td[center-k] = coefs[k]/2;
+    buf->len = len;
+    buf->fd = NULL;
+    buf->sr = sr;
+    buf->type = audiobuf_td;
+
+    free(x);
+    free(want);
+    free(weight);
+    free(q);
+    free(qprev);
+    free(fit);
+    free(coefs);
+    return buf;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __LSQ_H__
+#define __LSQ_H__
+
+#include "audiobuf.h"
+#include "wantcurve.h"
+
+/*
+ * The odd length, linear phase filter whose magnitude has the least squared
+ * error against the wantcurve over frequency, each frequency weighted by the
+ * weight curve (read like a wantcurve, with weights for powers; NULL weights
+ * everything equally).
+ *
+ * The zero phase response is a cosine series sum c_k cos(k w), which is a
+ * polynomial in x = cos(w), so the normal equations (Toeplitz plus Hankel in
+ * the c_k) are solved the way Levinson solves Toeplitz ones: polynomials
+ * orthogonal under the weights are built on the frequency grid by a three
+ * term recurrence, the fit is the sum of the curve's projections onto them,
+ * and the c_k are its cosine transform. That is O(len) work per tap on the
+ * grid and stable where forming and eliminating the matrix isn't. Zero
+ * weights are raised to -40dB of the largest, so a don't-care band stays
+ * bounded instead of taking the weighted band's extrapolation.
+ */
+audiobuf *make_lsq(int sr, wantcurve *curve, wantcurve *weights, int len);
+
+#endif
@@ -19,6 +19,19 @@
 #include "file.h"
 #include "analyze.h"
 #include "wantcurve.h"
+#include "jobs.h"
+#include "apply.h"
+#include "quantize.h"
+#include "plot.h"
+#include "manifest.h"
+#include "partition.h"
+#include "deconvolve.h"
+#include "metrics.h"
+#include "explore.h"
+#include "warp.h"
+#include "trim.h"
+#include "fft.h"
+#include "wisdom.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,14 +39,37 @@
 #include <stdbool.h>
 #include <err.h>
 #include <string.h>
+#include <math.h>
 
 void usage(char *name) {
     fprintf(stderr, "Usage:\n");
-    fprintf(stderr, "    %s {-o outfile | --analyze} -t type [-f freq[,freq]]\n", name);
-    fprintf(stderr, "       [-c frequencycurve] [-C file] [-d depth] [-w window]\n");
+    fprintf(stderr, "    %s {-o outfile | --analyze[=mode]} -t type [-f freq[,freq]]\n", name);
+    fprintf(stderr, "       [-c frequencycurve] [-C file] [--smooth kernel:width[:ppo]]\n");
+    fprintf(stderr, "       [--weight-curve weightcurve] [--weight-curve-file file]\n");
+    fprintf(stderr, "       [--warp lambda] [--warp-export mode]\n");
+    fprintf(stderr, "       [-d depth] [-w window]\n");
     fprintf(stderr, "       [-r samplerate] [-l len] [-R convolutions]\n");
-    fprintf(stderr, "       [--analyze-factor factor]\n");
-    fprintf(stderr, "    %s --analyze [--analyze-factor factor] input.wav\n", name);
+    fprintf(stderr, "       [--analyze-factor factor | --analyze-range f1:f2 [--analyze-points n]]\n");
+    fprintf(stderr, "       [-O outputformat] [-j jobs] [--fft-backend backend] [--trim db]\n");
+    fprintf(stderr, "       [--wisdom file] [--make-wisdom file]\n");
+    fprintf(stderr, "       [--sections count] [--sos sosfile] [-q fixedpoint [--error-feedback]]\n");
+    fprintf(stderr, "       [--crossover-phase mode] [--export-partitions block [--partitioning scheme]]\n");
+    fprintf(stderr, "    %s --analyze[=mode] [--analyze-factor factor] [-j jobs] input.wav\n", name);
+    fprintf(stderr, "    %s --analyze[=mode] [--analyze-factor factor] [-j jobs]\n", name);
+    fprintf(stderr, "       {input.wav ... | --file-list listfile}\n");
+    fprintf(stderr, "    %s {-t type ... | input.wav ... | --file-list listfile | --bank manifest}\n", name);
+    fprintf(stderr, "       --metrics [--analyze-factor factor | --analyze-range f1:f2 [--analyze-points n]]\n");
+    fprintf(stderr, "    %s -t type ... --explore lengths [--explore-windows windows] [-j jobs]\n", name);
+    fprintf(stderr, "    %s {-t type ... | input.wav ... | --file-list listfile} --plot out.png|out.svg\n", name);
+    fprintf(stderr, "       [--plot-mode mode] [--plot-size WIDTHxHEIGHT]\n");
+    fprintf(stderr, "    %s {-t type ... | filter.wav | bank} --apply input.wav [--apply-method method]\n", name);
+    fprintf(stderr, "       -o outfile [-O outputformat] [--trim db]\n");
+    fprintf(stderr, "    %s filter.wav --trim db {-o outfile | --analyze | --metrics | --plot ...}\n", name);
+    fprintf(stderr, "    %s --bank manifest -o outfile [-O outputformat] [-j jobs]\n", name);
+    fprintf(stderr, "       [design options used as defaults] [-q fixedpoint [--error-feedback]]\n");
+    fprintf(stderr, "    %s --deconvolve recording.wav --sweep f1:f2:seconds -o outfile\n", name);
+    fprintf(stderr, "       [--regularize amount] [-l irlength] [-O outputformat] [-j jobs]\n");
+    fprintf(stderr, "    %s --fft-benchmark\n", name);
     fprintf(stderr, "    %s -h\n", name);
     fprintf(stderr, "\n");
     fprintf(stderr, "Filter types:\n");
@@ -41,22 +77,139 @@ void usage(char *name) {
     fprintf(stderr, "    bandpass, bandstop (one or two frequencies)\n");
     fprintf(stderr, "    bandstopdeep (one frequency, uses depth)\n");
     fprintf(stderr, "    custom (uses frequency curve)\n");
+    fprintf(stderr, "    iir-fit (uses frequency curve, fits a biquad cascade of --sections\n");
+    fprintf(stderr, "        sections, default 4; the impulse response is truncated to the\n");
+    fprintf(stderr, "        length, --sos writes the sections as text)\n");
+    fprintf(stderr, "    lsq (uses frequency curve, the least squared error fit weighted over\n");
+    fprintf(stderr, "        frequency by the weight curve, given like a frequency curve with\n");
+    fprintf(stderr, "        weights for powers, default even; ignores the window)\n");
+    fprintf(stderr, "    warped (uses frequency curve, a warped FIR of length taps, see below)\n");
+    fprintf(stderr, "    crossover (any number of increasing frequencies, one output channel\n");
+    fprintf(stderr, "        per band, lowest first)\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Smoothing (--smooth kernel:width[:ppo]):\n");
+    fprintf(stderr, "    Smooths the frequency curve of a custom or iir-fit design first, with\n");
+    fprintf(stderr, "    boxcar (width in octaves), gaussian (full width at half maximum in\n");
+    fprintf(stderr, "    octaves) or erb (width in equivalent rectangular bandwidths) kernels,\n");
+    fprintf(stderr, "    resampled to ppo points per octave (default 48, see smooth.h).\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Warped filters (-t warped):\n");
+    fprintf(stderr, "    Every delay of the FIR is a first order allpass with coefficient\n");
+    fprintf(stderr, "    --warp (-1 to 1, default the Bark scale fit at the sample rate, about\n");
+    fprintf(stderr, "    0.76 at 44100), so positive values resolve low frequencies with fewer\n");
+    fprintf(stderr, "    taps. --warp-export is unwarped (default; the realized impulse\n");
+    fprintf(stderr, "    response) or warped (the taps, for a warped FIR runtime). --analyze,\n");
+    fprintf(stderr, "    --metrics and --plot always show the realized response.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Crossover phases:\n");
+    fprintf(stderr, "    linear (default; FIR bands from shared lowpass prototypes that sum to\n");
+    fprintf(stderr, "        a delay), minimum (Linkwitz-Riley 4th order IIR bands with allpass\n");
+    fprintf(stderr, "        compensation that sum to a flat magnitude)\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "Windows:\n");
     fprintf(stderr, "    blackman (default), hamming, hanning, barlett, rectangular\n");
     fprintf(stderr, "\n");
+    fprintf(stderr, "Analysis modes (--analyze=mode):\n");
+    fprintf(stderr, "    response (default; frequency, magnitude, phase)\n");
+    fprintf(stderr, "    group-delay (frequency, magnitude, group delay in samples)\n");
+    fprintf(stderr, "    With several inputs the output has one pair of columns per file.\n");
+    fprintf(stderr, "    --analyze-range f1:f2 analyzes just that band in Hz, on --analyze-points\n");
+    fprintf(stderr, "    evenly spaced frequencies including both ends (default 1000), with the\n");
+    fprintf(stderr, "    chirp-Z transform; it also applies to --plot.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Metrics (--metrics):\n");
+    fprintf(stderr, "    One JSON line per filter with the passband ripple, stopband attenuation,\n");
+    fprintf(stderr, "    transition width, -3dB and -6dB edges, DC and nyquist gain, peak group\n");
+    fprintf(stderr, "    delay and energy centroid, with bands found from the response (see\n");
+    fprintf(stderr, "    metrics.h). It replaces the --analyze table.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Exploring (--explore):\n");
+    fprintf(stderr, "    Designs the filter at every combination of the lengths (a comma\n");
+    fprintf(stderr, "    separated list of lengths, from:to doubling and from:to:step ranges)\n");
+    fprintf(stderr, "    and windows (a comma separated list, default all), measured as with\n");
+    fprintf(stderr, "    --metrics, and prints a table and the Pareto front of taps against\n");
+    fprintf(stderr, "    ripple, attenuation and transition width, cheapest first.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Plot modes:\n");
+    fprintf(stderr, "    magnitude (default), phase, group-delay\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Apply methods:\n");
+    fprintf(stderr, "    auto (default), direct (time domain), fft\n");
+    fprintf(stderr, "    Crossovers, banks and filter files with several channels run every\n");
+    fprintf(stderr, "    filter off one fft of the input, giving each input channel through\n");
+    fprintf(stderr, "    the first filter, then each through the second, and so on.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Output formats:\n");
+    fprintf(stderr, "    wav24 (default), wav32f, wav64f, raw (mkfilter raw float32, see file.h),\n");
+    fprintf(stderr, "    npy, header (C array), bank (indexed filter bank, see file.h)\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Banks (--bank):\n");
+    fprintf(stderr, "    The manifest has one filter per line as name=value settings named\n");
+    fprintf(stderr, "    after the long options, e.g. \"type=bp frequencies=89,112 length=8001\"\n");
+    fprintf(stderr, "    (see manifest.h). The filters are designed in parallel and written\n");
+    fprintf(stderr, "    as one channel each, or to an indexed bank with -O bank.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Partitions (--export-partitions block):\n");
+    fprintf(stderr, "    Writes the output file as the transformed partitions of the filter for\n");
+    fprintf(stderr, "    a partitioned convolution runtime (see file.h). --partitioning is\n");
+    fprintf(stderr, "    uniform (default, every partition one block) or nonuniform (two each\n");
+    fprintf(stderr, "    of 1, 2, 4, ... blocks).\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Deconvolution (--deconvolve):\n");
+    fprintf(stderr, "    Turns a recording of the exponential sweep\n");
+    fprintf(stderr, "    sin(2 pi f1 T/R (e^(tR/T) - 1)), R = ln(f2/f1), into an impulse response\n");
+    fprintf(stderr, "    per channel, -l samples long (default one second), windowing out the\n");
+    fprintf(stderr, "    harmonic distortion. The inverse is the Farina inverse sweep, or with\n");
+    fprintf(stderr, "    --regularize the spectral inverse with that fraction of the peak power\n");
+    fprintf(stderr, "    added (e.g. 0.001). The recording is read a block at a time.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Trimming (--trim db):\n");
+    fprintf(stderr, "    Cuts the filter (loaded or designed) down to where its energy from\n");
+    fprintf(stderr, "    the start rises, and from the end (Schroeder integration) falls, db\n");
+    fprintf(stderr, "    below the total, e.g. 60. A millisecond is faded out past each cut,\n");
+    fprintf(stderr, "    and the kept taps and energy lost are reported. Channels and bands\n");
+    fprintf(stderr, "    keep their alignment.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Fixed point (-q):\n");
+    fprintf(stderr, "    q15, q31. The filter is written as integers (PCM WAV, integer raw, npy\n");
+    fprintf(stderr, "    and header), --analyze shows the quantized response and --apply uses an\n");
+    fprintf(stderr, "    integer kernel. --error-feedback shapes the rounding error away from\n");
+    fprintf(stderr, "    the stopband, with a zero pair at DC, at nyquist or across it.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "FFT backends (--fft-backend):\n");
+    fprintf(stderr, "    kiss (default), stockham (in-tree mixed radix), or fftw when built\n");
+    fprintf(stderr, "    with HAVE_FFTW3. Transform sizes don't depend on the backend, so the\n");
+    fprintf(stderr, "    results only differ by rounding. --fft-benchmark times and checks\n");
+    fprintf(stderr, "    each one built in.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "FFT wisdom (--wisdom, --make-wisdom):\n");
+    fprintf(stderr, "    --make-wisdom file saves the twiddle tables the run's transforms used\n");
+    fprintf(stderr, "    (and any from --wisdom) when it exits. Later runs given --wisdom file\n");
+    fprintf(stderr, "    map it instead of computing them, which saves a cos and sin per point\n");
+    fprintf(stderr, "    on big transforms. Tables failing their checksum are computed as usual.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Jobs:\n");
+    fprintf(stderr, "    Number of threads to use, 0 for one per processor (default 1).\n");
+    fprintf(stderr, "    Output is identical for any number of jobs.\n");
+    fprintf(stderr, "\n");
 }
 
 static struct option long_options[] = {
     { "output", 1, NULL, 'o' },
-    { "analyze", 0, NULL, 'a' },
-    { "analyse", 0, NULL, 'a' },
+    { "output-format", 1, NULL, 'O' },
+    { "analyze", 2, NULL, 'a' },
+    { "analyse", 2, NULL, 'a' },
     { "help", 0, NULL, 'h' },
     { "type", 1, NULL, 't' },
     { "frequency", 1, NULL, 'f' },
     { "frequencies", 1, NULL, 'f' },
     { "frequency-curve", 1, NULL, 'c' },
     { "frequency-curve-file", 1, NULL, 'C' },
+    { "weight-curve", 1, NULL, 'u' },
+    { "weight-curve-file", 1, NULL, 'v' },
+    { "smooth", 1, NULL, 'U' },
+    { "warp", 1, NULL, 'k' },
+    { "warp-export", 1, NULL, 'y' },
     { "depth", 1, NULL, 'd' },
     { "window", 1, NULL, 'w' },
     { "sample-rate", 1, NULL, 'r' },
@@ -66,61 +219,148 @@ static struct option long_options[] = {
     { "analysefactor", 1, NULL, 'A' },
     { "analyze-factor", 1, NULL, 'A' },
     { "analyse-factor", 1, NULL, 'A' },
+    { "analyze-range", 1, NULL, 'G' },
+    { "analyse-range", 1, NULL, 'G' },
+    { "analyze-points", 1, NULL, 'N' },
+    { "analyse-points", 1, NULL, 'N' },
+    { "metrics", 0, NULL, 'K' },
+    { "explore", 1, NULL, 'X' },
+    { "explore-windows", 1, NULL, 'Y' },
+    { "jobs", 1, NULL, 'j' },
+    { "apply", 1, NULL, 'i' },
+    { "apply-method", 1, NULL, 'M' },
+    { "sections", 1, NULL, 'S' },
+    { "sos", 1, NULL, 's' },
+    { "quantize", 1, NULL, 'q' },
+    { "error-feedback", 0, NULL, 'e' },
+    { "file-list", 1, NULL, 'F' },
+    { "plot", 1, NULL, 'P' },
+    { "plot-mode", 1, NULL, 'm' },
+    { "plot-size", 1, NULL, 'Z' },
+    { "bank", 1, NULL, 'b' },
+    { "crossover-phase", 1, NULL, 'x' },
+    { "export-partitions", 1, NULL, 'E' },
+    { "partitioning", 1, NULL, 'n' },
+    { "deconvolve", 1, NULL, 'D' },
+    { "sweep", 1, NULL, 'W' },
+    { "regularize", 1, NULL, 'g' },
+    { "trim", 1, NULL, 'T' },
+    { "fft-backend", 1, NULL, 'B' },
+    { "fft-benchmark", 0, NULL, 'H' },
+    { "wisdom", 1, NULL, 'I' },
+    { "make-wisdom", 1, NULL, 'J' },
     { NULL, 0, NULL, 0 }
 };
 
-enum filtertype {
-    nofiltertype,
-    lowpass,
-    highpass,
-    bandpass,
-    bandpass2,
-    bandstop,
-    bandstop2,
-    bandstopdeep,
-    custom
-};
+bool handle_format(char *name, enum file_format *format) {
+    if ( strcmp(name, "wav24") == 0 || strcmp(name, "wav") == 0 ) {
+        *format = format_wav24;
+    } else if ( strcmp(name, "wav32f") == 0 || strcmp(name, "float") == 0 ) {
+        *format = format_wav32f;
+    } else if ( strcmp(name, "wav64f") == 0 || strcmp(name, "double") == 0 ) {
+        *format = format_wav64f;
+    } else if ( strcmp(name, "raw") == 0 ) {
+        *format = format_raw;
+    } else if ( strcmp(name, "npy") == 0 || strcmp(name, "numpy") == 0 ) {
+        *format = format_npy;
+    } else if ( strcmp(name, "header") == 0 || strcmp(name, "c") == 0 ) {
+        *format = format_header;
+    } else if ( strcmp(name, "bank") == 0 ) {
+        *format = format_bank;
+    } else {
+        return false;
+    }
+    return true;
+}
 
-bool handle_type(char *name, enum filtertype *type) {
-    if ( strcmp(name, "lowpass") == 0 || strcmp(name, "lp") == 0 ) {
-        *type = lowpass;
-    } else if ( strcmp(name, "highpass") == 0 || strcmp(name, "hp") == 0 ) {
-        *type = highpass;
-    } else if ( strcmp(name, "bandpass") == 0 || strcmp(name, "bp") == 0 ) {
-        *type = bandpass;
-    } else if ( strcmp(name, "bandpass2") == 0 || strcmp(name, "bp2") == 0 ) {
-        *type = bandpass2;
-    } else if ( strcmp(name, "bandstop") == 0 || strcmp(name, "bs") == 0 || strcmp(name, "notch") == 0 ) {
-        *type = bandstop;
-    } else if ( strcmp(name, "bandstop2") == 0 || strcmp(name, "bs2") == 0 || strcmp(name, "notch2") == 0 ) {
-        *type = bandstop2;
-    } else if ( strcmp(name, "bandstopdeep") == 0 || strcmp(name, "deepnotch") == 0 || strcmp(name, "dn") == 0 ) {
-        *type = bandstopdeep;
-    } else if ( strcmp(name, "custom") == 0 || strcmp(name, "fit") == 0 ) {
-        *type = custom;
+bool handle_quantize(char *name, enum quantize_mode *mode) {
+    if ( strcmp(name, "q15") == 0 || strcmp(name, "16") == 0 ) {
+        *mode = quantize_q15;
+    } else if ( strcmp(name, "q31") == 0 || strcmp(name, "32") == 0 ) {
+        *mode = quantize_q31;
     } else {
         return false;
     }
-    return true; // didn't hit the last else clause, something worked
+    return true;
 }
 
-bool handle_window(char *name, enum window *window) {
-    if ( strcmp(name, "blackman") == 0 ) {
-        *window = window_blackman;
-    } else if ( strcmp(name, "hamming") == 0 ) {
-        *window = window_hamming;
-    } else if ( strcmp(name, "barlett") == 0 ) {
-        *window = window_barlett;
-    } else if ( strcmp(name, "cosine") == 0 || strcmp(name, "hanning") == 0 ) {
-        *window = window_hanning;
-    } else if ( strcmp(name, "rectangular") == 0 || strcmp(name, "none") == 0 ) {
-        *window = window_rectangular;
+bool handle_analyze_mode(char *name, enum analyze_mode *mode) {
+    if ( strcmp(name, "response") == 0 || strcmp(name, "phase") == 0 ) {
+        *mode = analyze_response;
+    } else if ( strcmp(name, "group-delay") == 0 || strcmp(name, "groupdelay") == 0 || strcmp(name, "gd") == 0 ) {
+        *mode = analyze_group_delay;
     } else {
         return false;
     }
     return true;
 }
 
+bool handle_plot_mode(char *name, enum plot_mode *mode) {
+    if ( strcmp(name, "magnitude") == 0 || strcmp(name, "mag") == 0 ) {
+        *mode = plot_magnitude;
+    } else if ( strcmp(name, "phase") == 0 ) {
+        *mode = plot_phase;
+    } else if ( strcmp(name, "group-delay") == 0 || strcmp(name, "groupdelay") == 0 || strcmp(name, "gd") == 0 ) {
+        *mode = plot_group_delay;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool handle_partition_scheme(char *name, enum partition_scheme *scheme) {
+    if ( strcmp(name, "uniform") == 0 ) {
+        *scheme = partition_uniform;
+    } else if ( strcmp(name, "nonuniform") == 0 || strcmp(name, "non-uniform") == 0 ) {
+        *scheme = partition_nonuniform;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool handle_apply_method(char *name, enum apply_method *method) {
+    if ( strcmp(name, "auto") == 0 ) {
+        *method = apply_auto;
+    } else if ( strcmp(name, "direct") == 0 ) {
+        *method = apply_direct;
+    } else if ( strcmp(name, "fft") == 0 ) {
+        *method = apply_fft;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// --apply with a crossover, a bank or a multi-channel filter file
+static void apply_several(audiobuf **filters, int ct, char *applyfile, char *outfile, enum file_format format,
+                          enum apply_method method, enum quantize_mode quantize) {
+    if ( !outfile )
+        errx(1, "Need an output file for --apply");
+    if ( quantize != quantize_none )
+        errx(1, "Fixed point --apply takes a single filter");
+    if ( method == apply_direct )
+        errx(1, "Several filters are always applied with the fft");
+    apply_bank(filters, ct, applyfile, outfile, format);
+}
+
+// --trim, reporting on stderr
+static void trim(audiobuf **bufs, int ct, double db, char *name) {
+    trim_report *report;
+    if ( (report = malloc(sizeof(trim_report)*ct)) == NULL )
+        err(1, "Couldn't allocate space for trim report");
+    trim_filters(bufs, ct, db, report);
+    print_trim_report(report, ct, name, stderr);
+    free(report);
+}
+
+// what the design's filter does, where that isn't the filter itself
+static audiobuf *realized(design *d, audiobuf *buf) {
+    if ( d->type == warped && d->warp_export == warp_coefficients )
+        return unwarp_fir(buf, design_warp(d), 0);
+    return buf;
+}
+
 int main(int argc, char **argv) {
     char *progname = argv[0];
 
@@ -129,28 +369,58 @@ int main(int argc, char **argv) {
 
     // argument variables
     char *outfile = NULL;
+    enum file_format outformat = format_wav24;
 
     bool analyze = false;
+    enum analyze_mode analyzemode = analyze_response;
     int analyzefactor = 1;
+    analyze_range range = { 0, 0, 1000 };
+    bool range_set = false;
+    bool measure = false;
+
+    int *explorelens = NULL;
+    int explorelenct = 0;
+    enum window allwindows[] = { window_blackman, window_hamming, window_barlett, window_hanning, window_rectangular };
+    enum window *explorewindows = allwindows;
+    int explorewinct = sizeof(allwindows)/sizeof(allwindows[0]);
+
+    design d;
+    default_design(&d);
+    bool samplerate_set = false;
 
-    enum filtertype type = nofiltertype;
-    enum window window = window_blackman;
+    int jobs = 1;
 
-    float freq1 = 0;
-    float freq2 = 0;
-    int freqs_set = 0;
+    char *applyfile = NULL;
+    enum apply_method applymethod = apply_auto;
 
-    double depth = 0.01;
+    enum quantize_mode quantize = quantize_none;
+    bool feedback = false;
 
-    int samplerate = 44100;
-    bool samplerate_set = false;
-    int length = 1000;
-    int convolutions = 0;
+    char *filelist = NULL;
+
+    char *plotfile = NULL;
+    enum plot_mode plotmode = plot_magnitude;
+    int plotwidth = PLOT_WIDTH;
+    int plotheight = PLOT_HEIGHT;
+
+    char *manifest = NULL;
 
-    wantcurve *curve = NULL;
+    int partblock = 0;
+    enum partition_scheme partscheme = partition_uniform;
+
+    char *recording = NULL;
+    sweep sw;
+    bool sweep_set = false;
+    double regularize = 0;
+    bool length_set = false;
+    double trimdb = 0;
+    enum fft_backend fftbackend = fft_kiss;
+    bool fftbenchmark = false;
+    char *wisdomfile = NULL;
+    char *makewisdom = NULL;
 
     while ( true ) {
-        int c = getopt_long(argc, argv, "o:at:f:c:C:d:w:r:l:R:A:h", long_options, NULL);
+        int c = getopt_long(argc, argv, "o:O:at:f:c:C:u:v:U:k:y:d:w:r:l:R:A:G:N:KX:Y:j:i:M:S:s:q:eF:P:m:Z:b:x:E:n:D:W:g:T:B:HI:J:h", long_options, NULL);
         if ( c == -1 )
             break;
 
@@ -159,8 +429,15 @@ int main(int argc, char **argv) {
                 outfile = strdup(optarg);
                 break;
 
+            case 'O':
+                if ( !handle_format(optarg, &outformat) )
+                    errx(1, "Unknown output format %s", optarg);
+                break;
+
             case 'a':
                 analyze = true;
+                if ( optarg && !handle_analyze_mode(optarg, &analyzemode) )
+                    errx(1, "Unknown analysis mode %s", optarg);
                 break;
 
             case 'A':
@@ -169,162 +446,545 @@ int main(int argc, char **argv) {
                     errx(1, "Bad analyze factor specifier");
                 break;
 
+            case 'G':
+                range.from = strtod(optarg, &optarg);
+                if ( *optarg++ != ':' )
+                    errx(1, "Bad analyze range specifier");
+                range.to = strtod(optarg, &optarg);
+                if ( *optarg || range.from < 0 || range.to <= range.from )
+                    errx(1, "Bad analyze range specifier");
+                range_set = true;
+                break;
+
+            case 'N':
+                range.points = strtol(optarg, &optarg, 10);
+                if ( *optarg || range.points < 2 )
+                    errx(1, "Bad analyze points specifier");
+                break;
+
+            case 'K':
+                measure = true;
+                break;
+
+            case 'X':
+                if ( !handle_explore_lengths(optarg, &explorelens, &explorelenct) )
+                    errx(1, "Bad explore lengths specifier");
+                break;
+
+            case 'Y':
+                if ( !handle_explore_windows(optarg, &explorewindows, &explorewinct) )
+                    errx(1, "Bad explore windows specifier");
+                break;
+
 
             case 't':
-                if ( !handle_type(optarg, &type) )
+                if ( !handle_type(optarg, &d.type) )
                     errx(1, "Unknown filter type %s", optarg);
                 break;
 
             case 'f':
-                freq1 = strtof(optarg, &optarg);
-                freqs_set = 1;
-                if ( *optarg == ',' ) {
-                    optarg++;
-                    freq2 = strtof(optarg, &optarg);
-                    freqs_set = 2;
-                }
-                if ( *optarg )
+                if ( !handle_frequencies(optarg, &d) )
                     errx(1, "Bad frequency specifier");
                 break;
 
             case 'c':
-                curve = read_wantcurve_from_string(optarg);
-                if ( !samplerate_set && curve->has_sr )
-                    samplerate = curve->sr;
+                d.curve = read_wantcurve_from_string(optarg);
+                if ( !samplerate_set && d.curve->has_sr )
+                    d.sr = d.curve->sr;
                 break;
 
             case 'C':
-                curve = read_wantcurve_from_path(optarg);
-                if ( !samplerate_set && curve->has_sr )
-                    samplerate = curve->sr;
+                d.curve = read_wantcurve_from_path(optarg);
+                if ( !samplerate_set && d.curve->has_sr )
+                    d.sr = d.curve->sr;
                 break;
 
             case 'd':
-                depth = strtod(optarg, &optarg);
+                d.depth = strtod(optarg, &optarg);
                 if ( *optarg )
                     errx(1, "Bad depth specifier");
                 break;
 
             case 'w':
-                if ( !handle_window(optarg, &window) )
+                if ( !handle_window(optarg, &d.window) )
                     errx(1, "Unknown window type %s", optarg);
                 break;
 
             case 'r':
-                samplerate = strtol(optarg, &optarg, 10);
+                d.sr = strtol(optarg, &optarg, 10);
                 samplerate_set = true;
                 if ( *optarg )
                     errx(1, "Bad sample rate specifier");
                 break;
 
             case 'l':
-                length = strtol(optarg, &optarg, 10);
+                d.len = strtol(optarg, &optarg, 10);
+                length_set = true;
                 if ( *optarg )
                     errx(1, "Bad length specifier");
                 break;
 
             case 'R':
-                convolutions = strtol(optarg, &optarg, 10);
+                d.convolutions = strtol(optarg, &optarg, 10);
                 if ( *optarg )
                     errx(1, "Bad convolution count specifier");
                 break;
 
-            case 'h':
-                usage(progname);
-                exit(1);
+            case 'j':
+                jobs = strtol(optarg, &optarg, 10);
+                if ( *optarg || jobs < 0 )
+                    errx(1, "Bad job count specifier");
                 break;
 
-            default:
-                errx(1, "Not reached");
-        }
-    }
+            case 'i':
+                applyfile = strdup(optarg);
+                break;
 
-    bool extmode = false;
-    char *extfile = NULL;
+            case 'M':
+                if ( !handle_apply_method(optarg, &applymethod) )
+                    errx(1, "Unknown apply method %s", optarg);
+                break;
 
-    if ( optind != argc ) {
-        // we have extra arguments
+            case 'S':
+                d.sections = strtol(optarg, &optarg, 10);
+                if ( *optarg || d.sections < 1 )
+                    errx(1, "Bad section count specifier");
+                break;
 
-        extmode = true;
-        extfile = argv[optind++];
+            case 's':
+                d.sosfile = strdup(optarg);
+                break;
 
-        if ( optind != argc )
-            errx(1, "Too many arguments");
-    }
+            case 'q':
+                if ( !handle_quantize(optarg, &quantize) )
+                    errx(1, "Unknown fixed point format %s", optarg);
+                break;
 
-    audiobuf *buf;
+            case 'e':
+                feedback = true;
+                break;
 
-    // set the audiobuf to the proper thing
-    if ( extmode ) {
-        buf = read_file(extfile);
-    } else {
-        if ( !analyze && !outfile )
-            errx(1, "Must give either an output file or use --analyze");
-        if ( type == nofiltertype )
-            errx(1, "Must give a filter type");
-        if ( type == custom && !curve )
-            errx(1, "Need a wantcurve for the custom fit filter");
-        if ( type != custom && !freqs_set )
-            errx(1, "Need a frequency");
+            case 'F':
+                filelist = strdup(optarg);
+                break;
+
+            case 'P':
+                plotfile = strdup(optarg);
+                break;
+
+            case 'm':
+                if ( !handle_plot_mode(optarg, &plotmode) )
+                    errx(1, "Unknown plot mode %s", optarg);
+                break;
+
+            case 'Z':
+                plotwidth = strtol(optarg, &optarg, 10);
+                if ( *optarg != 'x' )
+                    errx(1, "Bad plot size specifier");
+                plotheight = strtol(optarg+1, &optarg, 10);
+                if ( *optarg )
+                    errx(1, "Bad plot size specifier");
+                break;
 
-        if ( freqs_set == 1 )
-            freq2 = freq1;
+            case 'b':
+                manifest = strdup(optarg);
+                break;
+
+            case 'x':
+                if ( !handle_crossover_mode(optarg, &d.crossover) )
+                    errx(1, "Unknown crossover phase %s", optarg);
+                break;
+
+            case 'u':
+                d.weights = read_wantcurve_from_string(optarg);
+                break;
+
+            case 'v':
+                d.weights = read_wantcurve_from_path(optarg);
+                break;
+
+            case 'k':
+                d.warp = strtod(optarg, &optarg);
+                if ( *optarg || !(fabs(d.warp) < 1) )
+                    errx(1, "Bad warping factor");
+                break;
+
+            case 'y':
+                if ( !handle_warp_export(optarg, &d.warp_export) )
+                    errx(1, "Unknown warp export %s", optarg);
+                break;
 
-        switch ( type ) {
-            case lowpass:
-                buf = make_lowpass(samplerate, freq1, length, window);
+            case 'U':
+                if ( !handle_smoothing(optarg, &d.smooth) )
+                    errx(1, "Bad smoothing specifier %s", optarg);
                 break;
 
-            case highpass:
-                buf = make_highpass(samplerate, freq1, length, window);
+            case 'E':
+                partblock = strtol(optarg, &optarg, 10);
+                if ( *optarg || partblock < 1 )
+                    errx(1, "Bad partition block size");
                 break;
 
-            case bandpass:
-                buf = make_bandpass(samplerate, freq1, freq2, length, window);
+            case 'n':
+                if ( !handle_partition_scheme(optarg, &partscheme) )
+                    errx(1, "Unknown partitioning %s", optarg);
                 break;
 
-            case bandpass2:
-                buf = make_bandpass2(samplerate, freq1, freq2, length, window);
+            case 'D':
+                recording = strdup(optarg);
                 break;
 
-            case bandstop:
-                buf = make_bandstop(samplerate, freq1, freq2, length, window);
+            case 'W':
+                sw.f1 = strtod(optarg, &optarg);
+                if ( *optarg++ != ':' )
+                    errx(1, "Bad sweep specifier");
+                sw.f2 = strtod(optarg, &optarg);
+                if ( *optarg++ != ':' )
+                    errx(1, "Bad sweep specifier");
+                sw.seconds = strtod(optarg, &optarg);
+                if ( *optarg || sw.f1 <= 0 || sw.f2 <= sw.f1 || sw.seconds <= 0 )
+                    errx(1, "Bad sweep specifier");
+                sweep_set = true;
                 break;
 
-            case bandstop2:
-                buf = make_bandstop2(samplerate, freq1, freq2, length, window);
+            case 'g':
+                regularize = strtod(optarg, &optarg);
+                if ( *optarg || regularize < 0 )
+                    errx(1, "Bad regularization amount");
                 break;
 
-            case bandstopdeep:
-                buf = make_bandstopdeep(samplerate, freq1, depth, length, window);
+            case 'T':
+                trimdb = strtod(optarg, &optarg);
+                if ( *optarg || trimdb <= 0 )
+                    errx(1, "Bad trim threshold");
                 break;
 
-            case custom:
-                buf = make_custom(samplerate, curve, length, window);
+            case 'B':
+                if ( !handle_fft_backend(optarg, &fftbackend) )
+                    errx(1, "Unknown fft backend %s", optarg);
+                break;
+
+            case 'H':
+                fftbenchmark = true;
+                break;
+
+            case 'I':
+                wisdomfile = strdup(optarg);
+                break;
+
+            case 'J':
+                makewisdom = strdup(optarg);
+                break;
+
+            case 'h':
+                usage(progname);
+                exit(1);
                 break;
 
             default:
                 errx(1, "Not reached");
         }
+    }
+
+    // before any plans are made
+    if ( wisdomfile )
+        load_wisdom(wisdomfile);
+    if ( makewisdom )
+        record_wisdom(makewisdom);
+
+    if ( !set_fft_backend(fftbackend) )
+        errx(1, "This mkfilter was built without that fft backend");
+    set_jobs(jobs);
+
+    if ( fftbenchmark ) {
+        fft_benchmark(stdout);
+        exit(0);
+    }
+
+    // the group delay plot needs the group delay analysis
+    if ( plotfile && plotmode == plot_group_delay ) {
+        if ( analyze && analyzemode != analyze_group_delay )
+            errx(1, "Plotting group delay needs --analyze=group-delay");
+        analyzemode = analyze_group_delay;
+    } else if ( plotfile && plotmode == plot_phase && analyzemode != analyze_response ) {
+        errx(1, "Plotting phase conflicts with --analyze=group-delay");
+    }
+
+    if ( feedback && quantize == quantize_none )
+        errx(1, "--error-feedback needs a fixed point format");
+
+    if ( measure && analyze )
+        errx(1, "--metrics can't be used with --analyze");
+
+    if ( trimdb > 0 && (recording || explorelens || manifest || filelist || argc-optind > 1) )
+        errx(1, "--trim takes a single filter file or design");
+
+    if ( recording ) {
+        if ( !sweep_set )
+            errx(1, "--deconvolve needs the --sweep parameters");
+        if ( !outfile )
+            errx(1, "Need an output file for --deconvolve");
+        if ( length_set && d.len <= 0 )
+            errx(1, "Bad length specifier");
+        deconvolve_file(&sw, regularize, recording, length_set ? d.len : 0, outfile, outformat);
+        exit(0);
+    }
+
+    if ( explorelens ) {
+        if ( analyze || measure || plotfile || outfile || applyfile || manifest || filelist || optind != argc || partblock )
+            errx(1, "--explore only prints its table");
+        if ( d.type == crossover || d.type == iirfit )
+            errx(1, "--explore needs a filter type that uses the length and window");
+        d.len = explorelens[0];
+        d.warp_export = warp_unwarped; // measure what's realized
+        char *problem = design_error(&d);
+        if ( problem )
+            errx(1, "%s", problem);
+
+        explore_designs(&d, explorelens, explorelenct, explorewindows, explorewinct,
+                        analyzefactor, range_set ? &range : NULL, stdout);
+        exit(0);
+    }
+
+    if ( manifest ) {
+        // every filter of a bank, designed in parallel
+        if ( !outfile && !measure )
+            errx(1, "Need an output file or --metrics for --bank");
+        if ( analyze || plotfile || applyfile || filelist || optind != argc || partblock )
+            errx(1, "--bank can't be used with inputs, --analyze, --plot, --apply or --export-partitions");
+
+        int designct;
+        design *designs = read_manifest(manifest, &d, &designct);
+
+        // a crossover line adds all of its bands
+        audiobuf ***made;
+        int *madect;
+        if ( (made = malloc(sizeof(audiobuf**)*designct)) == NULL || (madect = malloc(sizeof(int)*designct)) == NULL )
+            err(1, "Couldn't allocate space for filters");
+
+        PARALLEL_FOR
+        for (int i = 0; i < designct; i++)
+            made[i] = make_design_bands(&designs[i], &madect[i]);
+
+        int ct = 0;
+        for (int i = 0; i < designct; i++)
+            ct += madect[i];
+
+        audiobuf **bufs, **shown;
+        if ( (bufs = malloc(sizeof(audiobuf*)*ct)) == NULL || (shown = malloc(sizeof(audiobuf*)*ct)) == NULL )
+            err(1, "Couldn't allocate space for filters");
+        int32_t **fixed = NULL;
+        if ( quantize != quantize_none && (fixed = malloc(sizeof(int32_t*)*ct)) == NULL )
+            err(1, "Couldn't allocate space for fixed point filters");
+
+        for (int i = 0, at = 0; i < designct; i++)
+            for (int j = 0; j < madect[i]; j++)
+                bufs[at++] = made[i][j];
+
+        PARALLEL_FOR
+        for (int i = 0; i < ct; i++) {
+            normalize_peak_if_clipped(bufs[i]);
+            if ( fixed )
+                fixed[i] = quantize_buf(bufs[i], quantize, feedback);
+        }
+
+        if ( measure )
+            for (int i = 0, at = 0; i < designct; i++)
+                for (int j = 0; j < madect[i]; j++, at++)
+                    shown[at] = realized(&designs[i], bufs[at]);
+
+        if ( outfile )
+            write_filters(bufs, fixed, fixed ? quantize_bits(quantize) : 0, ct, outfile, outformat);
+
+        if ( measure ) {
+            // numbered like the bank's entries
+            char **names;
+            if ( (names = malloc(sizeof(char*)*ct)) == NULL )
+                err(1, "Couldn't allocate space for filter names");
+            for (int i = 0; i < ct; i++) {
+                if ( (names[i] = malloc(16)) == NULL )
+                    err(1, "Couldn't allocate space for filter names");
+                snprintf(names[i], 16, "%d", i);
+            }
+            print_metrics(measure_filters(shown, ct, analyzefactor, range_set ? &range : NULL), names, ct, stdout);
+        }
+        exit(0);
+    }
+
+    if ( filelist || argc-optind > 1 ) {
+        // batch analysis of several files
+        if ( (!analyze && !plotfile && !measure) || outfile || applyfile || d.type != nofiltertype )
+            errx(1, "Several input files can only be used with --analyze, --metrics or --plot");
+
+        int listct = 0;
+        char **list = filelist ? read_file_list(filelist, &listct) : NULL;
+
+        int ct = argc-optind + listct;
+        char **paths;
+        if ( (paths = malloc(sizeof(char*)*(ct > 0 ? ct : 1))) == NULL )
+            err(1, "Couldn't allocate space for input file names");
+        for (int i = 0; i < argc-optind; i++)
+            paths[i] = argv[optind+i];
+        for (int i = 0; i < listct; i++)
+            paths[argc-optind+i] = list[i];
+
+        if ( ct == 0 )
+            errx(1, "File list %s is empty", filelist);
+
+        if ( measure )
+            print_metrics(measure_paths(paths, ct, analyzefactor, range_set ? &range : NULL), paths, ct, stdout);
+        if ( analyze || plotfile ) {
+            analysis *an = analyze_paths(paths, ct, analyzefactor, analyzemode, range_set ? &range : NULL);
+            if ( analyze )
+                print_analysis(an, paths, stdout);
+            if ( plotfile )
+                plot_analysis(an, paths, plotfile, plotmode, plotwidth, plotheight);
+        }
+        exit(0);
+    }
+
+    if ( d.type == crossover ) {
+        // several bands, written as one file
+        if ( !analyze && !outfile && !plotfile && !measure )
+            errx(1, "Must give either an output file or use --analyze, --metrics or --plot");
+        if ( optind != argc || partblock )
+            errx(1, "A crossover can't be used with an input file or --export-partitions");
+        char *problem = design_error(&d);
+        if ( problem )
+            errx(1, "%s", problem);
+
+        int ct;
+        audiobuf **bands = make_design_bands(&d, &ct);
+
+        if ( trimdb > 0 )
+            trim(bands, ct, trimdb, "the crossover");
+
+        int32_t **fixed = NULL;
+        if ( quantize != quantize_none ) {
+            if ( (fixed = malloc(sizeof(int32_t*)*ct)) == NULL )
+                err(1, "Couldn't allocate space for fixed point filters");
+            for (int i = 0; i < ct; i++)
+                fixed[i] = quantize_buf(bands[i], quantize, feedback);
+        }
+
+        if ( outfile && !applyfile )
+            write_filters(bands, fixed, fixed ? quantize_bits(quantize) : 0, ct, outfile, outformat);
+
+        if ( analyze || plotfile || measure ) {
+            char **names;
+            if ( (names = malloc(sizeof(char*)*ct)) == NULL )
+                err(1, "Couldn't allocate space for band names");
+            for (int i = 0; i < ct; i++) {
+                if ( (names[i] = malloc(16)) == NULL )
+                    err(1, "Couldn't allocate space for band names");
+                snprintf(names[i], 16, "band%d", i+1);
+            }
 
-        if ( convolutions ) {
-            audiobuf *orig = duplicate_buf(buf);
-            for (int i = 0; i < convolutions; i++) {
-                audiobuf *new = convolve(orig, buf);
-                free_buf(buf);
-                buf = new;
+            if ( measure ) {
+                metrics *m = measure_filters(bands, ct, analyzefactor, range_set ? &range : NULL);
+                print_metrics(m, names, ct, stdout);
+                free_metrics(m, ct);
+            }
+            if ( analyze || plotfile ) {
+                analysis *an = analyze_bufs(bands, ct, analyzefactor, analyzemode, range_set ? &range : NULL);
+                if ( analyze )
+                    print_analysis(an, names, stdout);
+                if ( plotfile )
+                    plot_analysis(an, names, plotfile, plotmode, plotwidth, plotheight);
+                free_analysis(an);
             }
-            free_buf(orig);
         }
+
+        if ( applyfile )
+            apply_several(bands, ct, applyfile, outfile, outformat, applymethod, quantize);
+        exit(0);
     }
 
+    bool extmode = false;
+    char *extfile = NULL;
+
+    if ( optind != argc ) {
+        // we have an extra argument
+        extmode = true;
+        extfile = argv[optind++];
+    }
+
+    audiobuf *buf;
+
+    // set the audiobuf to the proper thing
+    if ( extmode && applyfile ) {
+        int ct;
+        audiobuf **filters = read_filters(extfile, &ct);
+        if ( trimdb > 0 )
+            trim(filters, ct, trimdb, extfile);
+        if ( ct > 1 ) {
+            if ( analyze || plotfile || measure )
+                errx(1, "--analyze, --metrics and --plot take a single filter");
+            apply_several(filters, ct, applyfile, outfile, outformat, applymethod, quantize);
+            exit(0);
+        }
+        buf = filters[0];
+    } else if ( extmode ) {
+        buf = read_file(extfile);
+    } else {
+        if ( !analyze && !outfile && !plotfile && !measure )
+            errx(1, "Must give either an output file or use --analyze, --metrics or --plot");
+        char *problem = design_error(&d);
+        if ( problem )
+            errx(1, "%s", problem);
+
+        buf = make_design(&d);
+    }
+
+    // a filter file for --apply was trimmed as it was read
+    if ( trimdb > 0 && !(extmode && applyfile) )
+        trim(&buf, 1, trimdb, extmode ? extfile : "the filter");
+
     // TODO: make this chatty
     normalize_peak_if_clipped(buf);
+
+    int32_t *fixed = NULL;
+    if ( quantize != quantize_none )
+        fixed = quantize_buf(buf, quantize, feedback);
+
+    // warped taps are written as they are, but shown as what they realize
+    audiobuf *shown = extmode ? buf : realized(&d, buf);
+    if ( shown != buf && (applyfile || partblock) )
+        errx(1, "--apply and --export-partitions need --warp-export unwarped");
     
-    if ( analyze )
-        analyze_filter(buf, stdout, analyzefactor);
+    if ( measure ) {
+        metrics *m = measure_filters(&shown, 1, analyzefactor, range_set ? &range : NULL);
+        print_metrics(m, extmode ? &extfile : NULL, 1, stdout);
+        free_metrics(m, 1);
+    }
 
-    if ( outfile )
-        write_file(buf, outfile);
+    if ( analyze || plotfile ) {
+        analysis *an = analyze_buf(shown, analyzefactor, analyzemode, range_set ? &range : NULL);
+        if ( analyze )
+            print_analysis(an, NULL, stdout);
+        if ( plotfile )
+            plot_analysis(an, extmode ? &extfile : NULL, plotfile, plotmode, plotwidth, plotheight);
+        free_analysis(an);
+    }
+
+    if ( partblock ) {
+        if ( !outfile )
+            errx(1, "Need an output file for --export-partitions");
+        if ( applyfile || fixed )
+            errx(1, "--export-partitions can't be used with --apply or fixed point");
+        partitions *parts = partition_filter(buf, partblock, partscheme);
+        write_partitions(parts, outfile);
+        free_partitions(parts);
+    } else if ( applyfile ) {
+        if ( !outfile )
+            errx(1, "Need an output file for --apply");
+        apply_file(buf, applyfile, outfile, outformat, applymethod, fixed, quantize);
+    } else if ( outfile && outformat == format_bank ) {
+        write_filters(&buf, fixed ? &fixed : NULL, fixed ? quantize_bits(quantize) : 0, 1, outfile, outformat);
+    } else if ( outfile && fixed ) {
+        write_fixed_frames(fixed, quantize_bits(quantize), buf->len, 1, buf->sr, outfile, outformat);
+    } else if ( outfile ) {
+        write_file(buf, outfile, outformat);
+    }
 }
 
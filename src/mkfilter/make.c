@@ -16,21 +16,24 @@
  */
 
 #include "make.h"
-#include "../kissfft/kiss_fft.h"
+#include "iir.h"
+#include "warp.h"
+#include "lsq.h"
+#include "jobs.h"
 
 #include <math.h>
 #include <err.h>
+#include <stdlib.h>
+#include <string.h>
 
 audiobuf *make_lowpass(int sr, float freq, int len, enum window window) {
-    audiobuf *buf = make_sinc(sr, freq, len);
-    apply_window(buf, window);
+    audiobuf *buf = make_windowed_sinc(sr, freq, len, window);
     normalize_dc(buf);
     return buf;
 }
 
 audiobuf *make_highpass(int sr, float freq, int len, enum window window) {
-    audiobuf *buf = make_sinc(sr, freq, len);
-    apply_window(buf, window);
+    audiobuf *buf = make_windowed_sinc(sr, freq, len, window);
     normalize_dc(buf);
     spectral_inversion_td(buf);
     return buf;
@@ -69,7 +72,6 @@ audiobuf *make_bandpass2(int sr, float freqlow, float freqhi, int len, enum wind
 
 audiobuf *make_bandstop2(int sr, float freqlow, float freqhi, int len, enum window window) {
     audiobuf *buf = make_bandpass2(sr, freqlow, freqhi, len, window);
-    buf->len--; // center correctly for the inversion
     spectral_inversion_td(buf);
     return buf;
 }
@@ -116,16 +118,16 @@ audiobuf *make_custom(int sr, wantcurve *curve, int len, enum window window) {
 
     int fftsize = 1 << (int)(ceil(log2(len))+1);
 
-    kiss_fft_cpx *in;
-    if ( (in = malloc(sizeof(kiss_fft_cpx)*fftsize)) == NULL )
+    fft_cpx *in;
+    if ( (in = malloc(sizeof(fft_cpx)*fftsize)) == NULL )
         err(1, "Couldn't malloc space for fft buffer");
 
-    kiss_fft_cpx *out;
-    if ( (out = malloc(sizeof(kiss_fft_cpx)*fftsize)) == NULL )
+    fft_cpx *out;
+    if ( (out = malloc(sizeof(fft_cpx)*fftsize)) == NULL )
         err(1, "Couldn't malloc space for fft buffer");
 
     // make the input for the fft that has the proper response
-    for (int i = 0; i < len; i++)
+    for (int i = 0; i < fftsize; i++)
         in[i].i = 0;
 
     int pti = 0;
@@ -161,9 +163,7 @@ audiobuf *make_custom(int sr, wantcurve *curve, int len, enum window window) {
         }
     }
 
-    kiss_fft_cfg cfg = kiss_fft_alloc(fftsize, 1, NULL, NULL);
-    kiss_fft(cfg, in, out);
-    kiss_fft_free(cfg);
+    fft(fftsize, true, in, out);
 
     free(in);
 
@@ -174,7 +174,7 @@ audiobuf *make_custom(int sr, wantcurve *curve, int len, enum window window) {
     int center = len/2;
     for (int i = 0; i < center; i++)
         audio[i] = out[fftsize+i-center].r / fftsize;
-    for (int i = 0; i < center; i++)
+    for (int i = 0; i <= center; i++)
         audio[i+center] = out[i].r / fftsize;
 
     free(out);
@@ -194,3 +194,374 @@ audiobuf *make_custom(int sr, wantcurve *curve, int len, enum window window) {
     return buf;
 }
 
+#define PI 3.1415926535897932384626433832795028841971693993
+
+static audiobuf *make_impulse(int sr, int len) {
+    audiobuf *buf;
+    if ( (buf = malloc(sizeof(audiobuf))) == NULL )
+        err(1, "Couldn't malloc space for audiobuf structure");
+    if ( (buf->td = calloc(len, sizeof(float))) == NULL )
+        err(1, "Couldn't malloc space for audio");
+    buf->td[len/2] = 1;
+    buf->len = len;
+    buf->fd = NULL;
+    buf->sr = sr;
+    buf->type = audiobuf_td;
+    return buf;
+}
+
+// butterworth (Q = 1/sqrt 2) second order sections from the RBJ cookbook
+enum section_kind { section_lowpass, section_highpass, section_allpass };
+
+static biquad butterworth_section(int sr, float freq, enum section_kind kind) {
+    double w0 = 2*PI*freq/sr;
+    double cw = cos(w0);
+    double alpha = sin(w0) / sqrt(2);
+    double a0 = 1 + alpha;
+
+    biquad b;
+    switch ( kind ) {
+        case section_lowpass:
+            b.b0 = (1-cw)/2; b.b1 = 1-cw;     b.b2 = (1-cw)/2;
+            break;
+        case section_highpass:
+            b.b0 = (1+cw)/2; b.b1 = -(1+cw);  b.b2 = (1+cw)/2;
+            break;
+        case section_allpass:
+            b.b0 = 1-alpha;  b.b1 = -2*cw;    b.b2 = 1+alpha;
+            break;
+        default:
+            errx(1, "not reached");
+    }
+    b.b0 /= a0;
+    b.b1 /= a0;
+    b.b2 /= a0;
+    b.a1 = -2*cw / a0;
+    b.a2 = (1-alpha) / a0;
+    return b;
+}
+
+/*
+ * The Linkwitz-Riley crossover is a tree: the 4th order lowpass at freqs[0]
+ * (two butterworth sections) gives band 0 and the highpass the rest, which is
+ * split at freqs[1], and so on. A LR4 lowpass and highpass at one frequency
+ * sum to the butterworth allpass there, so giving band k the allpasses of every
+ * split above it makes all the bands sum to the product of all the allpasses,
+ * which has a flat magnitude.
+ */
+static audiobuf *make_lr4_band(int sr, float *freqs, int ct, int band, int len) {
+    iircascade c;
+    c.sr = sr;
+    c.ct = 0;
+    if ( (c.sections = malloc(sizeof(biquad)*(3*ct+2))) == NULL )
+        err(1, "Couldn't malloc space for crossover sections");
+
+    for (int j = 0; j < band; j++) {
+        c.sections[c.ct++] = butterworth_section(sr, freqs[j], section_highpass);
+        c.sections[c.ct++] = butterworth_section(sr, freqs[j], section_highpass);
+    }
+    if ( band < ct ) {
+        c.sections[c.ct++] = butterworth_section(sr, freqs[band], section_lowpass);
+        c.sections[c.ct++] = butterworth_section(sr, freqs[band], section_lowpass);
+    }
+    for (int j = band+1; j < ct; j++)
+        c.sections[c.ct++] = butterworth_section(sr, freqs[j], section_allpass);
+
+    audiobuf *buf = render_iir_cascade(&c, len);
+    free(c.sections);
+    return buf;
+}
+
+audiobuf **make_crossover(int sr, float *freqs, int ct, int len, enum window window, enum crossover_mode mode) {
+    if ( len % 2 == 0 ) len++; // odd size, so every band shares one center tap
+
+    audiobuf **bands;
+    if ( (bands = malloc(sizeof(audiobuf*)*(ct+1))) == NULL )
+        err(1, "Couldn't malloc space for crossover bands");
+
+    if ( mode == crossover_minimum ) {
+        PARALLEL_FOR
+        for (int i = 0; i <= ct; i++)
+            bands[i] = make_lr4_band(sr, freqs, ct, i, len);
+        return bands;
+    }
+
+    // one lowpass prototype per crossover frequency; band i is what lies
+    // between the prototypes below and above it, so the bands telescope to
+    // the impulse
+    PARALLEL_FOR
+    for (int i = 0; i < ct; i++)
+        bands[i] = make_lowpass(sr, freqs[i], len, window);
+    bands[ct] = make_impulse(sr, len);
+
+    for (int i = ct; i > 0; i--)
+        for (int j = 0; j < len; j++)
+            bands[i]->td[j] -= bands[i-1]->td[j];
+
+    return bands;
+}
+
+void default_design(design *d) {
+    d->type = nofiltertype;
+    d->window = window_blackman;
+    d->freq1 = 0;
+    d->freq2 = 0;
+    d->freqs_set = 0;
+    d->depth = 0.01;
+    d->sr = 44100;
+    d->len = 1000;
+    d->convolutions = 0;
+    d->curve = NULL;
+    d->weights = NULL;
+    d->sections = 4;
+    d->sosfile = NULL;
+    d->freqs = NULL;
+    d->crossover = crossover_linear;
+    d->smooth.kernel = smooth_none;
+    d->smooth.width = 0;
+    d->smooth.ppo = 0;
+    d->warp = NAN;
+    d->warp_export = warp_unwarped;
+}
+
+double design_warp(design *d) {
+    return isnan(d->warp) ? bark_warp(d->sr) : d->warp;
+}
+
+static bool uses_curve(enum filtertype type) {
+    return type == custom || type == iirfit || type == warped || type == lsq;
+}
+
+char *design_error(design *d) {
+    if ( d->type == nofiltertype )
+        return "Must give a filter type";
+    if ( d->type == custom && !d->curve )
+        return "Need a wantcurve for the custom fit filter";
+    if ( d->type == iirfit && !d->curve )
+        return "Need a wantcurve for the iir fit filter";
+    if ( d->type == warped && !d->curve )
+        return "Need a wantcurve for the warped fit filter";
+    if ( d->type == lsq && !d->curve )
+        return "Need a wantcurve for the least squares filter";
+    if ( d->type != lsq && d->weights )
+        return "Only least squares filters take weights";
+    if ( d->type == warped && !(fabs(design_warp(d)) < 1) )
+        return "The warping factor must be between -1 and 1";
+    if ( !uses_curve(d->type) && d->smooth.kernel != smooth_none )
+        return "Only filters fit to a wantcurve have a curve to smooth";
+    if ( !uses_curve(d->type) && !d->freqs_set )
+        return "Need a frequency";
+    if ( d->type != crossover && d->freqs_set > 2 )
+        return "Too many frequencies, only crossovers take more than two";
+    if ( d->type == crossover && d->convolutions )
+        return "Crossovers can't be convolved with themselves";
+    if ( d->type == crossover ) {
+        for (int i = 0; i < d->freqs_set; i++) {
+            if ( d->freqs[i] <= 0 || d->freqs[i] >= d->sr/2.0 )
+                return "Crossover frequencies must be between 0 and nyquist";
+            if ( i > 0 && d->freqs[i] <= d->freqs[i-1] )
+                return "Crossover frequencies must be increasing";
+        }
+    }
+    return NULL;
+}
+
+audiobuf *make_design(design *d) {
+    audiobuf *buf;
+
+    float freq1 = d->freq1;
+    float freq2 = d->freqs_set == 1 ? d->freq1 : d->freq2;
+
+    wantcurve *curve = d->curve;
+    if ( curve && d->smooth.kernel != smooth_none )
+        curve = smooth_wantcurve(curve, &d->smooth);
+
+    switch ( d->type ) {
+        case lowpass:
+            buf = make_lowpass(d->sr, freq1, d->len, d->window);
+            break;
+
+        case highpass:
+            buf = make_highpass(d->sr, freq1, d->len, d->window);
+            break;
+
+        case bandpass:
+            buf = make_bandpass(d->sr, freq1, freq2, d->len, d->window);
+            break;
+
+        case bandpass2:
+            buf = make_bandpass2(d->sr, freq1, freq2, d->len, d->window);
+            break;
+
+        case bandstop:
+            buf = make_bandstop(d->sr, freq1, freq2, d->len, d->window);
+            break;
+
+        case bandstop2:
+            buf = make_bandstop2(d->sr, freq1, freq2, d->len, d->window);
+            break;
+
+        case bandstopdeep:
+            buf = make_bandstopdeep(d->sr, freq1, d->depth, d->len, d->window);
+            break;
+
+        case custom:
+            buf = make_custom(d->sr, curve, d->len, d->window);
+            break;
+
+        case iirfit: {
+            iircascade *cascade = fit_iir_cascade(d->sr, curve, d->sections);
+            if ( d->sosfile )
+                write_sos(cascade, d->sosfile);
+            buf = render_iir_cascade(cascade, d->len);
+            free_iir_cascade(cascade);
+            break;
+        }
+
+        case lsq:
+            buf = make_lsq(d->sr, curve, d->weights, d->len);
+            break;
+
+        case warped: {
+            double lambda = design_warp(d);
+            buf = make_warped(d->sr, curve, d->len, lambda, d->window);
+            if ( d->warp_export == warp_unwarped ) {
+                audiobuf *coefs = buf;
+                buf = unwarp_fir(coefs, lambda, 0);
+                free_buf(coefs);
+            }
+            break;
+        }
+
+        case crossover:
+            errx(1, "A crossover makes several filters, not one");
+
+        default:
+            errx(1, "Not reached");
+    }
+
+    if ( curve != d->curve )
+        free_wantcurve(curve);
+
+    if ( d->convolutions ) {
+        audiobuf *orig = duplicate_buf(buf);
+        for (int i = 0; i < d->convolutions; i++) {
+            audiobuf *new = convolve(orig, buf);
+            free_buf(buf);
+            buf = new;
+        }
+        free_buf(orig);
+    }
+
+    return buf;
+}
+
+audiobuf **make_design_bands(design *d, int *ct) {
+    if ( d->type == crossover ) {
+        *ct = d->freqs_set+1;
+        return make_crossover(d->sr, d->freqs, d->freqs_set, d->len, d->window, d->crossover);
+    }
+
+    audiobuf **bufs;
+    if ( (bufs = malloc(sizeof(audiobuf*))) == NULL )
+        err(1, "Couldn't malloc space for filters");
+    bufs[0] = make_design(d);
+    *ct = 1;
+    return bufs;
+}
+
+bool handle_type(char *name, enum filtertype *type) {
+    if ( strcmp(name, "lowpass") == 0 || strcmp(name, "lp") == 0 ) {
+        *type = lowpass;
+    } else if ( strcmp(name, "highpass") == 0 || strcmp(name, "hp") == 0 ) {
+        *type = highpass;
+    } else if ( strcmp(name, "bandpass") == 0 || strcmp(name, "bp") == 0 ) {
+        *type = bandpass;
+    } else if ( strcmp(name, "bandpass2") == 0 || strcmp(name, "bp2") == 0 ) {
+        *type = bandpass2;
+    } else if ( strcmp(name, "bandstop") == 0 || strcmp(name, "bs") == 0 || strcmp(name, "notch") == 0 ) {
+        *type = bandstop;
+    } else if ( strcmp(name, "bandstop2") == 0 || strcmp(name, "bs2") == 0 || strcmp(name, "notch2") == 0 ) {
+        *type = bandstop2;
+    } else if ( strcmp(name, "bandstopdeep") == 0 || strcmp(name, "deepnotch") == 0 || strcmp(name, "dn") == 0 ) {
+        *type = bandstopdeep;
+    } else if ( strcmp(name, "custom") == 0 || strcmp(name, "fit") == 0 ) {
+        *type = custom;
+    } else if ( strcmp(name, "iir-fit") == 0 || strcmp(name, "iirfit") == 0 || strcmp(name, "iir") == 0 ) {
+        *type = iirfit;
+    } else if ( strcmp(name, "warped") == 0 || strcmp(name, "warped-fit") == 0 || strcmp(name, "wfir") == 0 ) {
+        *type = warped;
+    } else if ( strcmp(name, "lsq") == 0 || strcmp(name, "least-squares") == 0 ) {
+        *type = lsq;
+    } else if ( strcmp(name, "crossover") == 0 || strcmp(name, "xo") == 0 ) {
+        *type = crossover;
+    } else {
+        return false;
+    }
+    return true; // didn't hit the last else clause, something worked
+}
+
+bool handle_window(char *name, enum window *window) {
+    if ( strcmp(name, "blackman") == 0 ) {
+        *window = window_blackman;
+    } else if ( strcmp(name, "hamming") == 0 ) {
+        *window = window_hamming;
+    } else if ( strcmp(name, "barlett") == 0 ) {
+        *window = window_barlett;
+    } else if ( strcmp(name, "cosine") == 0 || strcmp(name, "hanning") == 0 ) {
+        *window = window_hanning;
+    } else if ( strcmp(name, "rectangular") == 0 || strcmp(name, "none") == 0 ) {
+        *window = window_rectangular;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool handle_crossover_mode(char *name, enum crossover_mode *mode) {
+    if ( strcmp(name, "linear") == 0 ) {
+        *mode = crossover_linear;
+    } else if ( strcmp(name, "minimum") == 0 || strcmp(name, "lr4") == 0 ) {
+        *mode = crossover_minimum;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool handle_warp_export(char *name, enum warp_export *export) {
+    if ( strcmp(name, "unwarped") == 0 || strcmp(name, "realized") == 0 ) {
+        *export = warp_unwarped;
+    } else if ( strcmp(name, "warped") == 0 || strcmp(name, "coefficients") == 0 ) {
+        *export = warp_coefficients;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool handle_frequencies(char *spec, design *d) {
+    int ct = 1;
+    for (char *s = spec; *s; s++)
+        if ( *s == ',' )
+            ct++;
+    if ( (d->freqs = malloc(sizeof(float)*ct)) == NULL )
+        err(1, "Couldn't malloc space for frequencies");
+
+    d->freqs_set = 0;
+    while ( true ) {
+        char *end;
+        d->freqs[d->freqs_set++] = strtof(spec, &end);
+        if ( end == spec )
+            return false;
+        spec = end;
+        if ( *spec != ',' )
+            break;
+        spec++;
+    }
+
+    d->freq1 = d->freqs[0];
+    d->freq2 = d->freqs_set > 1 ? d->freqs[1] : 0;
+    return *spec == '\0';
+}
+
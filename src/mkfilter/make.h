@@ -20,8 +20,86 @@
 
 #include "audiobuf.h"
 #include "wantcurve.h"
+#include "smooth.h"
 #include "tools.h"
 
+#include <stdbool.h>
+
+enum filtertype {
+    nofiltertype,
+    lowpass,
+    highpass,
+    bandpass,
+    bandpass2,
+    bandstop,
+    bandstop2,
+    bandstopdeep,
+    custom,
+    iirfit,
+    warped,
+    lsq,
+    crossover
+};
+
+enum warp_export {
+    warp_unwarped,    // the realized impulse response
+    warp_coefficients // the warped FIR's own taps, for a warped runtime
+};
+
+enum crossover_mode {
+    crossover_linear,  // linear phase FIR bands
+    crossover_minimum  // Linkwitz-Riley 4th order IIR bands
+};
+
+// everything needed to make one filter, as given on the command line or on a
+// line of a bank manifest
+typedef struct design {
+    enum filtertype type;
+    enum window window;
+    float freq1;
+    float freq2;
+    float *freqs;  // every frequency given, for crossovers
+    int freqs_set; // how many frequencies were given
+    double depth;
+    int sr;
+    int len;
+    int convolutions;
+    wantcurve *curve;
+    wantcurve *weights; // lsq only, may be NULL
+    int sections;  // iir-fit only
+    char *sosfile; // iir-fit only, may be NULL
+    enum crossover_mode crossover;
+    smoothing smooth; // of the wantcurve, before custom and iir-fit designs
+    double warp;      // warped only, nan for bark_warp at the sample rate
+    enum warp_export warp_export;
+} design;
+
+// the defaults used when an option isn't given
+void default_design(design *d);
+
+// a description of what the design is missing, or NULL if it can be made
+char *design_error(design *d);
+
+// makes the filter, including any extra convolutions. the design must have
+// passed design_error.
+audiobuf *make_design(design *d);
+
+// the bands of a crossover design, or the one filter of any other design
+audiobuf **make_design_bands(design *d, int *ct);
+
+bool handle_type(char *name, enum filtertype *type);
+bool handle_window(char *name, enum window *window);
+
+bool handle_crossover_mode(char *name, enum crossover_mode *mode);
+bool handle_warp_export(char *name, enum warp_export *export);
+
+// the warping factor the design uses
+double design_warp(design *d);
+
+// "freq[,freq...]" into freqs and freqs_set, and the first two into freq1 and
+// freq2
+bool handle_frequencies(char *spec, design *d);
+
 audiobuf *make_lowpass(int sr, float freq, int len, enum window window);
 audiobuf *make_highpass(int sr, float freq, int len, enum window window);
 audiobuf *make_bandstop(int sr, float freqlow, float freqhi, int len, enum window window);
@@ -31,5 +109,13 @@ audiobuf *make_bandstop2(int sr, float freqlow, float freqhi, int len, enum wind
 audiobuf *make_bandstopdeep(int sr, float freq, double depth, int len, enum window window);
 audiobuf *make_custom(int sr, wantcurve *curve, int len, enum window window);
 
+/*
+ * The ct+1 bands of a crossover at the ct increasing frequencies, lowest band
+ * first. The bands sum to a pure delay in linear mode, where they are
+ * differences of lowpass prototypes of one length, and to an allpass in
+ * minimum mode.
+ */
+audiobuf **make_crossover(int sr, float *freqs, int ct, int len, enum window window, enum crossover_mode mode);
+
 #endif
 
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+
+#include "manifest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <err.h>
+#include <math.h>
+
+static void set_int(char *value, int *dst, int min, char *path, int line, char *name) {
+    char *end;
+    long v = strtol(value, &end, 10);
+    if ( *end || end == value || v < min )
+        errx(1, "%s:%d: Bad %s %s", path, line, name, value);
+    *dst = v;
+}
+
+// applies one name=value setting to the design
+static void set_option(design *d, char *name, char *value, bool *sr_set, char *path, int line) {
+    if ( strcmp(name, "type") == 0 ) {
+        if ( !handle_type(value, &d->type) )
+            errx(1, "%s:%d: Unknown filter type %s", path, line, value);
+    } else if ( strcmp(name, "frequency") == 0 || strcmp(name, "frequencies") == 0 ) {
+        if ( !handle_frequencies(value, d) )
+            errx(1, "%s:%d: Bad frequency specifier %s", path, line, value);
+    } else if ( strcmp(name, "depth") == 0 ) {
+        char *end;
+        d->depth = strtod(value, &end);
+        if ( *end || end == value )
+            errx(1, "%s:%d: Bad depth %s", path, line, value);
+    } else if ( strcmp(name, "window") == 0 ) {
+        if ( !handle_window(value, &d->window) )
+            errx(1, "%s:%d: Unknown window type %s", path, line, value);
+    } else if ( strcmp(name, "sample-rate") == 0 ) {
+        set_int(value, &d->sr, 1, path, line, "sample rate");
+        *sr_set = true;
+    } else if ( strcmp(name, "length") == 0 ) {
+        set_int(value, &d->len, 1, path, line, "length");
+    } else if ( strcmp(name, "convolutions") == 0 ) {
+        set_int(value, &d->convolutions, 0, path, line, "convolution count");
+    } else if ( strcmp(name, "frequency-curve-file") == 0 ) {
+        d->curve = read_wantcurve_from_path(value);
+    } else if ( strcmp(name, "weight-curve-file") == 0 ) {
+        d->weights = read_wantcurve_from_path(value);
+    } else if ( strcmp(name, "smooth") == 0 ) {
+        if ( !handle_smoothing(value, &d->smooth) )
+            errx(1, "%s:%d: Bad smoothing specifier %s", path, line, value);
+    } else if ( strcmp(name, "warp") == 0 ) {
+        char *end;
+        d->warp = strtod(value, &end);
+        if ( *end || !(fabs(d->warp) < 1) )
+            errx(1, "%s:%d: Bad warping factor %s", path, line, value);
+    } else if ( strcmp(name, "warp-export") == 0 ) {
+        if ( !handle_warp_export(value, &d->warp_export) )
+            errx(1, "%s:%d: Unknown warp export %s", path, line, value);
+    } else if ( strcmp(name, "sections") == 0 ) {
+        set_int(value, &d->sections, 1, path, line, "section count");
+    } else if ( strcmp(name, "sos") == 0 ) {
+        d->sosfile = strdup(value);
+    } else if ( strcmp(name, "crossover-phase") == 0 ) {
+        if ( !handle_crossover_mode(value, &d->crossover) )
+            errx(1, "%s:%d: Unknown crossover phase %s", path, line, value);
+    } else {
+        errx(1, "%s:%d: Unknown setting %s", path, line, name);
+    }
+}
+
+design *read_manifest(char *path, design *defaults, int *ct) {
+    FILE *fh;
+    if ( strcmp(path, "-") == 0 )
+        fh = stdin;
+    else if ( (fh = fopen(path, "r")) == NULL )
+        err(1, "Couldn't open manifest %s", path);
+
+    int malloced = 16;
+    design *designs;
+    if ( (designs = malloc(sizeof(design)*malloced)) == NULL )
+        err(1, "Couldn't allocate space for manifest");
+    *ct = 0;
+
+    char *text = NULL;
+    size_t textsize = 0;
+    int line = 0;
+    while ( getline(&text, &textsize, fh) != -1 ) {
+        line++;
+
+        char *s = text;
+        while ( isspace(*s) ) s++;
+        if ( *s == '\0' || *s == '#' )
+            continue;
+
+        design d = *defaults;
+        bool sr_set = false;
+
+        for (char *tok = strtok(s, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+            if ( *tok == '#' )
+                break;
+            char *eq = strchr(tok, '=');
+            if ( !eq )
+                errx(1, "%s:%d: Expected name=value, got %s", path, line, tok);
+            *eq = '\0';
+            set_option(&d, tok, eq+1, &sr_set, path, line);
+        }
+
+        if ( !sr_set && d.curve != defaults->curve && d.curve->has_sr )
+            d.sr = d.curve->sr;
+
+        char *problem = design_error(&d);
+        if ( problem )
+            errx(1, "%s:%d: %s", path, line, problem);
+
+        if ( *ct == malloced ) {
+            malloced *= 2;
+            if ( (designs = realloc(designs, sizeof(design)*malloced)) == NULL )
+                err(1, "Couldn't allocate space for manifest");
+        }
+        designs[(*ct)++] = d;
+    }
+    if ( ferror(fh) )
+        err(1, "Couldn't read manifest %s", path);
+
+    free(text);
+    if ( fh != stdin )
+        fclose(fh);
+
+    if ( *ct == 0 )
+        errx(1, "Manifest %s is empty", path);
+
+    return designs;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+
+#ifndef __MANIFEST_H__
+#define __MANIFEST_H__
+
+#include "make.h"
+
+/*
+ * A manifest lists the filters of a bank, one per line. Each line is a list of
+ * name=value settings named like the long options, for example
+ *
+ *     type=bandpass frequencies=89,112 length=8001 window=hamming
+ *
+ * using type, frequency (or frequencies), depth, window, sample-rate, length,
+ * convolutions, frequency-curve-file, weight-curve-file, smooth, warp,
+ * warp-export, sections, sos and crossover-phase.
+ * Anything a line doesn't set comes from defaults, and a crossover line gives
+ * all of its bands. Blank lines and # comments are skipped, and "-" reads
+ * stdin.
+ */
+design *read_manifest(char *path, design *defaults, int *ct);
+
+#endif
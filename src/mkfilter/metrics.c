@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "metrics.h"
+#include "jobs.h"
+#include "fir.h"
+#include "file.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <err.h>
+
+// bins this far below the peak are taken as this far, so exact zeros
+// still interpolate
+#define FLOOR_DB -300
+
+// a run of bins that are all in, or all out of, the -3dB passband
+typedef struct band {
+    int from, to; // the whole run
+    int in, out;  // the part past the rolloff at either end
+    bool pass;
+} band;
+
+static double gain_db(double gain) {
+    return gain != 0 ? 20*log10(fabs(gain)) : NAN;
+}
+
+// every frequency where db crosses level, interpolated between bins
+static int crossings(double *db, int bins, double from, double step, double level, double **out) {
+    int ct = 0;
+    for (int i = 0; i+1 < bins; i++)
+        if ( (db[i] >= level) != (db[i+1] >= level) )
+            ct++;
+
+    if ( (*out = malloc(sizeof(double)*(ct ? ct : 1))) == NULL )
+        err(1, "Couldn't allocate space for band edges");
+
+    ct = 0;
+    for (int i = 0; i+1 < bins; i++)
+        if ( (db[i] >= level) != (db[i+1] >= level) )
+            (*out)[ct++] = from + (i + (level-db[i])/(db[i+1]-db[i]))*step;
+    return ct;
+}
+
+// cuts the spectrum into bands, walking each in from its inner edges to the
+// first ripple peak (passbands) or null (stopbands). the ends of the
+// analysis aren't edges. a passband without ripple, rising to a single
+// peak, would shrink to that peak; instead it ends as far inside its -3dB
+// edge as the stopband beyond starts outside it, so the droop over what the
+// rolloff leaves flat counts, and all of it when the rolloff leaves nothing.
+static band *find_bands(double *db, int bins, int *ct) {
+    band *b;
+    if ( (b = malloc(sizeof(band)*bins)) == NULL )
+        err(1, "Couldn't allocate space for bands");
+
+    *ct = 0;
+    for (int i = 0; i < bins; ) {
+        band *r = &b[(*ct)++];
+        r->pass = db[i] >= -3;
+        r->from = i;
+        while ( i < bins && (db[i] >= -3) == r->pass )
+            i++;
+        r->to = i-1;
+
+        // passbands walk while rising, stopbands while falling
+        double dir = r->pass ? 1 : -1;
+        r->in = r->from;
+        if ( r->from > 0 )
+            while ( r->in < r->to && dir*(db[r->in+1] - db[r->in]) > 0 )
+                r->in++;
+        r->out = r->to;
+        if ( r->to < bins-1 )
+            while ( r->out > r->in && dir*(db[r->out-1] - db[r->out]) > 0 )
+                r->out--;
+    }
+
+    // bands alternate, so a passband's neighbours are stopbands
+    for (int k = 0; k < *ct; k++) {
+        band *r = &b[k];
+        if ( !r->pass || r->in != r->out )
+            continue;
+        r->in = k > 0 ? 2*r->from - b[k-1].out : r->from;
+        r->out = k+1 < *ct ? 2*r->to - b[k+1].in : r->to;
+        if ( r->in < r->from ) r->in = r->from;
+        if ( r->out > r->to ) r->out = r->to;
+        if ( r->in > r->out ) {
+            r->in = r->from;
+            r->out = r->to;
+        }
+    }
+    return b;
+}
+
+void measure_filter(audiobuf *buf, int analyzefactor, analyze_range *range, metrics *m) {
+    // the taps first, before analysis pads them
+    int len = fir_length(buf);
+    double dc = 0, nyquist = 0, energy = 0, moment = 0;
+    for (int i = 0; i < len; i++) {
+        double h = buf->td[i];
+        dc += h;
+        nyquist += i % 2 ? -h : h;
+        energy += h*h;
+        moment += i*h*h;
+    }
+    m->sr = buf->sr;
+    m->taps = len;
+    m->dc = gain_db(dc);
+    m->nyquist = gain_db(nyquist);
+    m->centroid = energy > 0 ? moment/energy : NAN;
+
+    analysis *a = analyze_buf(buf, analyzefactor, analyze_group_delay, range);
+    int bins = a->bins;
+
+    double peak = 0;
+    for (int i = 0; i < bins; i++)
+        if ( peak < a->mag[i] )
+            peak = a->mag[i];
+
+    double *db;
+    if ( (db = malloc(sizeof(double)*bins)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for metrics", sizeof(double)*bins);
+    for (int i = 0; i < bins; i++) {
+        db[i] = peak > 0 && a->mag[i] > 0 ? 20*log10(a->mag[i]/peak) : FLOOR_DB;
+        if ( db[i] < FLOOR_DB )
+            db[i] = FLOOR_DB;
+    }
+
+    m->edges3ct = crossings(db, bins, a->from, a->step, -3, &m->edges3);
+    m->edges6ct = crossings(db, bins, a->from, a->step, -6, &m->edges6);
+
+    int bandct;
+    band *b = find_bands(db, bins, &bandct);
+
+    double lo = INFINITY, hi = -INFINITY, stop = -INFINITY;
+    m->peak_delay = NAN;
+    m->transition = NAN;
+    for (int k = 0; k < bandct; k++) {
+        for (int i = b[k].in; i <= b[k].out; i++) {
+            if ( b[k].pass ) {
+                if ( lo > db[i] ) lo = db[i];
+                if ( hi < db[i] ) hi = db[i];
+                if ( !isnan(a->other[i]) && !(m->peak_delay >= a->other[i]) )
+                    m->peak_delay = a->other[i];
+            } else if ( stop < db[i] ) {
+                stop = db[i];
+            }
+        }
+
+        // from the passband before each stopband, and to the one after
+        if ( b[k].pass )
+            continue;
+        double width = NAN;
+        if ( k > 0 )
+            width = (b[k].in - b[k-1].out) * a->step;
+        if ( k+1 < bandct && !(width >= (b[k+1].in - b[k].out) * a->step) )
+            width = (b[k+1].in - b[k].out) * a->step;
+        if ( !isnan(width) && !(m->transition >= width) )
+            m->transition = width;
+    }
+    m->ripple = hi >= lo ? hi - lo : NAN;
+    m->attenuation = stop > -INFINITY ? -stop : NAN;
+
+    free(b);
+    free(db);
+    free_analysis(a);
+}
+
+static metrics *alloc_metrics(int ct) {
+    metrics *m;
+    if ( (m = malloc(sizeof(metrics)*(ct ? ct : 1))) == NULL )
+        err(1, "Couldn't allocate space for metrics");
+    return m;
+}
+
+metrics *measure_filters(audiobuf **bufs, int ct, int analyzefactor, analyze_range *range) {
+    metrics *m = alloc_metrics(ct);
+
+    PARALLEL_FOR
+    for (int f = 0; f < ct; f++)
+        measure_filter(bufs[f], analyzefactor, range, &m[f]);
+
+    return m;
+}
+
+metrics *measure_paths(char **paths, int ct, int analyzefactor, analyze_range *range) {
+    metrics *m = alloc_metrics(ct);
+
+    PARALLEL_FOR
+    for (int f = 0; f < ct; f++) {
+        audiobuf *buf = read_file(paths[f]);
+        measure_filter(buf, analyzefactor, range, &m[f]);
+        free_buf(buf);
+    }
+
+    return m;
+}
+
+static void print_number(double v, FILE *fh) {
+    if ( isfinite(v) )
+        fprintf(fh, "%.10g", v);
+    else
+        fprintf(fh, "null");
+}
+
+static void print_list(double *v, int ct, FILE *fh) {
+    fprintf(fh, "[");
+    for (int i = 0; i < ct; i++) {
+        if ( i ) fprintf(fh, ",");
+        print_number(v[i], fh);
+    }
+    fprintf(fh, "]");
+}
+
+static void print_string(char *s, FILE *fh) {
+    fputc('"', fh);
+    for (unsigned char *c = (unsigned char *)s; *c; c++) {
+        if ( *c == '"' || *c == '\\' )
+            fprintf(fh, "\\%c", *c);
+        else if ( *c < 32 )
+            fprintf(fh, "\\u%04x", *c);
+        else
+            fputc(*c, fh);
+    }
+    fputc('"', fh);
+}
+
+void print_metrics(metrics *m, char **names, int ct, FILE *fh) {
+    for (int f = 0; f < ct; f++) {
+        fprintf(fh, "{\"name\":");
+        if ( names )
+            print_string(names[f], fh);
+        else
+            fprintf(fh, "null");
+        fprintf(fh, ",\"sr\":%d,\"taps\":%d", m[f].sr, m[f].taps);
+        fprintf(fh, ",\"passband_ripple_db\":");      print_number(m[f].ripple, fh);
+        fprintf(fh, ",\"stopband_attenuation_db\":"); print_number(m[f].attenuation, fh);
+        fprintf(fh, ",\"transition_width_hz\":");     print_number(m[f].transition, fh);
+        fprintf(fh, ",\"edges_3db_hz\":");            print_list(m[f].edges3, m[f].edges3ct, fh);
+        fprintf(fh, ",\"edges_6db_hz\":");            print_list(m[f].edges6, m[f].edges6ct, fh);
+        fprintf(fh, ",\"dc_gain_db\":");              print_number(m[f].dc, fh);
+        fprintf(fh, ",\"nyquist_gain_db\":");         print_number(m[f].nyquist, fh);
+        fprintf(fh, ",\"peak_group_delay\":");        print_number(m[f].peak_delay, fh);
+        fprintf(fh, ",\"energy_centroid\":");         print_number(m[f].centroid, fh);
+        fprintf(fh, "}\n");
+    }
+}
+
+void free_metrics(metrics *m, int ct) {
+    for (int f = 0; f < ct; f++) {
+        free(m[f].edges3);
+        free(m[f].edges6);
+    }
+    free(m);
+}
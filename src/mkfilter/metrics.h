@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include "audiobuf.h"
+#include "analyze.h"
+
+#include <stdio.h>
+
+/*
+ * Acceptance figures for a filter, measured on its group delay analysis.
+ *
+ * The bands are found from the response itself, so it works for any filter
+ * file: every stretch within 3dB of the peak is a passband and everything
+ * else a stopband. A passband ends at its last ripple before the -3dB edge
+ * and a stopband starts at its first null past the edge, which leaves the
+ * rolloff between them as the transition. A passband without ripple ends as
+ * far inside the edge as its stopband starts outside it, or takes in all of
+ * its droop when the rolloff is wider than the passband. Where a response
+ * just keeps falling to the end of the analysis, the stopband is the last
+ * bin.
+ *
+ * Anything that doesn't exist for a filter (a stopband on an allpass, the
+ * dB of an exact zero) is nan.
+ */
+typedef struct metrics {
+    int sr;
+    int taps;
+    double ripple;       // dB, peak to trough over all passbands
+    double attenuation;  // dB below the peak of the highest stopband bin
+    double transition;   // Hz, the widest from a passband to its stopband
+    int edges3ct;
+    int edges6ct;
+    double *edges3;      // Hz, every -3dB crossing
+    double *edges6;      // Hz, every -6dB crossing
+    double dc;           // gain in dB, from the taps
+    double nyquist;      // likewise
+    double peak_delay;   // samples, the most group delay in any passband
+    double centroid;     // samples, the energy centroid of the taps
+} metrics;
+
+// measures one filter, leaving it padded in the frequency domain
+void measure_filter(audiobuf *buf, int analyzefactor, analyze_range *range, metrics *m);
+
+/*
+ * Measures each filter in parallel, analyzing one filter per thread at a time
+ * so a large batch never holds more than a few spectra. The buffers are left
+ * padded in the frequency domain, as with analyze_buf.
+ */
+metrics *measure_filters(audiobuf **bufs, int ct, int analyzefactor, analyze_range *range);
+
+// the same for filter files, each read only while it is measured
+metrics *measure_paths(char **paths, int ct, int analyzefactor, analyze_range *range);
+
+// one JSON object per line and filter, with nan as null
+void print_metrics(metrics *m, char **names, int ct, FILE *fh);
+void free_metrics(metrics *m, int ct);
+
+#endif
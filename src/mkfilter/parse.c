@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "parse.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+static textfile *alloc_textfile(void) {
+    textfile *t;
+    if ( (t = malloc(sizeof(textfile))) == NULL )
+        err(1, "Couldn't allocate space for text file");
+    t->text = NULL;
+    t->len = 0;
+    t->mapped = 0;
+    return t;
+}
+
+textfile *map_text(char *path) {
+    if ( strcmp(path, "-") == 0 )
+        return map_text_file(stdin);
+
+    FILE *fh;
+    if ( (fh = fopen(path, "rb")) == NULL )
+        err(1, "Couldn't open %s for reading", path);
+    textfile *t = map_text_file(fh);
+    fclose(fh);
+    return t;
+}
+
+textfile *map_text_file(FILE *fh) {
+    textfile *t = alloc_textfile();
+
+    // the mapping stays valid after the file is closed
+    struct stat st;
+    if ( fstat(fileno(fh), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 ) {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fh), 0);
+        if ( p != MAP_FAILED ) {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            t->text = p;
+            t->len = t->mapped = st.st_size;
+            return t;
+        }
+    }
+
+    size_t malloced = 1 << 16;
+    if ( (t->text = malloc(malloced)) == NULL )
+        err(1, "Couldn't allocate space for text");
+    size_t got;
+    while ( (got = fread(t->text+t->len, 1, malloced-t->len, fh)) > 0 ) {
+        t->len += got;
+        if ( t->len == malloced ) {
+            malloced *= 2;
+            if ( (t->text = realloc(t->text, malloced)) == NULL )
+                err(1, "Couldn't allocate %zu bytes for text", malloced);
+        }
+    }
+    if ( ferror(fh) )
+        err(1, "Couldn't read text");
+    return t;
+}
+
+void unmap_text(textfile *t) {
+    if ( t->mapped )
+        munmap(t->text, t->mapped);
+    else
+        free(t->text);
+    free(t);
+}
+
+/*
+ * The top 128 bits of 5^q for q from POW5_MIN to POW5_MAX, as in the table
+ * of Lemire's "Number Parsing at a Gigabyte per Second" (rounded up for
+ * negative q). The range covers every float; doubles beyond it go to
+ * strtod.
+ */
+#define POW5_MIN -96
+#define POW5_MAX 96
+static const uint64_t pow5[][2] = {
+    { 0x88b402f7fd75539b, 0x11dbcb0218ebb414 }, // -96
+    { 0xaae103b5fcd2a881, 0xd652bdc29f26a119 }, // -95
+    { 0xd59944a37c0752a2, 0x4be76d3346f0495f }, // -94
+    { 0x857fcae62d8493a5, 0x6f70a4400c562ddb }, // -93
+    { 0xa6dfbd9fb8e5b88e, 0xcb4ccd500f6bb952 }, // -92
+    { 0xd097ad07a71f26b2, 0x7e2000a41346a7a7 }, // -91
+    { 0x825ecc24c873782f, 0x8ed400668c0c28c8 }, // -90
+    { 0xa2f67f2dfa90563b, 0x728900802f0f32fa }, // -89
+    { 0xcbb41ef979346bca, 0x4f2b40a03ad2ffb9 }, // -88
+    { 0xfea126b7d78186bc, 0xe2f610c84987bfa8 }, // -87
+    { 0x9f24b832e6b0f436, 0x0dd9ca7d2df4d7c9 }, // -86
+    { 0xc6ede63fa05d3143, 0x91503d1c79720dbb }, // -85
+    { 0xf8a95fcf88747d94, 0x75a44c6397ce912a }, // -84
+    { 0x9b69dbe1b548ce7c, 0xc986afbe3ee11aba }, // -83
+    { 0xc24452da229b021b, 0xfbe85badce996168 }, // -82
+    { 0xf2d56790ab41c2a2, 0xfae27299423fb9c3 }, // -81
+    { 0x97c560ba6b0919a5, 0xdccd879fc967d41a }, // -80
+    { 0xbdb6b8e905cb600f, 0x5400e987bbc1c920 }, // -79
+    { 0xed246723473e3813, 0x290123e9aab23b68 }, // -78
+    { 0x9436c0760c86e30b, 0xf9a0b6720aaf6521 }, // -77
+    { 0xb94470938fa89bce, 0xf808e40e8d5b3e69 }, // -76
+    { 0xe7958cb87392c2c2, 0xb60b1d1230b20e04 }, // -75
+    { 0x90bd77f3483bb9b9, 0xb1c6f22b5e6f48c2 }, // -74
+    { 0xb4ecd5f01a4aa828, 0x1e38aeb6360b1af3 }, // -73
+    { 0xe2280b6c20dd5232, 0x25c6da63c38de1b0 }, // -72
+    { 0x8d590723948a535f, 0x579c487e5a38ad0e }, // -71
+    { 0xb0af48ec79ace837, 0x2d835a9df0c6d851 }, // -70
+    { 0xdcdb1b2798182244, 0xf8e431456cf88e65 }, // -69
+    { 0x8a08f0f8bf0f156b, 0x1b8e9ecb641b58ff }, // -68
+    { 0xac8b2d36eed2dac5, 0xe272467e3d222f3f }, // -67
+    { 0xd7adf884aa879177, 0x5b0ed81dcc6abb0f }, // -66
+    { 0x86ccbb52ea94baea, 0x98e947129fc2b4e9 }, // -65
+    { 0xa87fea27a539e9a5, 0x3f2398d747b36224 }, // -64
+    { 0xd29fe4b18e88640e, 0x8eec7f0d19a03aad }, // -63
+    { 0x83a3eeeef9153e89, 0x1953cf68300424ac }, // -62
+    { 0xa48ceaaab75a8e2b, 0x5fa8c3423c052dd7 }, // -61
+    { 0xcdb02555653131b6, 0x3792f412cb06794d }, // -60
+    { 0x808e17555f3ebf11, 0xe2bbd88bbee40bd0 }, // -59
+    { 0xa0b19d2ab70e6ed6, 0x5b6aceaeae9d0ec4 }, // -58
+    { 0xc8de047564d20a8b, 0xf245825a5a445275 }, // -57
+    { 0xfb158592be068d2e, 0xeed6e2f0f0d56712 }, // -56
+    { 0x9ced737bb6c4183d, 0x55464dd69685606b }, // -55
+    { 0xc428d05aa4751e4c, 0xaa97e14c3c26b886 }, // -54
+    { 0xf53304714d9265df, 0xd53dd99f4b3066a8 }, // -53
+    { 0x993fe2c6d07b7fab, 0xe546a8038efe4029 }, // -52
+    { 0xbf8fdb78849a5f96, 0xde98520472bdd033 }, // -51
+    { 0xef73d256a5c0f77c, 0x963e66858f6d4440 }, // -50
+    { 0x95a8637627989aad, 0xdde7001379a44aa8 }, // -49
+    { 0xbb127c53b17ec159, 0x5560c018580d5d52 }, // -48
+    { 0xe9d71b689dde71af, 0xaab8f01e6e10b4a6 }, // -47
+    { 0x9226712162ab070d, 0xcab3961304ca70e8 }, // -46
+    { 0xb6b00d69bb55c8d1, 0x3d607b97c5fd0d22 }, // -45
+    { 0xe45c10c42a2b3b05, 0x8cb89a7db77c506a }, // -44
+    { 0x8eb98a7a9a5b04e3, 0x77f3608e92adb242 }, // -43
+    { 0xb267ed1940f1c61c, 0x55f038b237591ed3 }, // -42
+    { 0xdf01e85f912e37a3, 0x6b6c46dec52f6688 }, // -41
+    { 0x8b61313bbabce2c6, 0x2323ac4b3b3da015 }, // -40
+    { 0xae397d8aa96c1b77, 0xabec975e0a0d081a }, // -39
+    { 0xd9c7dced53c72255, 0x96e7bd358c904a21 }, // -38
+    { 0x881cea14545c7575, 0x7e50d64177da2e54 }, // -37
+    { 0xaa242499697392d2, 0xdde50bd1d5d0b9e9 }, // -36
+    { 0xd4ad2dbfc3d07787, 0x955e4ec64b44e864 }, // -35
+    { 0x84ec3c97da624ab4, 0xbd5af13bef0b113e }, // -34
+    { 0xa6274bbdd0fadd61, 0xecb1ad8aeacdd58e }, // -33
+    { 0xcfb11ead453994ba, 0x67de18eda5814af2 }, // -32
+    { 0x81ceb32c4b43fcf4, 0x80eacf948770ced7 }, // -31
+    { 0xa2425ff75e14fc31, 0xa1258379a94d028d }, // -30
+    { 0xcad2f7f5359a3b3e, 0x096ee45813a04330 }, // -29
+    { 0xfd87b5f28300ca0d, 0x8bca9d6e188853fc }, // -28
+    { 0x9e74d1b791e07e48, 0x775ea264cf55347e }, // -27
+    { 0xc612062576589dda, 0x95364afe032a819e }, // -26
+    { 0xf79687aed3eec551, 0x3a83ddbd83f52205 }, // -25
+    { 0x9abe14cd44753b52, 0xc4926a9672793543 }, // -24
+    { 0xc16d9a0095928a27, 0x75b7053c0f178294 }, // -23
+    { 0xf1c90080baf72cb1, 0x5324c68b12dd6339 }, // -22
+    { 0x971da05074da7bee, 0xd3f6fc16ebca5e04 }, // -21
+    { 0xbce5086492111aea, 0x88f4bb1ca6bcf585 }, // -20
+    { 0xec1e4a7db69561a5, 0x2b31e9e3d06c32e6 }, // -19
+    { 0x9392ee8e921d5d07, 0x3aff322e62439fd0 }, // -18
+    { 0xb877aa3236a4b449, 0x09befeb9fad487c3 }, // -17
+    { 0xe69594bec44de15b, 0x4c2ebe687989a9b4 }, // -16
+    { 0x901d7cf73ab0acd9, 0x0f9d37014bf60a11 }, // -15
+    { 0xb424dc35095cd80f, 0x538484c19ef38c95 }, // -14
+    { 0xe12e13424bb40e13, 0x2865a5f206b06fba }, // -13
+    { 0x8cbccc096f5088cb, 0xf93f87b7442e45d4 }, // -12
+    { 0xafebff0bcb24aafe, 0xf78f69a51539d749 }, // -11
+    { 0xdbe6fecebdedd5be, 0xb573440e5a884d1c }, // -10
+    { 0x89705f4136b4a597, 0x31680a88f8953031 }, // -9
+    { 0xabcc77118461cefc, 0xfdc20d2b36ba7c3e }, // -8
+    { 0xd6bf94d5e57a42bc, 0x3d32907604691b4d }, // -7
+    { 0x8637bd05af6c69b5, 0xa63f9a49c2c1b110 }, // -6
+    { 0xa7c5ac471b478423, 0x0fcf80dc33721d54 }, // -5
+    { 0xd1b71758e219652b, 0xd3c36113404ea4a9 }, // -4
+    { 0x83126e978d4fdf3b, 0x645a1cac083126ea }, // -3
+    { 0xa3d70a3d70a3d70a, 0x3d70a3d70a3d70a4 }, // -2
+    { 0xcccccccccccccccc, 0xcccccccccccccccd }, // -1
+    { 0x8000000000000000, 0x0000000000000000 }, // 0
+    { 0xa000000000000000, 0x0000000000000000 }, // 1
+    { 0xc800000000000000, 0x0000000000000000 }, // 2
+    { 0xfa00000000000000, 0x0000000000000000 }, // 3
+    { 0x9c40000000000000, 0x0000000000000000 }, // 4
+    { 0xc350000000000000, 0x0000000000000000 }, // 5
+    { 0xf424000000000000, 0x0000000000000000 }, // 6
+    { 0x9896800000000000, 0x0000000000000000 }, // 7
+    { 0xbebc200000000000, 0x0000000000000000 }, // 8
+    { 0xee6b280000000000, 0x0000000000000000 }, // 9
+    { 0x9502f90000000000, 0x0000000000000000 }, // 10
+    { 0xba43b74000000000, 0x0000000000000000 }, // 11
+    { 0xe8d4a51000000000, 0x0000000000000000 }, // 12
+    { 0x9184e72a00000000, 0x0000000000000000 }, // 13
+    { 0xb5e620f480000000, 0x0000000000000000 }, // 14
+    { 0xe35fa931a0000000, 0x0000000000000000 }, // 15
+    { 0x8e1bc9bf04000000, 0x0000000000000000 }, // 16
+    { 0xb1a2bc2ec5000000, 0x0000000000000000 }, // 17
+    { 0xde0b6b3a76400000, 0x0000000000000000 }, // 18
+    { 0x8ac7230489e80000, 0x0000000000000000 }, // 19
+    { 0xad78ebc5ac620000, 0x0000000000000000 }, // 20
+    { 0xd8d726b7177a8000, 0x0000000000000000 }, // 21
+    { 0x878678326eac9000, 0x0000000000000000 }, // 22
+    { 0xa968163f0a57b400, 0x0000000000000000 }, // 23
+    { 0xd3c21bcecceda100, 0x0000000000000000 }, // 24
+    { 0x84595161401484a0, 0x0000000000000000 }, // 25
+    { 0xa56fa5b99019a5c8, 0x0000000000000000 }, // 26
+    { 0xcecb8f27f4200f3a, 0x0000000000000000 }, // 27
+    { 0x813f3978f8940984, 0x4000000000000000 }, // 28
+    { 0xa18f07d736b90be5, 0x5000000000000000 }, // 29
+    { 0xc9f2c9cd04674ede, 0xa400000000000000 }, // 30
+    { 0xfc6f7c4045812296, 0x4d00000000000000 }, // 31
+    { 0x9dc5ada82b70b59d, 0xf020000000000000 }, // 32
+    { 0xc5371912364ce305, 0x6c28000000000000 }, // 33
+    { 0xf684df56c3e01bc6, 0xc732000000000000 }, // 34
+    { 0x9a130b963a6c115c, 0x3c7f400000000000 }, // 35
+    { 0xc097ce7bc90715b3, 0x4b9f100000000000 }, // 36
+    { 0xf0bdc21abb48db20, 0x1e86d40000000000 }, // 37
+    { 0x96769950b50d88f4, 0x1314448000000000 }, // 38
+    { 0xbc143fa4e250eb31, 0x17d955a000000000 }, // 39
+    { 0xeb194f8e1ae525fd, 0x5dcfab0800000000 }, // 40
+    { 0x92efd1b8d0cf37be, 0x5aa1cae500000000 }, // 41
+    { 0xb7abc627050305ad, 0xf14a3d9e40000000 }, // 42
+    { 0xe596b7b0c643c719, 0x6d9ccd05d0000000 }, // 43
+    { 0x8f7e32ce7bea5c6f, 0xe4820023a2000000 }, // 44
+    { 0xb35dbf821ae4f38b, 0xdda2802c8a800000 }, // 45
+    { 0xe0352f62a19e306e, 0xd50b2037ad200000 }, // 46
+    { 0x8c213d9da502de45, 0x4526f422cc340000 }, // 47
+    { 0xaf298d050e4395d6, 0x9670b12b7f410000 }, // 48
+    { 0xdaf3f04651d47b4c, 0x3c0cdd765f114000 }, // 49
+    { 0x88d8762bf324cd0f, 0xa5880a69fb6ac800 }, // 50
+    { 0xab0e93b6efee0053, 0x8eea0d047a457a00 }, // 51
+    { 0xd5d238a4abe98068, 0x72a4904598d6d880 }, // 52
+    { 0x85a36366eb71f041, 0x47a6da2b7f864750 }, // 53
+    { 0xa70c3c40a64e6c51, 0x999090b65f67d924 }, // 54
+    { 0xd0cf4b50cfe20765, 0xfff4b4e3f741cf6d }, // 55
+    { 0x82818f1281ed449f, 0xbff8f10e7a8921a4 }, // 56
+    { 0xa321f2d7226895c7, 0xaff72d52192b6a0d }, // 57
+    { 0xcbea6f8ceb02bb39, 0x9bf4f8a69f764490 }, // 58
+    { 0xfee50b7025c36a08, 0x02f236d04753d5b4 }, // 59
+    { 0x9f4f2726179a2245, 0x01d762422c946590 }, // 60
+    { 0xc722f0ef9d80aad6, 0x424d3ad2b7b97ef5 }, // 61
+    { 0xf8ebad2b84e0d58b, 0xd2e0898765a7deb2 }, // 62
+    { 0x9b934c3b330c8577, 0x63cc55f49f88eb2f }, // 63
+    { 0xc2781f49ffcfa6d5, 0x3cbf6b71c76b25fb }, // 64
+    { 0xf316271c7fc3908a, 0x8bef464e3945ef7a }, // 65
+    { 0x97edd871cfda3a56, 0x97758bf0e3cbb5ac }, // 66
+    { 0xbde94e8e43d0c8ec, 0x3d52eeed1cbea317 }, // 67
+    { 0xed63a231d4c4fb27, 0x4ca7aaa863ee4bdd }, // 68
+    { 0x945e455f24fb1cf8, 0x8fe8caa93e74ef6a }, // 69
+    { 0xb975d6b6ee39e436, 0xb3e2fd538e122b44 }, // 70
+    { 0xe7d34c64a9c85d44, 0x60dbbca87196b616 }, // 71
+    { 0x90e40fbeea1d3a4a, 0xbc8955e946fe31cd }, // 72
+    { 0xb51d13aea4a488dd, 0x6babab6398bdbe41 }, // 73
+    { 0xe264589a4dcdab14, 0xc696963c7eed2dd1 }, // 74
+    { 0x8d7eb76070a08aec, 0xfc1e1de5cf543ca2 }, // 75
+    { 0xb0de65388cc8ada8, 0x3b25a55f43294bcb }, // 76
+    { 0xdd15fe86affad912, 0x49ef0eb713f39ebe }, // 77
+    { 0x8a2dbf142dfcc7ab, 0x6e3569326c784337 }, // 78
+    { 0xacb92ed9397bf996, 0x49c2c37f07965404 }, // 79
+    { 0xd7e77a8f87daf7fb, 0xdc33745ec97be906 }, // 80
+    { 0x86f0ac99b4e8dafd, 0x69a028bb3ded71a3 }, // 81
+    { 0xa8acd7c0222311bc, 0xc40832ea0d68ce0c }, // 82
+    { 0xd2d80db02aabd62b, 0xf50a3fa490c30190 }, // 83
+    { 0x83c7088e1aab65db, 0x792667c6da79e0fa }, // 84
+    { 0xa4b8cab1a1563f52, 0x577001b891185938 }, // 85
+    { 0xcde6fd5e09abcf26, 0xed4c0226b55e6f86 }, // 86
+    { 0x80b05e5ac60b6178, 0x544f8158315b05b4 }, // 87
+    { 0xa0dc75f1778e39d6, 0x696361ae3db1c721 }, // 88
+    { 0xc913936dd571c84c, 0x03bc3a19cd1e38e9 }, // 89
+    { 0xfb5878494ace3a5f, 0x04ab48a04065c723 }, // 90
+    { 0x9d174b2dcec0e47b, 0x62eb0d64283f9c76 }, // 91
+    { 0xc45d1df942711d9a, 0x3ba5d0bd324f8394 }, // 92
+    { 0xf5746577930d6500, 0xca8f44ec7ee36479 }, // 93
+    { 0x9968bf6abbe85f20, 0x7e998b13cf4e1ecb }, // 94
+    { 0xbfc2ef456ae276e8, 0x9e3fedd8c321a67e }, // 95
+    { 0xefb3ab16c59b14a2, 0xc5cfe94ef3ea101e }, // 96
+};
+
+typedef struct binary_format {
+    int mbits;          // explicit mantissa bits
+    int minexp;         // smallest exponent
+    int infexp;         // biased exponent of infinity
+    int even_lo, even_hi; // decimal exponents where a tie can be exact
+} binary_format;
+
+static const binary_format binary64 = { 52, -1023, 0x7ff, -4, 23 };
+static const binary_format binary32 = { 23, -127, 0xff, -17, 10 };
+
+/*
+ * w 10^q as the bits of a positive binary number, false when it can't be
+ * sure of the rounding or the result is subnormal or infinite. The product
+ * with the truncated power of five is exact enough unless the bits below
+ * the mantissa are all ones, when the lower half of the power is added in.
+ */
+static bool eisel_lemire(uint64_t w, int q, const binary_format *f, uint64_t *bits) {
+    if ( w == 0 ) {
+        *bits = 0;
+        return true;
+    }
+    if ( q < POW5_MIN || q > POW5_MAX )
+        return false;
+
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+
+    const uint64_t *t = pow5[q - POW5_MIN];
+    unsigned __int128 product = (unsigned __int128)w * t[0];
+    uint64_t hi = product >> 64;
+    uint64_t lo = product;
+
+    uint64_t mask = UINT64_MAX >> (f->mbits + 3);
+    if ( (hi & mask) == mask ) {
+        uint64_t more = ((unsigned __int128)w * t[1]) >> 64;
+        lo += more;
+        if ( lo < more )
+            hi++;
+        if ( lo == UINT64_MAX && (q < -27 || q > 55) )
+            return false;
+    }
+
+    int upper = hi >> 63;
+    int shift = upper + 64 - f->mbits - 3;
+    uint64_t mantissa = hi >> shift;
+    int power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - lz - f->minexp;
+    if ( power2 <= 0 )
+        return false;
+
+    // an exact tie rounds to even instead of up
+    if ( lo <= 1 && q >= f->even_lo && q <= f->even_hi && (mantissa & 3) == 1 && mantissa << shift == hi )
+        mantissa &= ~(uint64_t)1;
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if ( mantissa >= (uint64_t)2 << f->mbits ) {
+        mantissa = (uint64_t)1 << f->mbits;
+        power2++;
+    }
+    if ( power2 >= f->infexp )
+        return false;
+
+    *bits = (mantissa & ~((uint64_t)1 << f->mbits)) | (uint64_t)power2 << f->mbits;
+    return true;
+}
+
+// a decimal as w 10^q, with any digits past the 19 that fit in w dropped
+typedef struct decimal {
+    uint64_t w;
+    int q;
+    bool negative;
+    bool truncated; // a nonzero digit was dropped
+} decimal;
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static char *scan_decimal(char *s, char *end, decimal *d) {
+    char *p = s;
+    d->w = 0;
+    d->q = 0;
+    d->negative = false;
+    d->truncated = false;
+
+    if ( p < end && (*p == '+' || *p == '-') )
+        d->negative = *p++ == '-';
+
+    int digits = 0;
+    bool any = false;
+    for (; p < end && is_digit(*p); p++) {
+        any = true;
+        if ( digits < 19 ) {
+            d->w = d->w*10 + (*p-'0');
+            digits += d->w != 0;
+        } else {
+            d->q++;
+            d->truncated |= *p != '0';
+        }
+    }
+    if ( p < end && *p == '.' ) {
+        for (p++; p < end && is_digit(*p); p++) {
+            any = true;
+            if ( digits < 19 ) {
+                d->w = d->w*10 + (*p-'0');
+                digits += d->w != 0;
+                d->q--;
+            } else {
+                d->truncated |= *p != '0';
+            }
+        }
+    }
+    if ( !any )
+        return s;
+
+    if ( p < end && (*p == 'e' || *p == 'E') ) {
+        char *e = p+1;
+        bool negative = false;
+        if ( e < end && (*e == '+' || *e == '-') )
+            negative = *e++ == '-';
+        if ( e < end && is_digit(*e) ) {
+            int x = 0;
+            for (; e < end && is_digit(*e); e++)
+                if ( x < 100000 )
+                    x = x*10 + (*e-'0');
+            d->q += negative ? -x : x;
+            p = e;
+        }
+    }
+    return p;
+}
+
+// with dropped digits the value is between w and w+1, so it is only certain
+// when both round the same way
+static bool decimal_bits(decimal *d, const binary_format *f, uint64_t *bits) {
+    uint64_t up;
+    if ( !eisel_lemire(d->w, d->q, f, bits) )
+        return false;
+    return !d->truncated || (eisel_lemire(d->w+1, d->q, f, &up) && up == *bits);
+}
+
+// the numbers the fast paths gave up on, through libc
+static double slow_strtod(char *s, char *end, bool single) {
+    char small[128];
+    char *copy = small;
+    size_t len = end-s;
+    if ( len >= sizeof(small) && (copy = malloc(len+1)) == NULL )
+        err(1, "Couldn't allocate space for a number");
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    double v = single ? strtof(copy, NULL) : strtod(copy, NULL);
+    if ( copy != small )
+        free(copy);
+    return v;
+}
+
+static const double exact_double[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const float exact_float[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+char *parse_double(char *s, char *end, double *out) {
+    decimal d;
+    char *p = scan_decimal(s, end, &d);
+    if ( p == s )
+        return s;
+
+    uint64_t bits;
+    if ( !d.truncated && d.w <= (uint64_t)1 << 53 && d.q >= -22 && d.q <= 22 ) {
+        // Clinger: both operands and the one rounding are exact
+        *out = d.q < 0 ? d.w / exact_double[-d.q] : d.w * exact_double[d.q];
+    } else if ( decimal_bits(&d, &binary64, &bits) ) {
+        memcpy(out, &bits, sizeof(double));
+    } else {
+        *out = slow_strtod(s, p, false);
+        return p;
+    }
+    if ( d.negative )
+        *out = -*out;
+    return p;
+}
+
+char *parse_float(char *s, char *end, float *out) {
+    decimal d;
+    char *p = scan_decimal(s, end, &d);
+    if ( p == s )
+        return s;
+
+    uint64_t bits;
+    if ( !d.truncated && d.w <= (uint64_t)1 << 24 && d.q >= -10 && d.q <= 10 ) {
+        *out = d.q < 0 ? (float)d.w / exact_float[-d.q] : (float)d.w * exact_float[d.q];
+    } else if ( decimal_bits(&d, &binary32, &bits) ) {
+        uint32_t b = bits;
+        memcpy(out, &b, sizeof(float));
+    } else {
+        *out = slow_strtod(s, p, true);
+        return p;
+    }
+    if ( d.negative )
+        *out = -*out;
+    return p;
+}
+
+void start_scan(scanner *sc, char *text, size_t len, bool commas, bool floats) {
+    sc->s = text;
+    sc->end = text+len;
+    sc->commas = commas;
+    sc->floats = floats;
+    sc->sr = 0;
+    sc->line = NULL;
+    sc->linelen = 0;
+}
+
+static inline bool is_record_end(scanner *sc, char c) {
+    return c == '\n' || c == '\r' || (c == ',' && sc->commas);
+}
+
+static inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+}
+
+// skips to the end of the record, picking up any SAMPLERATE= on the way
+static char *skip_record(scanner *sc, char *p) {
+    char *from = p;
+    while ( p < sc->end && !is_record_end(sc, *p) )
+        p++;
+
+    for (char *m = from; (m = memchr(m, 'S', p-m)) != NULL; m++) {
+        if ( p-m > 11 && memcmp(m, "SAMPLERATE=", 11) == 0 && is_digit(m[11]) ) {
+            int sr = 0;
+            for (char *n = m+11; n < p && is_digit(*n); n++)
+                sr = sr*10 + (*n-'0');
+            sc->sr = sr;
+        }
+    }
+    return p;
+}
+
+static char *scan_number(scanner *sc, char *p, double *v) {
+    if ( !sc->floats )
+        return parse_double(p, sc->end, v);
+    float f;
+    char *after = parse_float(p, sc->end, &f);
+    *v = f;
+    return after;
+}
+
+enum scan_item scan_next(scanner *sc, double *x, double *y) {
+    while ( sc->s < sc->end ) {
+        char *rec = sc->s;
+        char *p = rec;
+        while ( p < sc->end && is_blank(*p) )
+            p++;
+
+        if ( p < sc->end && (*p == '#' || *p == ';') ) {
+            char *e = skip_record(sc, p);
+            sc->line = rec;
+            sc->linelen = e-rec;
+            sc->s = e+1;
+            return scan_comment;
+        }
+
+        char *a = scan_number(sc, p, x);
+        if ( a != p ) {
+            char *b = a;
+            while ( b < sc->end && (is_blank(*b) || *b == '=') )
+                b++;
+            char *c = scan_number(sc, b, y);
+            if ( c != b ) {
+                sc->s = skip_record(sc, c) + 1;
+                return scan_pair;
+            }
+            p = b;
+        }
+
+        sc->s = skip_record(sc, p) + 1;
+    }
+    return scan_end;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __PARSE_H__
+#define __PARSE_H__
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * A whole text file in memory. Regular files are mapped read-only, anything
+ * else (pipes, a terminal) is read into memory. The text is not terminated.
+ */
+typedef struct textfile {
+    char *text;
+    size_t len;
+    size_t mapped; // bytes mapped, 0 if text was malloced
+} textfile;
+
+// "-" is stdin
+textfile *map_text(char *path);
+textfile *map_text_file(FILE *fh);
+void unmap_text(textfile *t);
+
+/*
+ * Decimal numbers as strtod and strtof read them, correctly rounded, but
+ * bounded by end instead of a terminator and without the locale. Only the
+ * plain decimal syntax is taken: an optional sign, digits with an optional
+ * point, and an optional exponent. Returns the end of the number, or s if
+ * there isn't one.
+ *
+ * Most numbers take Clinger's exact fast path or the Eisel-Lemire algorithm
+ * (see parse.c); the few they can't be sure of go to strtod.
+ */
+char *parse_double(char *s, char *end, double *out);
+char *parse_float(char *s, char *end, float *out);
+
+/*
+ * Reads pairs of numbers in one pass over the two text formats in use:
+ * frequency curves ("freq=power" records split by newlines or commas) and
+ * --analyze output ("freq mag phase ..." lines, where the first two columns
+ * are taken). A record's two numbers can be split by spaces, tabs or "=",
+ * and anything after them is ignored. Records starting with # or ; are
+ * comments, other records without two numbers are skipped, and a
+ * SAMPLERATE=n anywhere outside the numbers sets sr.
+ */
+typedef struct scanner {
+    char *s;
+    char *end;
+    bool commas; // commas end records too, as in frequency curves
+    bool floats; // round the numbers to float, as strtof would
+    int sr;      // the last SAMPLERATE= seen, 0 for none
+    char *line;  // the last comment, without its line end
+    size_t linelen;
+} scanner;
+
+enum scan_item {
+    scan_end,
+    scan_pair,   // the next two numbers
+    scan_comment // line and linelen are set
+};
+
+void start_scan(scanner *sc, char *text, size_t len, bool commas, bool floats);
+enum scan_item scan_next(scanner *sc, double *x, double *y);
+
+#endif
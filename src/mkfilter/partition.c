@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+
+#include "partition.h"
+#include "fir.h"
+#include "jobs.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+partitions *partition_filter(audiobuf *filter, int block, enum partition_scheme scheme) {
+    partitions *p;
+    if ( (p = malloc(sizeof(partitions))) == NULL )
+        err(1, "Couldn't allocate space for partitions");
+
+    p->taps = fir_length(filter);
+    p->block = block;
+    p->sr = filter->sr;
+
+    // lay out the partitions first
+    int malloced = 16;
+    if ( (p->start = malloc(sizeof(int)*malloced)) == NULL || (p->size = malloc(sizeof(int)*malloced)) == NULL )
+        err(1, "Couldn't allocate space for partitions");
+    p->ct = 0;
+    for (int at = 0, size = block; at < p->taps; at += size) {
+        if ( scheme == partition_nonuniform && p->ct >= 2 && p->ct % 2 == 0 )
+            size *= 2;
+
+        if ( p->ct == malloced ) {
+            malloced *= 2;
+            if ( (p->start = realloc(p->start, sizeof(int)*malloced)) == NULL || (p->size = realloc(p->size, sizeof(int)*malloced)) == NULL )
+                err(1, "Couldn't allocate space for partitions");
+        }
+        p->start[p->ct] = at;
+        p->size[p->ct] = size;
+        p->ct++;
+    }
+
+    if ( (p->spectra = malloc(sizeof(fft_cpx*)*p->ct)) == NULL )
+        err(1, "Couldn't allocate space for partitions");
+
+    PARALLEL_FOR
+    for (int i = 0; i < p->ct; i++) {
+        int size = p->size[i];
+        float *padded;
+        if ( (padded = calloc(size*2, sizeof(float))) == NULL )
+            err(1, "Couldn't allocate %zu bytes for partition %d", sizeof(float)*size*2, i);
+        if ( (p->spectra[i] = malloc(sizeof(fft_cpx)*(size+1))) == NULL )
+            err(1, "Couldn't allocate %zu bytes for partition %d", sizeof(fft_cpx)*(size+1), i);
+
+        int n = p->taps - p->start[i] < size ? p->taps - p->start[i] : size;
+        memcpy(padded, filter->td + p->start[i], sizeof(float)*n);
+
+        fftr(size*2, padded, p->spectra[i]);
+        free(padded);
+    }
+
+    return p;
+}
+
+void free_partitions(partitions *p) {
+    for (int i = 0; i < p->ct; i++)
+        free(p->spectra[i]);
+    free(p->spectra);
+    free(p->start);
+    free(p->size);
+    free(p);
+}
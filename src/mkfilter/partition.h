@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+
+#ifndef __PARTITION_H__
+#define __PARTITION_H__
+
+#include "audiobuf.h"
+
+enum partition_scheme {
+    partition_uniform,   // every partition is one block long
+    partition_nonuniform // two of each size, doubling: B, B, 2B, 2B, 4B, 4B, ...
+};
+
+/*
+ * A filter split into partitions for a partitioned convolution runtime.
+ * Partition i covers taps start[i] to start[i]+size[i]-1, zero padded to
+ * 2*size[i] and transformed, giving size[i]+1 bins. Every partition starts
+ * at least its own size into the filter, so a nonuniform runtime has the
+ * input it needs in time.
+ */
+typedef struct partitions {
+    int ct;
+    int block;
+    int taps;
+    int sr;
+    int *start;
+    int *size;
+    fft_cpx **spectra;
+} partitions;
+
+partitions *partition_filter(audiobuf *filter, int block, enum partition_scheme scheme);
+void free_partitions(partitions *p);
+
+#endif
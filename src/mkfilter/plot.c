@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "plot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <err.h>
+
+// the colors of analyzefilter.pl's gnuplot terminal
+#define COLOR_BACKGROUND 0x040410
+#define COLOR_TEXT 0x9999cc
+#define COLOR_GRID 0x444477
+
+static const uint32_t trace_colors[] = { 0xff0000, 0x00ff00, 0x0000ff, 0xff00ff, 0x00ffff, 0xffa000 };
+#define TRACE_COLORS (sizeof(trace_colors)/sizeof(trace_colors[0]))
+
+#define FREQ_MIN 10
+#define POWER_MIN 0.000001
+#define POWER_MAX 100
+
+// plot area margins in pixels
+#define MARGIN_LEFT 48
+#define MARGIN_RIGHT 12
+#define MARGIN_TOP 8
+#define MARGIN_BOTTOM 16
+
+// text cells of the bitmap font
+#define CHAR_WIDTH 6
+#define CHAR_HEIGHT 9
+
+struct tick {
+    double value;
+    char *label;
+};
+
+static const struct tick freq_ticks[] = {
+    { 10, "10Hz" }, { 20, "20Hz" }, { 30, "" }, { 40, "" }, { 50, "" },
+    { 60, "60Hz" }, { 70, "" }, { 80, "" }, { 90, "" },
+    { 100, "100Hz" }, { 200, "" }, { 300, "" }, { 400, "" },
+    { 500, "500Hz" }, { 600, "" }, { 700, "" }, { 800, "" }, { 900, "" },
+    { 1000, "1000Hz" }, { 2000, "" }, { 3000, "" }, { 4000, "" },
+    { 5000, "5000Hz" }, { 6000, "" }, { 7000, "" }, { 8000, "" }, { 9000, "" },
+    { 10000, "10000Hz" }, { 15000, "" }, { 20000, "20000Hz" }
+};
+
+static const struct tick power_ticks[] = {
+    { 100, "40dB" }, { 10, "20dB" }, { 1, "0dB" }, { 0.1, "-20dB" },
+    { 0.01, "-40dB" }, { 0.001, "-60dB" }, { 0.0001, "-80dB" },
+    { 0.00001, "-100dB" }, { 0.000001, "-120dB" }
+};
+
+// 5x8 glyphs for ' ' to '~', one byte per column, least significant bit on top
+static const unsigned char font[95][5] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x00, 0x00, 0x5f, 0x00, 0x00 }, // '!'
+    { 0x00, 0x07, 0x00, 0x07, 0x00 }, // '"'
+    { 0x14, 0x7f, 0x14, 0x7f, 0x14 }, // '#'
+    { 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, // '$'
+    { 0x23, 0x13, 0x08, 0x64, 0x62 }, // '%'
+    { 0x36, 0x49, 0x56, 0x20, 0x50 }, // '&'
+    { 0x00, 0x08, 0x07, 0x03, 0x00 }, // '\''
+    { 0x00, 0x1c, 0x22, 0x41, 0x00 }, // '('
+    { 0x00, 0x41, 0x22, 0x1c, 0x00 }, // ')'
+    { 0x2a, 0x1c, 0x7f, 0x1c, 0x2a }, // '*'
+    { 0x08, 0x08, 0x3e, 0x08, 0x08 }, // '+'
+    { 0x00, 0x80, 0x70, 0x30, 0x00 }, // ','
+    { 0x08, 0x08, 0x08, 0x08, 0x08 }, // '-'
+    { 0x00, 0x00, 0x60, 0x60, 0x00 }, // '.'
+    { 0x20, 0x10, 0x08, 0x04, 0x02 }, // '/'
+    { 0x3e, 0x51, 0x49, 0x45, 0x3e }, // '0'
+    { 0x00, 0x42, 0x7f, 0x40, 0x00 }, // '1'
+    { 0x72, 0x49, 0x49, 0x49, 0x46 }, // '2'
+    { 0x21, 0x41, 0x49, 0x4d, 0x33 }, // '3'
+    { 0x18, 0x14, 0x12, 0x7f, 0x10 }, // '4'
+    { 0x27, 0x45, 0x45, 0x45, 0x39 }, // '5'
+    { 0x3c, 0x4a, 0x49, 0x49, 0x31 }, // '6'
+    { 0x41, 0x21, 0x11, 0x09, 0x07 }, // '7'
+    { 0x36, 0x49, 0x49, 0x49, 0x36 }, // '8'
+    { 0x46, 0x49, 0x49, 0x29, 0x1e }, // '9'
+    { 0x00, 0x00, 0x14, 0x00, 0x00 }, // ':'
+    { 0x00, 0x40, 0x34, 0x00, 0x00 }, // ';'
+    { 0x00, 0x08, 0x14, 0x22, 0x41 }, // '<'
+    { 0x14, 0x14, 0x14, 0x14, 0x14 }, // '='
+    { 0x00, 0x41, 0x22, 0x14, 0x08 }, // '>'
+    { 0x02, 0x01, 0x59, 0x09, 0x06 }, // '?'
+    { 0x3e, 0x41, 0x5d, 0x59, 0x4e }, // '@'
+    { 0x7c, 0x12, 0x11, 0x12, 0x7c }, // 'A'
+    { 0x7f, 0x49, 0x49, 0x49, 0x36 }, // 'B'
+    { 0x3e, 0x41, 0x41, 0x41, 0x22 }, // 'C'
+    { 0x7f, 0x41, 0x41, 0x41, 0x3e }, // 'D'
+    { 0x7f, 0x49, 0x49, 0x49, 0x41 }, // 'E'
+    { 0x7f, 0x09, 0x09, 0x09, 0x01 }, // 'F'
+    { 0x3e, 0x41, 0x41, 0x51, 0x73 }, // 'G'
+    { 0x7f, 0x08, 0x08, 0x08, 0x7f }, // 'H'
+    { 0x00, 0x41, 0x7f, 0x41, 0x00 }, // 'I'
+    { 0x20, 0x40, 0x41, 0x3f, 0x01 }, // 'J'
+    { 0x7f, 0x08, 0x14, 0x22, 0x41 }, // 'K'
+    { 0x7f, 0x40, 0x40, 0x40, 0x40 }, // 'L'
+    { 0x7f, 0x02, 0x1c, 0x02, 0x7f }, // 'M'
+    { 0x7f, 0x04, 0x08, 0x10, 0x7f }, // 'N'
+    { 0x3e, 0x41, 0x41, 0x41, 0x3e }, // 'O'
+    { 0x7f, 0x09, 0x09, 0x09, 0x06 }, // 'P'
+    { 0x3e, 0x41, 0x51, 0x21, 0x5e }, // 'Q'
+    { 0x7f, 0x09, 0x19, 0x29, 0x46 }, // 'R'
+    { 0x26, 0x49, 0x49, 0x49, 0x32 }, // 'S'
+    { 0x03, 0x01, 0x7f, 0x01, 0x03 }, // 'T'
+    { 0x3f, 0x40, 0x40, 0x40, 0x3f }, // 'U'
+    { 0x1f, 0x20, 0x40, 0x20, 0x1f }, // 'V'
+    { 0x3f, 0x40, 0x38, 0x40, 0x3f }, // 'W'
+    { 0x63, 0x14, 0x08, 0x14, 0x63 }, // 'X'
+    { 0x03, 0x04, 0x78, 0x04, 0x03 }, // 'Y'
+    { 0x61, 0x59, 0x49, 0x4d, 0x43 }, // 'Z'
+    { 0x00, 0x7f, 0x41, 0x41, 0x41 }, // '['
+    { 0x02, 0x04, 0x08, 0x10, 0x20 }, // backslash
+    { 0x00, 0x41, 0x41, 0x41, 0x7f }, // ']'
+    { 0x04, 0x02, 0x01, 0x02, 0x04 }, // '^'
+    { 0x40, 0x40, 0x40, 0x40, 0x40 }, // '_'
+    { 0x00, 0x03, 0x07, 0x08, 0x00 }, // '`'
+    { 0x20, 0x54, 0x54, 0x78, 0x40 }, // 'a'
+    { 0x7f, 0x28, 0x44, 0x44, 0x38 }, // 'b'
+    { 0x38, 0x44, 0x44, 0x44, 0x28 }, // 'c'
+    { 0x38, 0x44, 0x44, 0x28, 0x7f }, // 'd'
+    { 0x38, 0x54, 0x54, 0x54, 0x18 }, // 'e'
+    { 0x00, 0x08, 0x7e, 0x09, 0x02 }, // 'f'
+    { 0x18, 0xa4, 0xa4, 0x9c, 0x78 }, // 'g'
+    { 0x7f, 0x08, 0x04, 0x04, 0x78 }, // 'h'
+    { 0x00, 0x44, 0x7d, 0x40, 0x00 }, // 'i'
+    { 0x20, 0x40, 0x40, 0x3d, 0x00 }, // 'j'
+    { 0x7f, 0x10, 0x28, 0x44, 0x00 }, // 'k'
+    { 0x00, 0x41, 0x7f, 0x40, 0x00 }, // 'l'
+    { 0x7c, 0x04, 0x78, 0x04, 0x78 }, // 'm'
+    { 0x7c, 0x08, 0x04, 0x04, 0x78 }, // 'n'
+    { 0x38, 0x44, 0x44, 0x44, 0x38 }, // 'o'
+    { 0xfc, 0x18, 0x24, 0x24, 0x18 }, // 'p'
+    { 0x18, 0x24, 0x24, 0x18, 0xfc }, // 'q'
+    { 0x7c, 0x08, 0x04, 0x04, 0x08 }, // 'r'
+    { 0x48, 0x54, 0x54, 0x54, 0x24 }, // 's'
+    { 0x04, 0x04, 0x3f, 0x44, 0x24 }, // 't'
+    { 0x3c, 0x40, 0x40, 0x20, 0x7c }, // 'u'
+    { 0x1c, 0x20, 0x40, 0x20, 0x1c }, // 'v'
+    { 0x3c, 0x40, 0x30, 0x40, 0x3c }, // 'w'
+    { 0x44, 0x28, 0x10, 0x28, 0x44 }, // 'x'
+    { 0x4c, 0x90, 0x90, 0x90, 0x7c }, // 'y'
+    { 0x44, 0x64, 0x54, 0x4c, 0x44 }, // 'z'
+    { 0x00, 0x08, 0x36, 0x41, 0x00 }, // '{'
+    { 0x00, 0x00, 0x77, 0x00, 0x00 }, // '|'
+    { 0x00, 0x41, 0x36, 0x08, 0x00 }, // '}'
+    { 0x02, 0x01, 0x02, 0x04, 0x02 }, // '~'
+};
+
+/*
+ * Drawing goes either into an RGB raster (for PNG) or straight out as SVG
+ * elements. The plot area is x0..x1 by y0..y1 in pixels.
+ */
+typedef struct plot {
+    int width, height;
+    unsigned char *rgb; // NULL when writing SVG
+    FILE *svg;
+    int x0, x1, y0, y1;
+} plot;
+
+static void set_pixel(plot *p, int x, int y, uint32_t color) {
+    if ( x < 0 || y < 0 || x >= p->width || y >= p->height )
+        return;
+    unsigned char *px = p->rgb + ((size_t)y*p->width + x)*3;
+    px[0] = color >> 16;
+    px[1] = color >> 8;
+    px[2] = color;
+}
+
+// horizontal and vertical lines only
+static void draw_line(plot *p, int xa, int ya, int xb, int yb, uint32_t color) {
+    if ( p->svg ) {
+        fprintf(p->svg, "<line x1=\"%d.5\" y1=\"%d.5\" x2=\"%d.5\" y2=\"%d.5\" stroke=\"#%06x\"/>\n",
+                xa, ya, xb, yb, (unsigned)color);
+        return;
+    }
+
+    for (int x = xa < xb ? xa : xb; x <= (xa < xb ? xb : xa); x++)
+        for (int y = ya < yb ? ya : yb; y <= (ya < yb ? yb : ya); y++)
+            set_pixel(p, x, y, color);
+}
+
+// align is -1 for left, 0 for centered and 1 for right aligned at x; y is
+// the top of the text
+static void draw_text(plot *p, int x, int y, const char *str, uint32_t color, int align) {
+    int len = strlen(str);
+    int left = x - (align+1)*len*CHAR_WIDTH/2;
+
+    if ( p->svg ) {
+        fprintf(p->svg, "<text x=\"%d\" y=\"%d\" fill=\"#%06x\" font-family=\"monospace\" font-size=\"9\">",
+                left, y+CHAR_HEIGHT-2, (unsigned)color);
+        for (const char *c = str; *c; c++) {
+            if ( *c == '<' ) fputs("&lt;", p->svg);
+            else if ( *c == '>' ) fputs("&gt;", p->svg);
+            else if ( *c == '&' ) fputs("&amp;", p->svg);
+            else fputc(*c, p->svg);
+        }
+        fprintf(p->svg, "</text>\n");
+        return;
+    }
+
+    for (int i = 0; i < len; i++) {
+        int ch = (unsigned char)str[i];
+        if ( ch < 32 || ch > 126 )
+            ch = '?';
+        for (int col = 0; col < 5; col++)
+            for (int row = 0; row < 8; row++)
+                if ( font[ch-32][col] & (1 << row) )
+                    set_pixel(p, left + i*CHAR_WIDTH + col, y + row, color);
+    }
+}
+
+static int x_of(plot *p, double freq, double fmin, double fmax) {
+    return p->x0 + lround(log(freq/fmin) / log(fmax/fmin) * (p->x1 - p->x0));
+}
+
+static int y_of(plot *p, double v, double vmin, double vmax) {
+    return p->y1 - lround((v - vmin) / (vmax - vmin) * (p->y1 - p->y0));
+}
+
+/*
+ * Reduces one filter's bins to a min/max per pixel column of the plot area.
+ * values are in plot units already (log magnitude, phase). Columns without a
+ * bin of their own, at the bottom of the log axis, interpolate between the
+ * neighbouring bins. have[c] is false for columns with nothing to draw.
+ */
+static void envelope(float *values, int bins, double from, double binwidth, double fmin, double fmax, int cols, double *lo, double *hi, bool *have) {
+    for (int c = 0; c < cols; c++) {
+        lo[c] = INFINITY;
+        hi[c] = -INFINITY;
+        have[c] = false;
+    }
+
+    double scale = cols / log(fmax/fmin);
+
+    for (int i = 0; i < bins; i++) {
+        if ( from + i*binwidth <= 0 )
+            continue;
+        int c = floor(log((from + i*binwidth)/fmin) * scale);
+        if ( c < 0 || c >= cols || isnan(values[i]) )
+            continue;
+        if ( values[i] < lo[c] ) lo[c] = values[i];
+        if ( values[i] > hi[c] ) hi[c] = values[i];
+        have[c] = true;
+    }
+
+    for (int c = 0; c < cols; c++) {
+        if ( have[c] )
+            continue;
+        double pos = (fmin*exp((c+0.5)/scale) - from) / binwidth;
+        int i = floor(pos);
+        if ( i < 0 || from + i*binwidth <= 0 || i+1 >= bins || isnan(values[i]) || isnan(values[i+1]) )
+            continue;
+        lo[c] = hi[c] = values[i] + (pos-i)*(values[i+1]-values[i]);
+        have[c] = true;
+    }
+}
+
+static void draw_trace(plot *p, double *lo, double *hi, bool *have, double vmin, double vmax, uint32_t color) {
+    int cols = p->x1 - p->x0;
+    bool inpath = false;
+    double lastlo = 0, lasthi = 0;
+    int lasty = 0;
+
+    if ( p->svg )
+        fprintf(p->svg, "<path fill=\"none\" stroke=\"#%06x\" d=\"", (unsigned)color);
+
+    for (int c = 0; c < cols; c++) {
+        if ( !have[c] ) {
+            inpath = false;
+            continue;
+        }
+
+        // reach over to the previous column so the trace stays connected
+        double a = lo[c];
+        double b = hi[c];
+        if ( inpath ) {
+            if ( lasthi < a ) a = lasthi;
+            if ( lastlo > b ) b = lastlo;
+        }
+        lastlo = lo[c];
+        lasthi = hi[c];
+
+        int ya = y_of(p, a, vmin, vmax);
+        int yb = y_of(p, b, vmin, vmax);
+        if ( ya > p->y1 ) ya = p->y1;
+        if ( yb < p->y0 ) yb = p->y0;
+
+        if ( p->svg ) {
+            // visit the end nearest the previous point first
+            int first = inpath && abs(lasty-yb) < abs(lasty-ya) ? yb : ya;
+            int second = first == ya ? yb : ya;
+            if ( ya < yb ) {
+                // entirely outside the plot area
+                inpath = false;
+                continue;
+            }
+            fprintf(p->svg, "%c%d %d", inpath ? 'L' : 'M', p->x0+c, first);
+            if ( second != first )
+                fprintf(p->svg, "L%d %d", p->x0+c, second);
+            lasty = second;
+        } else if ( ya >= yb ) {
+            draw_line(p, p->x0+c, yb, p->x0+c, ya, color);
+        }
+        inpath = true;
+    }
+
+    if ( p->svg )
+        fprintf(p->svg, "\"/>\n");
+}
+
+// a 1, 2 or 5 times power of ten step giving around 8 ticks over range
+static double nice_step(double range) {
+    double raw = range / 8;
+    double mag = pow(10, floor(log10(raw)));
+    if ( raw <= mag ) return mag;
+    if ( raw <= 2*mag ) return 2*mag;
+    if ( raw <= 5*mag ) return 5*mag;
+    return 10*mag;
+}
+
+static uint32_t crc_table[256];
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char *buf, size_t len) {
+    if ( crc_table[1] == 0 ) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            crc_table[n] = c;
+        }
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+        crc = crc_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_be32(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void write_chunk(FILE *fh, const char *type, const unsigned char *data, size_t len, char *path) {
+    unsigned char head[8];
+    put_be32(head, len);
+    memcpy(head+4, type, 4);
+
+    unsigned char tail[4];
+    put_be32(tail, crc32_update(crc32_update(0, head+4, 4), data, len));
+
+    if ( fwrite(head, 1, 8, fh) != 8 || fwrite(data, 1, len, fh) != len || fwrite(tail, 1, 4, fh) != 4 )
+        err(1, "Couldn't write to %s", path);
+}
+
+/*
+ * PNG with the image data in a zlib stream of stored (uncompressed) deflate
+ * blocks, which needs nothing beyond the checksums.
+ */
+static void write_png(plot *p, char *path) {
+    size_t rowlen = (size_t)p->width*3 + 1; // filter type byte, then RGB
+    size_t rawlen = rowlen*p->height;
+    size_t blocks = (rawlen + 65534) / 65535;
+    size_t zlen = 2 + rawlen + blocks*5 + 4;
+
+    unsigned char *z;
+    if ( (z = malloc(zlen)) == NULL )
+        err(1, "Couldn't allocate %zu bytes for png data", zlen);
+
+    unsigned char *out = z;
+    *out++ = 0x78; // deflate, 32k window
+    *out++ = 0x01; // no preset dictionary, header checksum
+
+    uint32_t s1 = 1, s2 = 0; // adler32
+    size_t left = rawlen;
+    size_t at = 0;
+    while ( left > 0 ) {
+        size_t n = left < 65535 ? left : 65535;
+        *out++ = n == left; // BFINAL on the last block, BTYPE 00 (stored)
+        *out++ = n & 0xff;
+        *out++ = n >> 8;
+        *out++ = ~n & 0xff;
+        *out++ = (~n >> 8) & 0xff;
+
+        for (size_t i = 0; i < n; i++, at++) {
+            size_t row = at / rowlen;
+            size_t col = at % rowlen;
+            unsigned char byte = col == 0 ? 0 : p->rgb[row*p->width*3 + col-1];
+            *out++ = byte;
+            s1 = (s1 + byte) % 65521;
+            s2 = (s2 + s1) % 65521;
+        }
+        left -= n;
+    }
+    put_be32(out, (s2 << 16) | s1);
+
+    unsigned char ihdr[13];
+    put_be32(ihdr, p->width);
+    put_be32(ihdr+4, p->height);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // truecolor
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // no interlace
+
+    FILE *fh;
+    if ( (fh = fopen(path, "wb")) == NULL )
+        err(1, "Couldn't open %s for writing", path);
+    if ( fwrite("\x89PNG\r\n\x1a\n", 1, 8, fh) != 8 )
+        err(1, "Couldn't write to %s", path);
+    write_chunk(fh, "IHDR", ihdr, 13, path);
+    write_chunk(fh, "IDAT", z, zlen, path);
+    write_chunk(fh, "IEND", NULL, 0, path);
+    if ( fclose(fh) )
+        err(1, "Couldn't close %s", path);
+
+    free(z);
+}
+
+void plot_analysis(analysis *a, char **names, char *path, enum plot_mode mode, int width, int height) {
+    if ( width < MARGIN_LEFT+MARGIN_RIGHT+16 || height < MARGIN_TOP+MARGIN_BOTTOM+16 )
+        errx(1, "Plot size %dx%d is too small", width, height);
+
+    plot p;
+    p.width = width;
+    p.height = height;
+    p.x0 = MARGIN_LEFT;
+    p.x1 = width - MARGIN_RIGHT;
+    p.y0 = MARGIN_TOP;
+    p.y1 = height - MARGIN_BOTTOM;
+    p.rgb = NULL;
+    p.svg = NULL;
+
+    size_t pathlen = strlen(path);
+    bool svg = pathlen >= 4 && strcmp(path+pathlen-4, ".svg") == 0;
+
+    if ( svg ) {
+        if ( (p.svg = fopen(path, "w")) == NULL )
+            err(1, "Couldn't open %s for writing", path);
+        fprintf(p.svg, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+                width, height, width, height);
+        fprintf(p.svg, "<rect width=\"100%%\" height=\"100%%\" fill=\"#%06x\"/>\n", COLOR_BACKGROUND);
+    } else {
+        if ( (p.rgb = malloc((size_t)width*height*3)) == NULL )
+            err(1, "Couldn't allocate %zu bytes for plot", (size_t)width*height*3);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                set_pixel(&p, x, y, COLOR_BACKGROUND);
+    }
+
+    int cols = p.x1 - p.x0;
+    double fmin = FREQ_MIN;
+    double fmax = a->sr / 2.0;
+    if ( a->zoom ) {
+        // just the analyzed band
+        fmin = a->from > 0 ? a->from : a->step;
+        fmax = a->from + (a->bins-1)*a->step;
+    }
+    if ( fmax <= fmin )
+        errx(1, "Sample rate %d is too low to plot", a->sr);
+
+    double *lo, *hi;
+    bool *have;
+    if ( (lo = malloc(sizeof(double)*cols*a->ct)) == NULL || (hi = malloc(sizeof(double)*cols*a->ct)) == NULL ||
+         (have = malloc(sizeof(bool)*cols*a->ct)) == NULL )
+        err(1, "Couldn't allocate space for plot envelopes");
+
+    float *values = mode == plot_magnitude ? a->mag : a->other;
+    float *logs = NULL;
+    if ( mode == plot_magnitude ) {
+        // the envelope is taken on the log scale it is drawn on
+        if ( (logs = malloc(sizeof(float)*a->bins)) == NULL )
+            err(1, "Couldn't allocate space for log magnitudes");
+    }
+
+    for (int f = 0; f < a->ct; f++) {
+        float *v = values + (size_t)f*a->bins;
+        if ( logs ) {
+            for (int i = 0; i < a->bins; i++)
+                logs[i] = v[i] > 0 ? log10f(v[i]) : log10(POWER_MIN)-1;
+            v = logs;
+        }
+        envelope(v, a->bins, a->from, a->step, fmin, fmax, cols, lo+(size_t)f*cols, hi+(size_t)f*cols, have+(size_t)f*cols);
+    }
+    free(logs);
+
+    // vertical range and ticks
+    double vmin, vmax, step = 0;
+    if ( mode == plot_magnitude ) {
+        vmin = log10(POWER_MIN);
+        vmax = log10(POWER_MAX);
+    } else {
+        vmin = INFINITY;
+        vmax = -INFINITY;
+        for (size_t i = 0; i < (size_t)cols*a->ct; i++) {
+            if ( !have[i] )
+                continue;
+            if ( lo[i] < vmin ) vmin = lo[i];
+            if ( hi[i] > vmax ) vmax = hi[i];
+        }
+        if ( !(vmin < vmax) ) {
+            double mid = isfinite(vmin) ? vmin : 0;
+            vmin = mid-1;
+            vmax = mid+1;
+        }
+        step = nice_step(vmax-vmin);
+        vmin = floor(vmin/step)*step;
+        vmax = ceil(vmax/step)*step;
+    }
+
+    // grid and labels
+    for (size_t i = 0; i < sizeof(freq_ticks)/sizeof(freq_ticks[0]); i++) {
+        if ( freq_ticks[i].value < fmin || freq_ticks[i].value > fmax )
+            continue;
+        int x = x_of(&p, freq_ticks[i].value, fmin, fmax);
+        draw_line(&p, x, p.y0, x, p.y1, COLOR_GRID);
+        draw_text(&p, x, p.y1+4, freq_ticks[i].label, COLOR_TEXT, 0);
+    }
+
+    // a zoomed band may hold no labelled tick, so its ends are labelled
+    if ( a->zoom ) {
+        char label[32];
+        snprintf(label, sizeof(label), "%gHz", fmin);
+        draw_text(&p, p.x0, p.y1+4, label, COLOR_TEXT, -1);
+        snprintf(label, sizeof(label), "%gHz", fmax);
+        draw_text(&p, p.x1, p.y1+4, label, COLOR_TEXT, 1);
+    }
+
+    if ( mode == plot_magnitude ) {
+        for (size_t i = 0; i < sizeof(power_ticks)/sizeof(power_ticks[0]); i++) {
+            int y = y_of(&p, log10(power_ticks[i].value), vmin, vmax);
+            draw_line(&p, p.x0, y, p.x1, y, COLOR_GRID);
+            draw_text(&p, p.x0-4, y-CHAR_HEIGHT/2, power_ticks[i].label, COLOR_TEXT, 1);
+        }
+    } else {
+        for (double v = vmin; v <= vmax + step/2; v += step) {
+            char label[32];
+            snprintf(label, sizeof(label), "%g", fabs(v) < step/2 ? 0 : v);
+            int y = y_of(&p, v, vmin, vmax);
+            draw_line(&p, p.x0, y, p.x1, y, COLOR_GRID);
+            draw_text(&p, p.x0-4, y-CHAR_HEIGHT/2, label, COLOR_TEXT, 1);
+        }
+    }
+
+    for (int f = 0; f < a->ct; f++)
+        draw_trace(&p, lo+(size_t)f*cols, hi+(size_t)f*cols, have+(size_t)f*cols, vmin, vmax,
+                   trace_colors[f % TRACE_COLORS]);
+
+    // border, then the key in the top right corner as far as it fits
+    draw_line(&p, p.x0, p.y0, p.x1, p.y0, COLOR_TEXT);
+    draw_line(&p, p.x0, p.y1, p.x1, p.y1, COLOR_TEXT);
+    draw_line(&p, p.x0, p.y0, p.x0, p.y1, COLOR_TEXT);
+    draw_line(&p, p.x1, p.y0, p.x1, p.y1, COLOR_TEXT);
+
+    if ( names ) {
+        for (int f = 0; f < a->ct; f++) {
+            int y = p.y0 + 4 + f*CHAR_HEIGHT;
+            if ( y + CHAR_HEIGHT > p.y1 )
+                break;
+            draw_text(&p, p.x1-30, y, names[f], COLOR_TEXT, 1);
+            draw_line(&p, p.x1-26, y+CHAR_HEIGHT/2-1, p.x1-6, y+CHAR_HEIGHT/2-1, trace_colors[f % TRACE_COLORS]);
+        }
+    }
+
+    if ( svg ) {
+        fprintf(p.svg, "</svg>\n");
+        if ( fclose(p.svg) )
+            err(1, "Couldn't close %s", path);
+    } else {
+        write_png(&p, path);
+        free(p.rgb);
+    }
+
+    free(lo);
+    free(hi);
+    free(have);
+}
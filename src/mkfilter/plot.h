@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __PLOT_H__
+#define __PLOT_H__
+
+#include "analyze.h"
+
+enum plot_mode {
+    plot_magnitude,
+    plot_phase,      // needs an analyze_response analysis
+    plot_group_delay // needs an analyze_group_delay analysis
+};
+
+#define PLOT_WIDTH 800
+#define PLOT_HEIGHT 400
+
+/*
+ * Graphs every filter in the analysis on a log frequency axis from 10Hz to
+ * nyquist (or across a zoomed analysis' band), with the ticks and ranges of
+ * analyzefilter.pl. Each pixel column
+ * is drawn as the min/max envelope of the bins that fall in it, so the cost
+ * of drawing follows the width of the image, not the number of bins.
+ *
+ * paths ending in .svg get SVG, anything else a PNG.
+ */
+void plot_analysis(analysis *a, char **names, char *path, enum plot_mode mode, int width, int height);
+
+#endif
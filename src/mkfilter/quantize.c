@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "quantize.h"
+#include "fir.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <err.h>
+
+#define PI 3.1415926535897932384626433832795028841971693993
+
+int quantize_bits(enum quantize_mode mode) {
+    switch ( mode ) {
+        case quantize_q15:
+            return 16;
+        case quantize_q31:
+            return 32;
+        default:
+            errx(1, "not reached");
+    }
+}
+
+int32_t to_fixed(double x, int bits) {
+    double max = ldexp(1, bits-1);
+    double v = round(x*max);
+    if ( v >= max )
+        return max-1;
+    if ( v < -max )
+        return -max;
+    return v;
+}
+
+// bins this far below the peak of the response count as stopband
+#define STOPBAND_LEVEL 0.01
+
+// second order error zeros tried across the stopband, besides DC and nyquist
+#define FEEDBACK_ZEROS 16
+
+/*
+ * Rounds the first ct taps of h, feeding the rounding error back through
+ * 1 + a1 z^-1 + a2 z^-2, so Q(z) = H(z) + E(z)(1 + a1 z^-1 + a2 z^-2). Symmetric
+ * filters have their first half rounded and mirrored. Returns the number of
+ * saturated taps.
+ */
+static int quantize_shaped(float *h, int32_t *q, int len, bool symmetric, int bits, double a1, double a2) {
+    double scale = ldexp(1, bits-1);
+    int ct = symmetric ? (len+1)/2 : len;
+    int saturated = 0;
+    double e1 = 0;
+    double e2 = 0;
+
+    for (int i = 0; i < ct; i++) {
+        double v = h[i]*scale + (a1*e1 + a2*e2);
+        q[i] = to_fixed(v/scale, bits);
+        double e = q[i]-v;
+        if ( fabs(e) > 2 ) {
+            // don't push the clipped amount into the next coefficients
+            saturated++;
+            e = 0;
+        }
+        e2 = e1;
+        e1 = e;
+    }
+
+    if ( symmetric )
+        for (int i = ct; i < len; i++)
+            q[i] = q[len-1-i];
+
+    return saturated;
+}
+
+// largest error magnitude over the stopband bins of err's spectrum
+static double stopband_error(audiobuf *err, float *h, int32_t *q, int len, int bits, bool *stop) {
+    double scale = ldexp(1, bits-1);
+
+    convert_buf(err, audiobuf_td);
+    for (int i = 0; i < err->len; i++)
+        err->td[i] = i < len ? q[i]/scale - h[i] : 0;
+    convert_buf(err, audiobuf_fd);
+
+    double max = 0;
+    for (int i = 0; i <= err->len/2; i++) {
+        double mag = hypot(err->fd[i*2], err->fd[i*2+1]);
+        if ( stop[i] && mag > max )
+            max = mag;
+    }
+    return max;
+}
+
+int32_t *quantize_buf(audiobuf *buf, enum quantize_mode mode, bool feedback) {
+    convert_buf(buf, audiobuf_td);
+
+    int bits = quantize_bits(mode);
+    double scale = ldexp(1, bits-1);
+    float *h = buf->td;
+
+    int32_t *q;
+    if ( (q = calloc(buf->len, sizeof(int32_t))) == NULL )
+        err(1, "Couldn't allocate %zu bytes for fixed point coefficients", sizeof(int32_t)*buf->len);
+
+    int len = fir_length(buf);
+    bool symmetric = fir_is_symmetric(h, len);
+
+    double best_a1 = 0;
+    double best_a2 = 0;
+
+    if ( feedback ) {
+        // find the stopband on a finely sampled response
+        audiobuf *resp = duplicate_buf(buf);
+        expand_buf(resp, len*4);
+        for (int i = len; i < resp->len; i++)
+            resp->td[i] = 0;
+        convert_buf(resp, audiobuf_fd);
+
+        int bins = resp->len/2+1;
+        bool *stop;
+        if ( (stop = malloc(sizeof(bool)*bins)) == NULL )
+            err(1, "Couldn't allocate space for stopband bins");
+
+        double peak = 0;
+        for (int i = 0; i < bins; i++)
+            if ( peak < hypot(resp->fd[i*2], resp->fd[i*2+1]) )
+                peak = hypot(resp->fd[i*2], resp->fd[i*2+1]);
+        int stopct = 0;
+        for (int i = 0; i < bins; i++) {
+            stop[i] = hypot(resp->fd[i*2], resp->fd[i*2+1]) < peak*STOPBAND_LEVEL;
+            stopct += stop[i];
+        }
+
+        if ( stopct ) {
+            // candidate error shapings: a zero at DC, at nyquist, or a
+            // conjugate pair at points spread over the stopband
+            double cand[FEEDBACK_ZEROS+2][2] = { { -1, 0 }, { 1, 0 } };
+            for (int k = 0; k < FEEDBACK_ZEROS; k++) {
+                int want = (k+0.5)*stopct/FEEDBACK_ZEROS;
+                int bin = 0;
+                for (int i = 0, seen = 0; i < bins; i++)
+                    if ( stop[i] && seen++ == want )
+                        bin = i;
+                cand[k+2][0] = -2*cos(PI*bin/(bins-1));
+                cand[k+2][1] = 1;
+            }
+
+            // plain rounding is the baseline to beat
+            quantize_shaped(h, q, len, symmetric, bits, 0, 0);
+            double best = stopband_error(resp, h, q, len, bits, stop);
+
+            for (int k = 0; k < FEEDBACK_ZEROS+2; k++) {
+                quantize_shaped(h, q, len, symmetric, bits, cand[k][0], cand[k][1]);
+                double e = stopband_error(resp, h, q, len, bits, stop);
+                if ( e < best ) {
+                    best = e;
+                    best_a1 = cand[k][0];
+                    best_a2 = cand[k][1];
+                }
+            }
+        }
+
+        free(stop);
+        free_buf(resp);
+    }
+
+    int saturated = quantize_shaped(h, q, len, symmetric, bits, best_a1, best_a2);
+    if ( saturated )
+        fprintf(stderr, "mkfilter: WARNING: %d coefficients saturated in Q%d.\n", saturated, bits-1);
+
+    for (int i = 0; i < buf->len; i++)
+        h[i] = q[i]/scale;
+
+    return q;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __QUANTIZE_H__
+#define __QUANTIZE_H__
+
+#include "audiobuf.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum quantize_mode {
+    quantize_none,
+    quantize_q15,  // 16 bit, 15 fractional bits
+    quantize_q31   // 32 bit, 31 fractional bits
+};
+
+// word size of the fixed point format
+int quantize_bits(enum quantize_mode mode);
+
+// x * 2^(bits-1), rounded and saturated to the word size
+int32_t to_fixed(double x, int bits);
+
+/*
+ * Rounds the filter to fixed point and returns the buf->len integer
+ * coefficients, which the caller frees. The samples in buf are replaced by the
+ * values the coefficients represent, so analysis shows the quantized filter.
+ *
+ * With feedback, the rounding error of each coefficient is fed into the next
+ * ones, which puts zeros in the spectrum of the error. Stopband depth is
+ * limited by the rounding error, so the placement (DC, nyquist, or a pair
+ * inside the stopband) that leaves the smallest peak error in the stopband is
+ * used, at the cost of more error in the passband. Symmetric filters stay
+ * symmetric.
+ */
+int32_t *quantize_buf(audiobuf *buf, enum quantize_mode mode, bool feedback);
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "smooth.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+// the equivalent rectangular bandwidth of hearing, Glasberg and Moore
+#define ERB_HZ 24.7
+#define ERB_SLOPE 4.37e-3
+
+// how far below the first point the log axis reaches for a segment from 0Hz,
+// and how finely it is sampled there
+#define LOW_HZ 1.0
+#define LEAD_PPO 8
+
+// the output of smoothing a frequency curve without its own ppo
+#define CURVE_PPO 48
+
+#define FWHM_SIGMAS 2.3548200450309493 // 2 sqrt(2 ln 2)
+
+// the gaussian's second and third boxes are 2*GAUSSIAN_R+1 grid samples
+#define GAUSSIAN_R 8
+#define GRID_MAX (1 << 24)
+
+bool handle_smooth_kernel(char *name, enum smooth_kernel *kernel) {
+    if ( strcmp(name, "boxcar") == 0 || strcmp(name, "box") == 0 ) {
+        *kernel = smooth_boxcar;
+    } else if ( strcmp(name, "gaussian") == 0 || strcmp(name, "gauss") == 0 ) {
+        *kernel = smooth_gaussian;
+    } else if ( strcmp(name, "erb") == 0 ) {
+        *kernel = smooth_erb;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool handle_smoothing(char *spec, smoothing *s) {
+    char *copy = strdup(spec);
+    char *colon = strchr(copy, ':');
+    bool ok = colon != NULL;
+    if ( ok ) {
+        *colon = '\0';
+        ok = handle_smooth_kernel(copy, &s->kernel);
+    }
+    if ( ok ) {
+        char *p = colon+1;
+        s->width = strtod(p, &p);
+        s->ppo = 0;
+        if ( *p == ':' )
+            s->ppo = strtod(p+1, &p);
+        ok = !*p && s->width > 0 && s->ppo >= 0;
+    }
+    free(copy);
+    return ok;
+}
+
+// a response read as linear between its points, with its running integral
+typedef struct integral {
+    double *u;   // where the points are, increasing
+    double *a;
+    double *sum; // the integral from u[0] to u[i]
+    int n;
+} integral;
+
+static void make_integral(integral *in, double *u, double *a, int n) {
+    in->u = u;
+    in->a = a;
+    in->n = n;
+    if ( (in->sum = malloc(sizeof(double)*n)) == NULL )
+        err(1, "Couldn't allocate space for smoothing sums");
+    in->sum[0] = 0;
+    for (int i = 1; i < n; i++)
+        in->sum[i] = in->sum[i-1] + (u[i]-u[i-1]) * (a[i]+a[i-1])/2;
+}
+
+// the last point at or below v, which is inside the range
+static int segment(integral *in, double v) {
+    int lo = 0;
+    int hi = in->n-1;
+    while ( hi-lo > 1 ) {
+        int mid = (lo+hi)/2;
+        if ( in->u[mid] <= v )
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// the integral from u[0] to v, or with value the response at v
+static double integral_to(integral *in, double v, bool value) {
+    if ( v <= in->u[0] || in->n == 1 )
+        return value ? in->a[0] : 0;
+    if ( v >= in->u[in->n-1] )
+        return value ? in->a[in->n-1] : in->sum[in->n-1];
+
+    int i = segment(in, v);
+    double w = in->u[i+1] - in->u[i];
+    double t = v - in->u[i];
+    double slope = w > 0 ? (in->a[i+1] - in->a[i]) / w : 0;
+    if ( value )
+        return in->a[i] + t*slope;
+    return in->sum[i] + t*(in->a[i] + t*slope/2);
+}
+
+// the mean over lo to hi, cut to the range of the response
+static double mean(integral *in, double lo, double hi) {
+    if ( lo < in->u[0] ) lo = in->u[0];
+    if ( hi > in->u[in->n-1] ) hi = in->u[in->n-1];
+    if ( hi <= lo )
+        return integral_to(in, lo, true);
+    return (integral_to(in, hi, false) - integral_to(in, lo, false)) / (hi-lo);
+}
+
+// one box of 2r+1 samples, cut at the ends, through prefix sums
+static void box_pass(double *from, double *to, double *prefix, int n, int r) {
+    prefix[0] = 0;
+    for (int i = 0; i < n; i++)
+        prefix[i+1] = prefix[i] + from[i];
+    for (int i = 0; i < n; i++) {
+        int lo = i-r < 0 ? 0 : i-r;
+        int hi = i+r+1 > n ? n : i+r+1;
+        to[i] = (prefix[hi] - prefix[lo]) / (hi-lo);
+    }
+}
+
+/*
+ * The gaussian sampled on a grid over log frequency, as three boxes of 2
+ * sigma each (three variances of sigma^2/3 add up to sigma^2). The first is
+ * exact off the integral; the grid step makes the variance of the 2r+1
+ * sample boxes match it exactly too.
+ */
+static double *gaussian_grid(integral *in, double fwhm, double *step, int *ct) {
+    double box = 2 * fwhm/FWHM_SIGMAS;
+    double h = box / (2*sqrt(GAUSSIAN_R*(GAUSSIAN_R+1.0)));
+    double span = in->u[in->n-1] - in->u[0];
+    if ( span/h + 1 > GRID_MAX )
+        errx(1, "Smoothing width %g is too narrow for a response of %g octaves", fwhm, span);
+
+    int n = (int)ceil(span/h) + 1;
+    double *a, *b, *prefix;
+    if ( (a = malloc(sizeof(double)*n)) == NULL || (b = malloc(sizeof(double)*n)) == NULL ||
+         (prefix = malloc(sizeof(double)*(n+1))) == NULL )
+        err(1, "Couldn't allocate space for smoothing grid");
+
+    for (int i = 0; i < n; i++) {
+        double x = in->u[0] + i*h;
+        a[i] = mean(in, x - box/2, x + box/2);
+    }
+    box_pass(a, b, prefix, n, GAUSSIAN_R);
+    box_pass(b, a, prefix, n, GAUSSIAN_R);
+
+    free(b);
+    free(prefix);
+    *step = h;
+    *ct = n;
+    return a;
+}
+
+int smooth_response(double *freq, double *amp, int ct, smoothing *s, double **outfreq, double **outamp) {
+    int first = 0;
+    while ( first < ct && freq[first] <= 0 )
+        first++;
+    int n = ct-first;
+    if ( n == 0 )
+        errx(1, "Nothing above 0Hz to smooth");
+
+    // the points on the kernel's axis. a segment up from 0Hz is only on the
+    // log axis down to LOW_HZ, so it's sampled there as extra points below.
+    int lead = 0;
+    if ( first > 0 && s->kernel == smooth_erb )
+        lead = 1;
+    else if ( first > 0 && freq[first] > LOW_HZ )
+        lead = (int)ceil(log2(freq[first]/LOW_HZ) * LEAD_PPO);
+
+    double *u, *a;
+    if ( (u = malloc(sizeof(double)*(lead+n))) == NULL || (a = malloc(sizeof(double)*(lead+n))) == NULL )
+        err(1, "Couldn't allocate space for smoothing");
+    for (int i = 0; i < lead; i++) {
+        double f0 = freq[first-1];
+        double f = s->kernel == smooth_erb ? f0 : freq[first] * exp2((double)(i-lead)/LEAD_PPO);
+        u[i] = s->kernel == smooth_erb ? f : log2(f);
+        a[i] = amp[first-1] + (f-f0) / (freq[first]-f0) * (amp[first]-amp[first-1]);
+    }
+    for (int i = 0; i < n; i++) {
+        u[lead+i] = s->kernel == smooth_erb ? freq[first+i] : log2(freq[first+i]);
+        a[lead+i] = amp[first+i];
+    }
+
+    integral in;
+    make_integral(&in, u, a, lead+n);
+
+    double *grid = NULL;
+    double step = 0;
+    int gridct = 0;
+    if ( s->kernel == smooth_gaussian )
+        grid = gaussian_grid(&in, s->width, &step, &gridct);
+
+    // the output frequencies above 0Hz, from an integer number of steps off
+    // 1kHz over the (log) span of the points
+    double anchor = log2(1000);
+    double lx0 = u[0];
+    if ( s->kernel == smooth_erb )
+        lx0 = log2(lead && freq[first] > LOW_HZ ? LOW_HZ : freq[first]);
+    long k0 = 0;
+    int outct = n;
+    if ( s->ppo > 0 ) {
+        k0 = ceil((lx0-anchor)*s->ppo - 1e-9);
+        long k1 = floor((log2(freq[ct-1])-anchor)*s->ppo + 1e-9);
+        outct = k1 >= k0 ? k1-k0+1 : 0;
+    }
+
+    if ( (*outfreq = malloc(sizeof(double)*(first+outct))) == NULL ||
+         (*outamp = malloc(sizeof(double)*(first+outct))) == NULL )
+        err(1, "Couldn't allocate space for smoothed response");
+
+    for (int j = 0; j < first; j++) {
+        (*outfreq)[j] = freq[j];
+        (*outamp)[j] = amp[j];
+    }
+
+    for (int j = 0; j < outct; j++) {
+        double f = s->ppo > 0 ? exp2(anchor + (k0+j)/s->ppo) : freq[first+j];
+        double lx = log2(f);
+
+        double v;
+        switch ( s->kernel ) {
+            case smooth_boxcar:
+                v = mean(&in, lx - s->width/2, lx + s->width/2);
+                break;
+
+            case smooth_gaussian: {
+                double pos = (lx - in.u[0]) / step;
+                int i = floor(pos);
+                if ( i < 0 ) i = 0;
+                if ( i > gridct-2 ) i = gridct-2;
+                v = gridct == 1 ? grid[0] : grid[i] + (pos-i)*(grid[i+1]-grid[i]);
+                break;
+            }
+
+            case smooth_erb: {
+                double e = s->width * ERB_HZ * (ERB_SLOPE*f + 1);
+                v = mean(&in, f - e/2, f + e/2);
+                break;
+            }
+
+            default:
+                errx(1, "Not reached");
+        }
+
+        (*outfreq)[first+j] = f;
+        (*outamp)[first+j] = v;
+    }
+
+    free(u);
+    free(a);
+    free(in.sum);
+    free(grid);
+    return first+outct;
+}
+
+wantcurve *smooth_wantcurve(wantcurve *curve, smoothing *s) {
+    double *freq, *amp;
+    if ( (freq = malloc(sizeof(double)*curve->ct)) == NULL || (amp = malloc(sizeof(double)*curve->ct)) == NULL )
+        err(1, "Couldn't allocate space for smoothing");
+    for (int i = 0; i < curve->ct; i++) {
+        freq[i] = curve->pts[i].freq;
+        amp[i] = curve->pts[i].power;
+    }
+
+    // curves are usually a handful of points, too few to keep
+    smoothing resampled = *s;
+    if ( resampled.ppo == 0 )
+        resampled.ppo = CURVE_PPO;
+
+    double *sfreq, *samp;
+    int ct = smooth_response(freq, amp, curve->ct, &resampled, &sfreq, &samp);
+    if ( ct < 2 )
+        errx(1, "Smoothing left no points in the frequency curve");
+
+    wantcurve *ret;
+    if ( (ret = malloc(sizeof(wantcurve))) == NULL || (ret->pts = malloc(sizeof(wantpoint)*ct)) == NULL )
+        err(1, "Couldn't malloc space for wantcurve");
+    for (int i = 0; i < ct; i++) {
+        ret->pts[i].freq = sfreq[i];
+        ret->pts[i].power = samp[i];
+    }
+    ret->ct = ct;
+    ret->sr = curve->sr;
+    ret->has_sr = curve->has_sr;
+
+    free(freq);
+    free(amp);
+    free(sfreq);
+    free(samp);
+    return ret;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __SMOOTH_H__
+#define __SMOOTH_H__
+
+#include "wantcurve.h"
+
+#include <stdbool.h>
+
+enum smooth_kernel {
+    smooth_none,
+    smooth_boxcar,   // width is the full width in octaves
+    smooth_gaussian, // width is the full width at half maximum in octaves
+    smooth_erb       // width scales the equivalent rectangular bandwidth
+};
+
+typedef struct smoothing {
+    enum smooth_kernel kernel;
+    double width;
+    double ppo;      // output points per octave, 0 for the input's frequencies
+} smoothing;
+
+// "kernel:width[:ppo]", e.g. "gaussian:0.0208:48"
+bool handle_smoothing(char *spec, smoothing *s);
+bool handle_smooth_kernel(char *name, enum smooth_kernel *kernel);
+
+/*
+ * Fractional octave smoothing of an amplitude response given as ct points
+ * sorted by frequency, read as linear between them. Its integral is taken
+ * once as prefix sums over log frequency (linear frequency for ERB), so
+ * every output point is the exact average over its band from two lookups,
+ * whatever the width. The Gaussian is three boxcars in a row on a fine log
+ * grid, and ERB a boxcar 24.7 (4.37 f/1000 + 1) Hz wide at each f.
+ *
+ * With ppo the output is decimated to that many points per octave, on a
+ * grid through 1kHz spanning the input; otherwise it is at the input's
+ * frequencies. Points at or below 0Hz aren't on the log axis and are passed
+ * through unchanged, though the segment up from them is smoothed down to 1Hz.
+ *
+ * Returns the number of output points, in malloced *outfreq and *outamp.
+ */
+int smooth_response(double *freq, double *amp, int ct, smoothing *s, double **outfreq, double **outamp);
+
+// the same for a frequency curve, as a pre-pass for the curve designs. its
+// output defaults to 48 points per octave.
+wantcurve *smooth_wantcurve(wantcurve *curve, smoothing *s);
+
+#endif
@@ -16,8 +16,7 @@
  */
 
 #include "make.h"
-
-#include "../kissfft/kiss_fftr.h"
+#include "jobs.h"
 
 #include <math.h>
 #include <err.h>
@@ -26,45 +25,93 @@
 
 #define PI 3.1415926535897932384626433832795028841971693993
 
-void apply_window(audiobuf *buf, enum window type) {
-    convert_buf(buf, audiobuf_td);
-
-    float l = buf->len;
+/*
+ * Trig by recurrence: a unit complex number is rotated by a fixed angle once
+ * per sample, which costs a few multiplies instead of a libm call. It is
+ * re-anchored with exact values every this many samples so rounding in the
+ * rotation can't build up; blocks start from their own anchor, so they also
+ * split cleanly between threads.
+ */
+#define RECURRENCE_BLOCK 1024
+
+typedef struct rotor {
+    double c, s;   // cos and sin of the current angle
+    double dc, ds; // cos and sin of the step
+} rotor;
+
+static void rotor_start(rotor *r, double angle, double step) {
+    r->c = cos(angle);
+    r->s = sin(angle);
+    r->dc = cos(step);
+    r->ds = sin(step);
+}
 
-    switch ( type ) {
-        case window_blackman:
-            for (int i = 0; i < buf->len; i++)
-                buf->td[i] *= 0.42 - 0.5 * cosf(2*PI * (float)i / l) + 0.08 * cosf(4*PI * (float)i / l);
-            break;
+static void rotor_step(rotor *r) {
+    double c = r->c*r->dc - r->s*r->ds;
+    r->s = r->s*r->dc + r->c*r->ds;
+    r->c = c;
+}
 
-        case window_hamming:
-            for (int i = 0; i < buf->len; i++)
-                buf->td[i] *= 0.54 - 0.46*cosf(2*PI * (float)i / l);
-            break;
+/*
+ * Every window is a0 - a1 cos(2 pi i/l) + a2 cos(4 pi i/l) plus a3 times the
+ * triangle 1 - |1 - 2i/l|, which keeps the per sample work free of branches.
+ */
+typedef struct window_coefs {
+    double a0, a1, a2, a3;
+} window_coefs;
 
-        case window_barlett:
-            for (int i = 0; i < buf->len; i++)
-                buf->td[i] *= 1.0 - fabsf(1.0 - (float)i / l * 2.0);
-            break;
+static window_coefs get_window_coefs(enum window type) {
+    window_coefs w = { 0, 0, 0, 0 };
+    switch ( type ) {
+        case window_blackman:    w.a0 = 0.42; w.a1 = 0.5;  w.a2 = 0.08; break;
+        case window_hamming:     w.a0 = 0.54; w.a1 = 0.46; break;
+        case window_hanning:     w.a0 = 0.5;  w.a1 = 0.5;  break;
+        case window_barlett:     w.a3 = 1;    break;
+        case window_rectangular: w.a0 = 1;    break;
+        default:
+            errx(1, "not reached");
+    }
+    return w;
+}
 
-        case window_hanning:
-            for (int i = 0; i < buf->len; i++)
-                buf->td[i] *= 0.5 - 0.5*cosf(2*PI * (float)i / l);
-            break;
+// window value at i/l given c = cos(2 pi i/l), using cos(4 pi i/l) = 2c^2 - 1
+static inline double window_shape(window_coefs *w, double c, double frac) {
+    return w->a0 - w->a1*c + w->a2*(2*c*c - 1) + w->a3*(1.0 - fabs(1.0 - frac*2.0));
+}
 
-        case window_rectangular:
-            break;
+void apply_window(audiobuf *buf, enum window type) {
+    convert_buf(buf, audiobuf_td);
 
-        default:
-            err(1, "not reached");
+    if ( type == window_rectangular )
+        return;
+
+    // symmetric about the center tap, so linear phase designs stay exactly
+    // symmetric after windowing
+    int len = buf->len;
+    double l = len > 1 ? len-1 : 1;
+    int blocks = (len + RECURRENCE_BLOCK-1) / RECURRENCE_BLOCK;
+    window_coefs w = get_window_coefs(type);
+
+    PARALLEL_FOR
+    for (int b = 0; b < blocks; b++) {
+        int from = b*RECURRENCE_BLOCK;
+        int to = from+RECURRENCE_BLOCK < len ? from+RECURRENCE_BLOCK : len;
+
+        rotor r;
+        rotor_start(&r, 2*PI*from/l, 2*PI/l);
+        for (int i = from; i < to; i++) {
+            buf->td[i] *= window_shape(&w, r.c, i/l);
+            rotor_step(&r);
+        }
     }
 }
 
-audiobuf *make_sinc(int sr, float freq, int size) {
+audiobuf *make_windowed_sinc(int sr, float freq, int size, enum window window) {
     if ( size % 2 == 0 ) size++; // must have odd size, otherwise symmetry causes nonlinear phase in other operations
 
     float fc = freq/sr;
     int center = size/2;
+    double l = size > 1 ? size-1 : 1;
 
     audiobuf *buf;
     if ( (buf = malloc(sizeof(audiobuf))) == NULL )
@@ -76,17 +123,39 @@ audiobuf *make_sinc(int sr, float freq, int size) {
     buf->type = audiobuf_td;
     buf->sr = sr;
 
-    for (int i = 0; i < size; i++) {
-        if ( i == center ) {
-            buf->td[i] = 2*PI * fc;
-        } else {
-            buf->td[i] = sinf(2*PI * fc * (i-center)) / (i-center);
+    // the window peaks (at 1) on the center tap
+    buf->td[center] = 2*PI * fc;
+
+    // the right half, k taps from the center, mirrored onto the left
+    int blocks = (center + RECURRENCE_BLOCK-1) / RECURRENCE_BLOCK;
+    window_coefs w = get_window_coefs(window);
+
+    PARALLEL_FOR
+    for (int b = 0; b < blocks; b++) {
+        int from = 1 + b*RECURRENCE_BLOCK;
+        int to = from+RECURRENCE_BLOCK <= center+1 ? from+RECURRENCE_BLOCK : center+1;
+
+        rotor sinc;
+        rotor win;
+        rotor_start(&sinc, 2*PI*fc*from, 2*PI*fc);
+        rotor_start(&win, 2*PI*(center+from)/l, 2*PI/l);
+
+        for (int k = from; k < to; k++) {
+            float v = sinc.s / k * window_shape(&w, win.c, (center+k)/l);
+            buf->td[center+k] = v;
+            buf->td[center-k] = v;
+            rotor_step(&sinc);
+            rotor_step(&win);
         }
     }
 
     return buf;
 }
 
+audiobuf *make_sinc(int sr, float freq, int size) {
+    return make_windowed_sinc(sr, freq, size, window_rectangular);
+}
+
 void spectral_inversion_td(audiobuf *buf) {
     convert_buf(buf, audiobuf_td);
     for (int i = 0; i < buf->len; i++)
@@ -138,26 +207,23 @@ audiobuf *convolve(audiobuf *a, audiobuf *b) {
     if ( (samp = malloc(sizeof(float)*fftsize)) == NULL )
         err(1, "Couldn't allocate %zu bytes for fft in convolution", sizeof(float)*fftsize);
 
-    kiss_fft_cpx *afft;
-    kiss_fft_cpx *bfft;
+    fft_cpx *afft;
+    fft_cpx *bfft;
 
-    if ( (afft = malloc(sizeof(kiss_fft_cpx)*(fftsize+1))) == NULL )
-        err(1, "Couldn't allocate %zu bytes for ffta in convolution", sizeof(kiss_fft_cpx)*(fftsize/2+1));
-    if ( (bfft = malloc(sizeof(kiss_fft_cpx)*(fftsize+1))) == NULL )
-        err(1, "Couldn't allocate %zu bytes for fftb in convolution", sizeof(kiss_fft_cpx)*(fftsize/2+1));
-
-    kiss_fftr_cfg cfg = kiss_fftr_alloc(fftsize, 0, NULL, NULL);
+    if ( (afft = malloc(sizeof(fft_cpx)*(fftsize+1))) == NULL )
+        err(1, "Couldn't allocate %zu bytes for ffta in convolution", sizeof(fft_cpx)*(fftsize/2+1));
+    if ( (bfft = malloc(sizeof(fft_cpx)*(fftsize+1))) == NULL )
+        err(1, "Couldn't allocate %zu bytes for fftb in convolution", sizeof(fft_cpx)*(fftsize/2+1));
 
     for (int i = 0; i < fftsize; i++)
         samp[i] = i < a->len ? a->td[i] : 0;
-    kiss_fftr(cfg, samp, afft);
+    fftr(fftsize, samp, afft);
 
     for (int i = 0; i < fftsize; i++)
         samp[i] = i < b->len ? b->td[i] : 0;
-    kiss_fftr(cfg, samp, bfft);
-
-    kiss_fftr_free(cfg);
+    fftr(fftsize, samp, bfft);
 
+    PARALLEL_FOR
     for (int i = 0; i < fftsize/2+1; i++) {
         float re = afft[i].r*bfft[i].r - afft[i].i*bfft[i].i;
         float im = afft[i].r*bfft[i].i + afft[i].i*bfft[i].r;
@@ -167,10 +233,9 @@ audiobuf *convolve(audiobuf *a, audiobuf *b) {
 
     free(bfft);
 
-    cfg = kiss_fftr_alloc(fftsize, 1, NULL, NULL);
-    kiss_fftri(cfg, afft, samp);
-    kiss_fftr_free(cfg);
+    fftri(fftsize, afft, samp);
 
+    PARALLEL_FOR
     for (int i = 0; i < fftsize; i++)
         samp[i] /= fftsize;
 
@@ -183,7 +248,7 @@ audiobuf *convolve(audiobuf *a, audiobuf *b) {
     buf->td = samp;
     buf->fd = NULL;
     buf->sr = a->sr;
-    buf->len = a->len + b->len;
+    buf->len = a->len + b->len - 1;
     buf->type = audiobuf_td;
 
     return buf;
@@ -191,12 +256,17 @@ audiobuf *convolve(audiobuf *a, audiobuf *b) {
 
 double frequency_power(audiobuf *buf, float freq) {
     convert_buf(buf, audiobuf_td);
+    double step = PI*2*freq/buf->sr;
     double re = 0;
     double im = 0;
+    rotor r;
+    rotor_start(&r, 0, step);
     for (int i = 0; i < buf->len; i++) {
-        re += buf->td[i] * cos(PI*2*i*freq/buf->sr);
-        im += buf->td[i] * sin(PI*2*i*freq/buf->sr);
+        if ( i % RECURRENCE_BLOCK == 0 && i > 0 )
+            rotor_start(&r, step*i, step);
+        re += buf->td[i] * r.c;
+        im += buf->td[i] * r.s;
+        rotor_step(&r);
     }
     return sqrt(re*re + im*im);
 }
-
@@ -32,6 +32,9 @@ void apply_window(audiobuf *buf, enum window type);
 
 audiobuf *make_sinc(int sr, float freq, int size);
 
+// make_sinc and apply_window in one pass, generating one half and mirroring it
+audiobuf *make_windowed_sinc(int sr, float freq, int size, enum window window);
+
 // input MUST be normalized to dc=0
 void spectral_inversion_td(audiobuf *buf);
 
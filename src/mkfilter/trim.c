@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "trim.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#define PI 3.1415926535897932384626433832795028841971693993
+
+#define TRIM_FADE_MS 1
+
+// the first tap at which the energy of the taps before it passes limit
+static int onset(float *h, int len, double limit) {
+    double sum = 0;
+    for (int i = 0; i < len; i++) {
+        sum += (double)h[i]*h[i];
+        if ( sum > limit )
+            return i;
+    }
+    return len;
+}
+
+// one past the last tap at which the energy from there on is above limit
+static int decay(float *h, int len, double limit) {
+    double sum = 0;
+    for (int i = len-1; i >= 0; i--) {
+        sum += (double)h[i]*h[i];
+        if ( sum > limit )
+            return i+1;
+    }
+    return 0;
+}
+
+static double energy(float *h, int len) {
+    double sum = 0;
+    for (int i = 0; i < len; i++)
+        sum += (double)h[i]*h[i];
+    return sum;
+}
+
+void trim_filters(audiobuf **bufs, int ct, double db, trim_report *report) {
+    double fraction = pow(10, -db/10);
+
+    int head = -1;
+    for (int f = 0; f < ct; f++) {
+        convert_buf(bufs[f], audiobuf_td);
+        double limit = energy(bufs[f]->td, bufs[f]->len) * fraction;
+        int at = onset(bufs[f]->td, bufs[f]->len, limit);
+        if ( head < 0 || at < head )
+            head = at;
+    }
+
+    for (int f = 0; f < ct; f++) {
+        audiobuf *buf = bufs[f];
+        double total = energy(buf->td, buf->len);
+        int fade = buf->sr * TRIM_FADE_MS / 1000;
+
+        int on = head < buf->len ? head : buf->len;
+        int tail = decay(buf->td, buf->len, total*fraction);
+        if ( tail <= on )
+            tail = on+1 <= buf->len ? on+1 : buf->len;
+
+        int from = on-fade > 0 ? on-fade : 0;
+        int to = tail+fade < buf->len ? tail+fade : buf->len;
+        float *h = buf->td + from;
+        int len = to-from;
+
+        // half cosine fades over the taps kept beyond the thresholds, where
+        // anything was cut
+        int in = from > 0 ? on-from : 0;
+        for (int i = 0; i < in; i++)
+            h[i] *= 0.5 - 0.5*cos(PI*(i+1)/(in+1));
+        int out = to < buf->len ? to-tail : 0;
+        for (int i = 0; i < out; i++)
+            h[len-1-i] *= 0.5 - 0.5*cos(PI*(i+1)/(out+1));
+
+        float *td;
+        if ( (td = malloc(sizeof(float)*(len > 0 ? len : 1))) == NULL )
+            err(1, "Couldn't allocate space for trimmed filter");
+        memcpy(td, h, sizeof(float)*len);
+
+        report[f].from = from;
+        report[f].kept = len;
+        report[f].original = buf->len;
+        double kept = energy(td, len);
+        report[f].loss_db = total > 0 && kept > 0 ? 10*log10(total/kept) : 0;
+
+        free(buf->td);
+        buf->td = td;
+        buf->len = len;
+    }
+}
+
+void print_trim_report(trim_report *report, int ct, char *name, FILE *fh) {
+    for (int f = 0; f < ct; f++) {
+        fprintf(fh, "mkfilter: Trimmed ");
+        if ( ct > 1 )
+            fprintf(fh, "filter %d of ", f+1);
+        fprintf(fh, "%s to %d of %d taps from tap %d, losing %.3g dB of energy.\n",
+                name, report[f].kept, report[f].original, report[f].from, report[f].loss_db);
+    }
+}
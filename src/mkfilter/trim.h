@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __TRIM_H__
+#define __TRIM_H__
+
+#include "audiobuf.h"
+
+#include <stdio.h>
+
+// what trimming did to one filter
+typedef struct trim_report {
+    int from;       // first tap kept, of the original
+    int kept;
+    int original;
+    double loss_db; // energy lost, positive
+} trim_report;
+
+/*
+ * Cuts leading silence and the decayed tail off filters: the tail goes where
+ * the Schroeder backward integral of the energy falls db below the total,
+ * and the head where the forward one rises past the same level. A
+ * millisecond of what's cut on each side is kept and faded out with a half
+ * cosine, so the cut is never a step; the fades only touch taps beyond the
+ * threshold.
+ *
+ * Filters that run together (several channels, crossover bands) keep their
+ * relative timing: they all start at the earliest onset among them. Their
+ * tails are cut separately. report has ct entries.
+ */
+void trim_filters(audiobuf **bufs, int ct, double db, trim_report *report);
+
+// "Trimmed name to kept of original taps from tap from, losing x dB" lines
+void print_trim_report(trim_report *report, int ct, char *name, FILE *fh);
+
+#endif
@@ -16,48 +16,11 @@
  */
 
 #include "wantcurve.h"
+#include "parse.h"
 
 #include <err.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-
-wantcurve *read_wantcurve_from_path(char *path) {
-    FILE *fh;
-    if ( strcmp(path, "-") == 0 ) {
-        fh = stdin;
-    } else {
-        if ( (fh = fopen(path, "rb")) == NULL )
-            err(1, "Couldn't open %s for reading", path);
-    }
-    wantcurve *ret = read_wantcurve_from_file(fh);
-    fclose(fh);
-    return ret;
-}
-
-wantcurve *read_wantcurve_from_file(FILE *fh) {
-    char *str;
-    int malloced = 1024;
-    int at = 0;
-    if ( (str = malloc(malloced)) == NULL )
-        err(1, "Couldn't malloc space for wantcurve");
-
-    int read = 0;
-    while ( (read = fread(str+at, 1, malloced-at, fh)) > 0 ) {
-        malloced = malloced*1.5 + 1024;
-        if ( (str = realloc(str, malloced)) == NULL )
-            err(1, "Couldn't realloc space for wantcurve");
-        at += read;
-    }
-
-    str[at] = '\0';
-
-    wantcurve *ret = read_wantcurve_from_string(str);
-
-    free(str);
-
-    return ret;
-}
 
 static int compare_wantpoint(const void *a, const void *b) {
     float fa = ((wantpoint*)a)->freq;
@@ -67,66 +30,24 @@ static int compare_wantpoint(const void *a, const void *b) {
     return 0;
 }
 
-wantcurve *read_wantcurve_from_string(char *str) {
-    char *s = str;
-    char *end = str+strlen(str);
-
-    int ptsmalloced = 100;
+static wantcurve *read_wantcurve(char *text, size_t len) {
+    int ptsmalloced = 1024;
     wantcurve *ret;
     if ( (ret = malloc(sizeof(wantcurve))) == NULL )
         err(1, "Couldn't malloc space for wantcurve structure");
     if ( (ret->pts = malloc(sizeof(wantpoint)*ptsmalloced)) == NULL )
         err(1, "Couldn't malloc space for wantpoint list");
     ret->ct = 0;
-    ret->has_sr = false;
-
-    // grab the sample rate, if it was given
-    while ( s < end ) {
-        if ( end-s <= 11 )
-            break;
-        if ( memcmp(s, "SAMPLERATE=", 11) == 0 ) {
-            s += 11;
-            if ( *s >= '0' && *s <= '9' ) {
-                ret->sr = strtol(s, &s, 10);
-                ret->has_sr = true;
-            }
-        }
-        s++;
-    }
 
-    s = str;
-    // now we look for the points.
-    while ( s < end ) {
-        // skip comments
-        if ( *s == '#' || *s == ';' ) {
-            while ( *s && *s != '\n' && *s != '\r' && *s != ',' ) s++;
-            s++; continue;
-        }
+    // the points and the sample rate, if it was given, in one pass
+    scanner sc;
+    start_scan(&sc, text, len, true, true);
+    enum scan_item item;
+    double freq, power;
+    while ( (item = scan_next(&sc, &freq, &power)) != scan_end ) {
+        if ( item != scan_pair )
+            continue;
 
-        // skip spaces
-        while ( *s && isspace(*s) ) s++;
-
-        // get a number or skip this line
-        if ( !((*s >= '0' && *s <= '9') || *s == '+' || *s == '-' || *s == '.') ) {
-            while ( *s && *s != '\n' && *s != '\r' && *s != ',' ) s++;
-            s++; continue;
-        }
-        float freq = strtof(s, &s);
-
-        // skip the seperator
-        while ( *s && (isspace(*s) || *s == '=') ) s++;
-        
-        // get another number or skip this line
-        if ( !((*s >= '0' && *s <= '9') || *s == '+' || *s == '-' || *s == '.') ) {
-            while ( *s && *s != '\n' && *s != '\r' && *s != ',' ) s++;
-            s++; continue;
-        }
-        float power = strtof(s, &s);
-
-        while ( *s && *s != '\n' && *s != '\r' && *s != ',' ) s++;
-        s++;
-
-        // now we insert the point into the wantcurve
         if ( ret->ct+1 > ptsmalloced ) {
             ptsmalloced = ptsmalloced * 2;
             if ( (ret->pts = realloc(ret->pts, sizeof(wantpoint)*ptsmalloced)) == NULL )
@@ -138,6 +59,9 @@ wantcurve *read_wantcurve_from_string(char *str) {
         ret->ct++;
     }
 
+    ret->sr = sc.sr;
+    ret->has_sr = sc.sr > 0;
+
     qsort(ret->pts, ret->ct, sizeof(wantpoint), compare_wantpoint);
 
     if ( ret->ct == 0 )
@@ -146,3 +70,48 @@ wantcurve *read_wantcurve_from_string(char *str) {
     return ret;
 }
 
+wantcurve *read_wantcurve_from_path(char *path) {
+    textfile *t = map_text(path);
+    wantcurve *ret = read_wantcurve(t->text, t->len);
+    unmap_text(t);
+    return ret;
+}
+
+wantcurve *read_wantcurve_from_file(FILE *fh) {
+    textfile *t = map_text_file(fh);
+    wantcurve *ret = read_wantcurve(t->text, t->len);
+    unmap_text(t);
+    return ret;
+}
+
+wantcurve *read_wantcurve_from_string(char *str) {
+    return read_wantcurve(str, strlen(str));
+}
+
+float wantcurve_power_at(wantcurve *curve, float freq) {
+    if ( freq <= curve->pts[0].freq )
+        return curve->pts[0].power;
+    if ( freq >= curve->pts[curve->ct-1].freq )
+        return curve->pts[curve->ct-1].power;
+
+    // binary search for the last point at or below freq
+    int lo = 0;
+    int hi = curve->ct-1;
+    while ( hi-lo > 1 ) {
+        int mid = (lo+hi)/2;
+        if ( curve->pts[mid].freq <= freq )
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    wantpoint *low = &(curve->pts[lo]);
+    wantpoint *high = &(curve->pts[hi]);
+    float p0 = (freq-low->freq)/(high->freq-low->freq);
+    return p0*high->power + (1-p0)*low->power;
+}
+
+void free_wantcurve(wantcurve *curve) {
+    free(curve->pts);
+    free(curve);
+}
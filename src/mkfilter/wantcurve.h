@@ -37,5 +37,10 @@ wantcurve *read_wantcurve_from_path(char *path);
 wantcurve *read_wantcurve_from_file(FILE *fh);
 wantcurve *read_wantcurve_from_string(char *str);
 
+// linear interpolation between points, constant outside them
+float wantcurve_power_at(wantcurve *curve, float freq);
+
+void free_wantcurve(wantcurve *curve);
+
 #endif
 
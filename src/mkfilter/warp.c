@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "warp.h"
+#include "make.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <err.h>
+
+#define PI 3.1415926535897932384626433832795028841971693993
+
+// samples of the curve on the warped axis per warped tap
+#define WARP_OVERSAMPLE 4
+
+double bark_warp(int sr) {
+    return 1.0674 * sqrt(2/PI * atan(0.06583 * sr/1000)) - 0.1916;
+}
+
+double warp_frequency(double w, double lambda) {
+    return w + 2*atan2(lambda*sin(w), 1 - lambda*cos(w));
+}
+
+audiobuf *make_warped(int sr, wantcurve *curve, int len, double lambda, enum window window) {
+    int ct = WARP_OVERSAMPLE*len + 1;
+
+    wantcurve warped;
+    if ( (warped.pts = malloc(sizeof(wantpoint)*ct)) == NULL )
+        err(1, "Couldn't malloc space for warped curve");
+    warped.ct = ct;
+    warped.sr = sr;
+    warped.has_sr = true;
+
+    // the warped frequency of each point is where the realized filter has
+    // the curve's value at the unwarped one
+    for (int i = 0; i < ct; i++) {
+        double w = PI*i/(ct-1);
+        warped.pts[i].freq = w/(2*PI) * sr;
+        warped.pts[i].power = wantcurve_power_at(curve, warp_frequency(w, -lambda)/(2*PI) * sr);
+    }
+
+    audiobuf *buf = make_custom(sr, &warped, len, window);
+    free(warped.pts);
+    return buf;
+}
+
+/*
+ * The coefficients are summed off an impulse passed through one more allpass
+ * per tap. Every allpass delays low frequencies by up to (1+|lambda|) /
+ * (1-|lambda|) samples, so twice that per tap is long enough for the tail by
+ * default.
+ */
+audiobuf *unwarp_fir(audiobuf *coefs, double lambda, int len) {
+    convert_buf(coefs, audiobuf_td);
+    int taps = coefs->len;
+    if ( len <= 0 )
+        len = (int)ceil(2*taps * (1+fabs(lambda)) / (1-fabs(lambda))) + 1;
+
+    double *x, *y;
+    if ( (x = calloc(len, sizeof(double))) == NULL || (y = calloc(len, sizeof(double))) == NULL )
+        err(1, "Couldn't allocate space for unwarping");
+    x[0] = 1;
+
+    for (int k = 0; k < taps; k++) {
+        for (int n = 0; n < len; n++)
+            y[n] += coefs->td[k] * x[n];
+
+        if ( k == taps-1 )
+            break;
+
+        // x through one more allpass, in place
+        double px = 0;
+        double py = 0;
+        for (int n = 0; n < len; n++) {
+            double v = x[n];
+            py = px - lambda*v + lambda*py;
+            px = v;
+            x[n] = py;
+        }
+    }
+
+    audiobuf *buf;
+    if ( (buf = malloc(sizeof(audiobuf))) == NULL )
+        err(1, "Couldn't malloc space for audiobuf structure");
+    if ( (buf->td = malloc(sizeof(float)*len)) == NULL )
+        err(1, "Couldn't malloc space for audio");
+    for (int n = 0; n < len; n++)
+        buf->td[n] = y[n];
+    buf->len = len;
+    buf->fd = NULL;
+    buf->sr = coefs->sr;
+    buf->type = audiobuf_td;
+
+    free(x);
+    free(y);
+    return buf;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __WARP_H__
+#define __WARP_H__
+
+#include "audiobuf.h"
+#include "wantcurve.h"
+#include "tools.h"
+
+/*
+ * Warped FIR filters replace every unit delay with the allpass
+ * D(z) = (z^-1 - lambda) / (1 - lambda z^-1), which maps frequency w to
+ * w + 2 atan(lambda sin w / (1 - lambda cos w)). A positive lambda spreads
+ * the low frequencies over more of the warped axis, so a few taps resolve
+ * detail there that a plain FIR would need many times more taps for.
+ */
+
+// the lambda whose warping is closest to the Bark scale at sr (Smith and Abel)
+double bark_warp(int sr);
+
+// w in radians per sample, warped by lambda; -lambda undoes it
+double warp_frequency(double w, double lambda);
+
+// len warped coefficients fitting the wantcurve's magnitude once realized, by
+// sampling it on the warped axis for make_custom
+audiobuf *make_warped(int sr, wantcurve *curve, int len, double lambda, enum window window);
+
+// the realized impulse response of warped coefficients, len samples long or
+// with len 0 long enough for its decay (see warp.c)
+audiobuf *unwarp_fir(audiobuf *coefs, double lambda, int len);
+
+#endif
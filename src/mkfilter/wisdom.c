@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#include "wisdom.h"
+#include "../kissfft/kiss_fft.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+typedef struct wisdom_key {
+    int kind;
+    int n;
+    int inverse;
+} wisdom_key;
+
+typedef struct wisdom_entry {
+    wisdom_key key; // first, so entries compare as keys
+    const kiss_fft_cpx *table;
+    size_t len;
+    uint64_t hash;
+    int checked; // 0 not yet, 1 good, -1 bad
+} wisdom_entry;
+
+// the loaded file
+static char *mappath = NULL;
+static wisdom_entry *entries = NULL;
+static int entryct = 0;
+
+// the tables asked for, when recording
+static char *recordpath = NULL;
+static wisdom_key *used = NULL;
+static int usedct = 0;
+static int usedspace = 0;
+
+static void put_le(unsigned char *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        p[i] = (v >> (8*i)) & 0xff;
+}
+
+static uint64_t get_le(unsigned char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = bytes-1; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t fnv1a(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t h = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+// the tables are used in place, so they must already be in host order
+static bool little_endian(void) {
+    uint32_t one = 1;
+    return *(unsigned char*)&one == 1;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    const wisdom_key *x = a;
+    const wisdom_key *y = b;
+    if ( x->kind != y->kind )
+        return x->kind < y->kind ? -1 : 1;
+    if ( x->n != y->n )
+        return x->n < y->n ? -1 : 1;
+    if ( x->inverse != y->inverse )
+        return x->inverse < y->inverse ? -1 : 1;
+    return 0;
+}
+
+static wisdom_entry *find_entry(wisdom_key *key) {
+    if ( entryct == 0 )
+        return NULL;
+    return bsearch(key, entries, entryct, sizeof(wisdom_entry), compare_keys);
+}
+
+static void note_used(wisdom_key *key) {
+    for (int i = 0; i < usedct; i++)
+        if ( compare_keys(&used[i], key) == 0 )
+            return;
+    if ( usedct == usedspace ) {
+        usedspace = usedspace ? usedspace*2 : 16;
+        if ( (used = realloc(used, sizeof(wisdom_key)*usedspace)) == NULL )
+            err(1, "Couldn't allocate space for wisdom");
+    }
+    used[usedct++] = *key;
+}
+
+// the table source given to kissfft
+static const kiss_fft_cpx *wisdom_table(int kind, int nfft, int inverse) {
+    wisdom_key key = { kind, nfft, inverse ? 1 : 0 };
+    const kiss_fft_cpx *table = NULL;
+
+    #pragma omp critical (wisdom)
+    {
+        if ( recordpath )
+            note_used(&key);
+
+        wisdom_entry *e = find_entry(&key);
+        if ( e && e->checked == 0 ) {
+            e->checked = fnv1a(e->table, sizeof(kiss_fft_cpx)*e->len) == e->hash ? 1 : -1;
+            if ( e->checked < 0 )
+                fprintf(stderr, "mkfilter: WARNING: Wisdom file %s has a bad table for size %d, computing it instead.\n", mappath, nfft);
+        }
+        if ( e && e->checked > 0 )
+            table = e->table;
+    }
+
+    return table;
+}
+
+static void ignore_wisdom(char *path, char *why) {
+    fprintf(stderr, "mkfilter: WARNING: Ignoring wisdom file %s: %s.\n", path, why);
+}
+
+void load_wisdom(char *path) {
+    if ( !little_endian() ) {
+        ignore_wisdom(path, "it can only be used on little-endian hosts");
+        return;
+    }
+
+    FILE *fh;
+    if ( (fh = fopen(path, "rb")) == NULL ) {
+        fprintf(stderr, "mkfilter: WARNING: Couldn't open wisdom file %s, computing FFT tables instead.\n", path);
+        return;
+    }
+
+    // the mapping stays valid after the file is closed, and after the file
+    // is replaced by record_wisdom
+    struct stat st;
+    void *p = MAP_FAILED;
+    if ( fstat(fileno(fh), &st) == 0 && st.st_size >= WISDOM_HEADER_SIZE )
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fh), 0);
+    fclose(fh);
+    if ( p == MAP_FAILED ) {
+        ignore_wisdom(path, "couldn't map it");
+        return;
+    }
+
+    unsigned char *map = p;
+    size_t size = st.st_size;
+    uint64_t headsize = get_le(map+12, 4);
+    uint64_t ct = get_le(map+16, 4);
+    uint64_t entrysize = get_le(map+20, 4);
+
+    char *why = NULL;
+    if ( memcmp(map, WISDOM_MAGIC, 8) != 0 )
+        why = "not a wisdom file";
+    else if ( get_le(map+8, 4) != WISDOM_VERSION )
+        why = "unknown version";
+    else if ( get_le(map+24, 8) != size )
+        why = "wrong length";
+    else if ( headsize < WISDOM_HEADER_SIZE || entrysize < WISDOM_ENTRY_SIZE || headsize + ct*entrysize > size )
+        why = "bad index";
+    else if ( fnv1a(map+headsize, ct*entrysize) != get_le(map+32, 8) )
+        why = "index checksum mismatch";
+
+    wisdom_entry *es = NULL;
+    int es_ct = 0;
+    if ( !why && (es = malloc(sizeof(wisdom_entry)*(ct ? ct : 1))) == NULL )
+        err(1, "Couldn't allocate space for wisdom");
+
+    for (uint64_t i = 0; !why && i < ct; i++) {
+        unsigned char *e = map + headsize + i*entrysize;
+        if ( get_le(e+12, 4) != WISDOM_SCALAR_FLOAT32 )
+            continue; // tables for other builds
+
+        wisdom_entry *w = &es[es_ct++];
+        w->key.kind = get_le(e, 4);
+        w->key.n = get_le(e+4, 4);
+        w->key.inverse = get_le(e+8, 4);
+        uint64_t offset = get_le(e+16, 8);
+        w->len = get_le(e+24, 8);
+        w->hash = get_le(e+32, 8);
+        w->checked = 0;
+        w->table = (const kiss_fft_cpx*)(map + offset);
+
+        if ( (w->key.kind != KISS_TWIDDLES && w->key.kind != KISS_SUPER_TWIDDLES) || w->key.n <= 0 || w->key.inverse > 1 ||
+                w->len != kiss_fft_table_len(w->key.kind, w->key.n) || offset % WISDOM_ALIGN || offset > size ||
+                w->len > (size - offset) / sizeof(kiss_fft_cpx) )
+            why = "bad index entry";
+    }
+
+    if ( why ) {
+        ignore_wisdom(path, why);
+        free(es);
+        munmap(map, size);
+        return;
+    }
+
+    qsort(es, es_ct, sizeof(wisdom_entry), compare_keys);
+    entries = es;
+    entryct = es_ct;
+    mappath = strdup(path);
+    kiss_fft_set_table_source(wisdom_table);
+}
+
+static void save_wisdom(void) {
+    // the loaded tables are kept along with the new ones
+    for (int i = 0; i < entryct; i++)
+        if ( entries[i].checked >= 0 )
+            note_used(&entries[i].key);
+    qsort(used, usedct, sizeof(wisdom_key), compare_keys);
+
+    size_t headsize = (WISDOM_HEADER_SIZE + (size_t)WISDOM_ENTRY_SIZE*usedct + WISDOM_ALIGN-1) / WISDOM_ALIGN * WISDOM_ALIGN;
+    unsigned char *head;
+    if ( (head = calloc(headsize, 1)) == NULL ) {
+        fprintf(stderr, "mkfilter: WARNING: Couldn't allocate space for wisdom, not writing %s.\n", recordpath);
+        return;
+    }
+
+    // written beside it and renamed over, so a loaded copy stays intact
+    char *tmppath;
+    if ( (tmppath = malloc(strlen(recordpath)+5)) == NULL ) {
+        free(head);
+        return;
+    }
+    sprintf(tmppath, "%s.tmp", recordpath);
+
+    FILE *fh;
+    if ( (fh = fopen(tmppath, "wb")) == NULL ) {
+        fprintf(stderr, "mkfilter: WARNING: Couldn't open %s to write wisdom.\n", tmppath);
+        free(tmppath);
+        free(head);
+        return;
+    }
+
+    // the tables come first, so their hashes are known for the index
+    bool ok = fseek(fh, headsize, SEEK_SET) == 0;
+    uint64_t offset = headsize;
+    unsigned char zeros[WISDOM_ALIGN];
+    memset(zeros, 0, WISDOM_ALIGN);
+    for (int i = 0; ok && i < usedct; i++) {
+        wisdom_key *k = &used[i];
+        size_t len = kiss_fft_table_len(k->kind, k->n);
+
+        kiss_fft_cpx *buf = NULL;
+        const kiss_fft_cpx *table;
+        wisdom_entry *e = find_entry(k);
+        if ( e && e->checked >= 0 && (e->checked > 0 || fnv1a(e->table, sizeof(kiss_fft_cpx)*e->len) == e->hash) ) {
+            table = e->table;
+        } else {
+            if ( (buf = malloc(sizeof(kiss_fft_cpx)*(len ? len : 1))) == NULL ) {
+                ok = false;
+                break;
+            }
+            kiss_fft_compute_table(k->kind, k->n, k->inverse, buf);
+            table = buf;
+        }
+
+        unsigned char *entry = head + WISDOM_HEADER_SIZE + (size_t)WISDOM_ENTRY_SIZE*i;
+        put_le(entry,    k->kind, 4);
+        put_le(entry+4,  k->n, 4);
+        put_le(entry+8,  k->inverse, 4);
+        put_le(entry+12, WISDOM_SCALAR_FLOAT32, 4);
+        put_le(entry+16, offset, 8);
+        put_le(entry+24, len, 8);
+        put_le(entry+32, fnv1a(table, sizeof(kiss_fft_cpx)*len), 8);
+
+        size_t bytes = sizeof(kiss_fft_cpx)*len;
+        size_t pad = (WISDOM_ALIGN - bytes % WISDOM_ALIGN) % WISDOM_ALIGN;
+        ok = fwrite(table, 1, bytes, fh) == bytes && fwrite(zeros, 1, pad, fh) == pad;
+        offset += bytes + pad;
+        free(buf);
+    }
+
+    memcpy(head, WISDOM_MAGIC, 8);
+    put_le(head+8,  WISDOM_VERSION, 4);
+    put_le(head+12, WISDOM_HEADER_SIZE, 4);
+    put_le(head+16, usedct, 4);
+    put_le(head+20, WISDOM_ENTRY_SIZE, 4);
+    put_le(head+24, offset, 8);
+    put_le(head+32, fnv1a(head+WISDOM_HEADER_SIZE, (size_t)WISDOM_ENTRY_SIZE*usedct), 8);
+
+    ok = ok && fseek(fh, 0, SEEK_SET) == 0 && fwrite(head, 1, headsize, fh) == headsize;
+    ok = fclose(fh) == 0 && ok;
+    if ( !ok || rename(tmppath, recordpath) != 0 ) {
+        fprintf(stderr, "mkfilter: WARNING: Couldn't write wisdom to %s.\n", recordpath);
+        remove(tmppath);
+    }
+
+    free(tmppath);
+    free(head);
+}
+
+void record_wisdom(char *path) {
+    if ( !little_endian() )
+        errx(1, "Wisdom files can only be written on little-endian hosts");
+
+    recordpath = strdup(path);
+    kiss_fft_set_table_source(wisdom_table);
+    if ( atexit(save_wisdom) != 0 )
+        errx(1, "Couldn't arrange to write wisdom at exit");
+}
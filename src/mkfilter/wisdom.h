@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+#ifndef __WISDOM_H__
+#define __WISDOM_H__
+
+/*
+ * A wisdom file keeps the twiddle tables FFT plans would otherwise compute
+ * with a cos and sin per entry, so a fresh process can start on big
+ * transforms without millions of trig calls. It is mapped, not read: a plan
+ * copies just the tables it needs straight out of the mapping. Both the
+ * kissfft and Stockham backends take their tables from it.
+ *
+ * The file is a 64 byte little-endian header, an index with one entry per
+ * table sorted by kind, size then direction, and the tables, each starting
+ * 64 byte aligned:
+ *
+ *     offset  size  contents
+ *          0     8  magic, "MKFWISDM"
+ *          8     4  format version, currently 1
+ *         12     4  header size in bytes (offset of the index)
+ *         16     4  entries
+ *         20     4  index entry size in bytes
+ *         24     8  file size in bytes
+ *         32     8  FNV-1a (64 bit) hash of the index
+ *         40    24  reserved, 0
+ *
+ * and each index entry is
+ *
+ *          0     4  kind, KISS_TWIDDLES or KISS_SUPER_TWIDDLES (see kiss_fft.h)
+ *          4     4  transform size
+ *          8     4  direction, 0 forward or 1 inverse
+ *         12     4  scalar type, see WISDOM_SCALAR_*
+ *         16     8  offset of the table from the start of the file
+ *         24     8  table length in complex values
+ *         32     8  FNV-1a (64 bit) hash of the table
+ *         40     8  reserved, 0
+ *
+ * A table is its values as interleaved real and imaginary scalars. The
+ * index is checked when the file is loaded and each table the first time
+ * it is used; a file that fails is ignored with a warning, and the tables
+ * are computed as usual. The output is bit-identical either way.
+ */
+#define WISDOM_MAGIC "MKFWISDM"
+#define WISDOM_VERSION 1
+#define WISDOM_HEADER_SIZE 64
+#define WISDOM_ENTRY_SIZE 48
+#define WISDOM_ALIGN 64
+
+#define WISDOM_SCALAR_FLOAT32 1
+
+// maps path and has plans take their tables from it. a missing or bad file
+// is only warned about.
+void load_wisdom(char *path);
+
+// writes every table this process uses, and any loaded ones, to path on
+// exit. it may be the file loaded.
+void record_wisdom(char *path);
+
+#endif
@@ -15,25 +15,33 @@
  *       permission.
  */
 
+#include "mkfilter/parse.h"
+#include "mkfilter/smooth.h"
+
 #include <stdlib.h>
 #include <getopt.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <err.h>
 #include <string.h>
-#include <ctype.h>
 
 void usage(char *name) {
     fprintf(stderr, "Usage:\n");
-    fprintf(stderr, "    %s -w octaves [-o outfile] [file]\n", name);
+    fprintf(stderr, "    %s -w width [-k kernel] [-p pointsperoctave] [-o outfile] [file]\n", name);
     fprintf(stderr, "    %s -h\n", name);
     fprintf(stderr, "\n");
     fprintf(stderr, "%s smooths the given response (in mkfilter --analyze format)\n", name);
     fprintf(stderr, "in the per-frequency amplitude domain. It removes the phase information, as it\n");
     fprintf(stderr, "is corrupted by this smoothing.\n");
     fprintf(stderr, "\n");
-    fprintf(stderr, "It samples the same frequencies as are in the input, so its intended behavior\n");
-    fprintf(stderr, "is only reached when the input is dense.\n");
+    fprintf(stderr, "Kernels:\n");
+    fprintf(stderr, "    boxcar (default; width is the full width in octaves)\n");
+    fprintf(stderr, "    gaussian (width is the full width at half maximum in octaves)\n");
+    fprintf(stderr, "    erb (width is in equivalent rectangular bandwidths of hearing)\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "The response is read as linear between its points, so the smoothing is\n");
+    fprintf(stderr, "exact however sparse the input is. Without -p the output is at the input's\n");
+    fprintf(stderr, "frequencies; with it, at that many points per octave through 1kHz.\n");
     fprintf(stderr, "\n");
 }
 
@@ -41,6 +49,8 @@ static struct option long_options[] = {
     { "output", 1, NULL, 'o' },
     { "width", 1, NULL, 'w' },
     { "window", 1, NULL, 'w' },
+    { "kernel", 1, NULL, 'k' },
+    { "points-per-octave", 1, NULL, 'p' },
     { "help", 0, NULL, 'h' },
     { NULL, 0, NULL, 0 }
 };
@@ -58,64 +68,58 @@ int compare_pt(const void *a, const void *b) {
     return 0;
 }
 
-#define BUF_SIZE 1000
-void process(FILE *in, FILE *out, double width) {
+void process(textfile *in, FILE *out, smoothing *smooth) {
     int at = 0;
-    int alloced = 100;
+    int alloced = 1024;
     pt *pts;
     if ( (pts = malloc(sizeof(pt)*alloced)) == NULL )
         err(1, "Couldn't allocate space for points array");
 
     // step 1: read the input data into *pts
-    char line[BUF_SIZE];
-    while ( fgets(line, BUF_SIZE, in) ) {
-        char *p = line;
-
-        while ( *p && isspace(*p) ) p++;
-
-        if ( *p == ';' || *p == '#' ) {
+    scanner sc;
+    start_scan(&sc, in->text, in->len, false, false);
+    enum scan_item item;
+    while ( (item = scan_next(&sc, &pts[at].freq, &pts[at].amp)) != scan_end ) {
+        if ( item == scan_comment ) {
             // keep comments - they have important information like the sample rate
-            fprintf(out, "%s", line);
+            fprintf(out, "%.*s\n", (int)sc.linelen, sc.line);
             continue;
         }
 
-        char *oldp = p;
-        pts[at].freq = strtod(p, &p);
-        if ( oldp == p || !*p ) continue;
-
-        while ( *p && isspace(*p) ) p++;
-
-        oldp = p;
-        pts[at].amp = strtod(p, &p);
-        if ( oldp == p ) continue;
-
-        // ignore the rest of the line, if any
-
         at++;
 
         if ( at >= alloced ) {
-            alloced = alloced*2 + 50;
+            alloced = alloced*2;
             if ( (pts = realloc(pts, sizeof(pt)*alloced)) == NULL )
                 err(1, "Couldn't realloc space for points array");
         }
     }
 
-    // step 2: sort by frequency
+    if ( at == 0 )
+        errx(1, "No points to smooth");
+
+    // step 2: sort by frequency, and split into columns
     qsort(pts, at, sizeof(pt), compare_pt);
 
-    // step 3: scan, printing the results as we go
-    double sum = pts[0].amp;
-    int from = 0;
-    int to = 0;
+    double *freq, *amp;
+    if ( (freq = malloc(sizeof(double)*at)) == NULL || (amp = malloc(sizeof(double)*at)) == NULL )
+        err(1, "Couldn't allocate space for points columns");
     for (int i = 0; i < at; i++) {
-        double topf = pts[i].freq * (1+width);
-        double botf = pts[i].freq / (1+width);
-
-        while ( at-1 > to+1   && pts[to  ].freq < topf ) sum += pts[to++  ].amp;
-        while ( at-1 > from+1 && pts[from].freq < botf ) sum -= pts[from++].amp;
-
-        fprintf(out, "%.15f %.15f\n", pts[i].freq, sum/(to-from+1));
+        freq[i] = pts[i].freq;
+        amp[i] = pts[i].amp;
     }
+    free(pts);
+
+    // step 3: smooth, printing the results
+    double *sfreq, *samp;
+    int ct = smooth_response(freq, amp, at, smooth, &sfreq, &samp);
+    for (int i = 0; i < ct; i++)
+        fprintf(out, "%.15f %.15f\n", sfreq[i], samp[i]);
+
+    free(freq);
+    free(amp);
+    free(sfreq);
+    free(samp);
 }
 
 int main(int argc, char **argv) {
@@ -123,10 +127,13 @@ int main(int argc, char **argv) {
 
     char *outfile = NULL;
     bool window_set = false;
-    double window = 0;
+    smoothing smooth;
+    smooth.kernel = smooth_boxcar;
+    smooth.width = 0;
+    smooth.ppo = 0;
 
     while ( true ) {
-        int c = getopt_long(argc, argv, "o:w:h", long_options, NULL);
+        int c = getopt_long(argc, argv, "o:w:k:p:h", long_options, NULL);
         if ( c == -1 )
             break;
 
@@ -137,11 +144,22 @@ int main(int argc, char **argv) {
 
             case 'w':
                 window_set = true;
-                window = strtod(optarg, &optarg);
-                if ( *optarg )
+                smooth.width = strtod(optarg, &optarg);
+                if ( *optarg || smooth.width <= 0 )
                     errx(1, "Bad window specifier");
                 break;
 
+            case 'k':
+                if ( !handle_smooth_kernel(optarg, &smooth.kernel) )
+                    errx(1, "Unknown kernel %s", optarg);
+                break;
+
+            case 'p':
+                smooth.ppo = strtod(optarg, &optarg);
+                if ( *optarg || smooth.ppo < 0 )
+                    errx(1, "Bad points per octave");
+                break;
+
             case 'h':
                 usage(progname);
                 exit(1);
@@ -155,15 +173,13 @@ int main(int argc, char **argv) {
     if ( !window_set )
         errx(1, "Need a window (run with -h for help)");
 
-    FILE *read_from;
+    textfile *read_from;
     FILE *write_to;
 
     if ( optind+1 == argc ) {
-        if ( (read_from = fopen(argv[optind], "r")) == NULL )
-            err(1, "Couldn't open %s for reading", argv[optind]);
-
+        read_from = map_text(argv[optind]);
     } else if ( optind == argc ) {
-        read_from = stdin;
+        read_from = map_text_file(stdin);
     } else {
         errx(1, "Too many arguments");
     }
@@ -174,10 +190,9 @@ int main(int argc, char **argv) {
         if ( (write_to = fopen(outfile, "w")) == NULL )
             err(1, "Couldn't open %s for writing", outfile);
 
-    process(read_from, write_to, window);
+    process(read_from, write_to, &smooth);
 
-    if ( fclose(read_from) )
-        err(1, "Couldn't close reading filehandle");
+    unmap_text(read_from);
     if ( fclose(write_to) )
         err(1, "Couldn't close writing filehandle");
 
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+/*
+ * Every backend at the sizes whose plans are a single radix, complex 1..10
+ * and real 2..20, against a direct DFT, both ways and in place. Exits
+ * nonzero on any mismatch.
+ */
+
+#include "../src/mkfilter/fft.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define MAXN 10
+#define TOLERANCE 1e-5
+
+static void dft(int n, bool inverse, fft_cpx *in, fft_cpx *out) {
+    for (int k = 0; k < n; k++) {
+        double re = 0, im = 0;
+        for (int j = 0; j < n; j++) {
+            double a = (inverse ? 2 : -2) * M_PI * ((j*k) % n) / n;
+            re += in[j].r*cos(a) - in[j].i*sin(a);
+            im += in[j].r*sin(a) + in[j].i*cos(a);
+        }
+        out[k].r = re;
+        out[k].i = im;
+    }
+}
+
+static double error(int n, fft_cpx *want, fft_cpx *got) {
+    double e = 0, peak = 1;
+    for (int i = 0; i < n; i++) {
+        e = fmax(e, hypot(want[i].r - got[i].r, want[i].i - got[i].i));
+        peak = fmax(peak, hypot(want[i].r, want[i].i));
+    }
+    return e/peak;
+}
+
+static int check(char *name) {
+    int bad = 0;
+    fft_cpx x[2*MAXN], want[2*MAXN], got[2*MAXN];
+    float r[2*MAXN];
+
+    for (int n = 1; n <= MAXN; n++) {
+        for (int inverse = 0; inverse < 2; inverse++) {
+            for (int i = 0; i < n; i++) {
+                x[i].r = rand()/(double)RAND_MAX - 0.5;
+                x[i].i = rand()/(double)RAND_MAX - 0.5;
+            }
+            dft(n, inverse, x, want);
+
+            fft(n, inverse, x, got);
+            double e = error(n, want, got);
+            fft(n, inverse, x, x);
+            e = fmax(e, error(n, want, x));
+            if ( e > TOLERANCE ) {
+                fprintf(stderr, "%s: complex n=%d%s off by %g\n", name, n, inverse ? " inverse" : "", e);
+                bad++;
+            }
+        }
+
+        int rn = 2*n;
+        for (int i = 0; i < rn; i++) {
+            x[i].r = r[i] = rand()/(double)RAND_MAX - 0.5;
+            x[i].i = 0;
+        }
+        dft(rn, false, x, want);
+        fftr(rn, r, got);
+        double e = error(rn/2+1, want, got);
+        fftri(rn, got, r);
+        for (int i = 0; i < rn; i++)
+            e = fmax(e, fabs(r[i]/rn - x[i].r));
+        if ( e > TOLERANCE ) {
+            fprintf(stderr, "%s: real n=%d off by %g\n", name, rn, e);
+            bad++;
+        }
+    }
+
+    return bad;
+}
+
+int main(void) {
+    int bad = 0;
+    if ( set_fft_backend(fft_kiss) )
+        bad += check("kiss");
+    if ( set_fft_backend(fft_stockham) )
+        bad += check("stockham");
+    if ( set_fft_backend(fft_fftw) )
+        bad += check("fftw");
+
+    if ( bad )
+        return 1;
+    printf("fft_small: ok\n");
+    return 0;
+}
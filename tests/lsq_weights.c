@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2010 Jack Christopher Kastorff
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions, and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name Chris Kastorff may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ */
+
+/*
+ * Least squares designs whose weights stop partway up the band, leaving the
+ * rest don't-care. A flat curve has the unit impulse as its exact answer at
+ * any length; the RIAA curve has to come out finite and close in the
+ * weighted band. Exits nonzero on any failure.
+ */
+
+#include "../src/mkfilter/lsq.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define PI 3.1415926535897932384626433832795028841971693993
+
+// the zero phase response of an odd length symmetric filter at f
+static double response(audiobuf *buf, double f) {
+    int center = buf->len/2;
+    double w = 2*PI*f/buf->sr;
+    double h = buf->td[center];
+    for (int k = 1; k <= center; k++)
+        h += 2*buf->td[center+k] * cos(w*k);
+    return h;
+}
+
+// the largest error against the curve up to top
+static double band_error(audiobuf *buf, wantcurve *curve, double top) {
+    double e = 0;
+    for (int i = 0; i <= 1000; i++) {
+        double f = top*i/1000;
+        double h = response(buf, f);
+        if ( isnan(h) )
+            return INFINITY;
+        e = fmax(e, fabs(h - wantcurve_power_at(curve, f)));
+    }
+    return e;
+}
+
+static int check_flat(void) {
+    int bad = 0;
+    wantcurve *flat = read_wantcurve_from_string("0 1\n24000 1\n");
+    wantcurve *weights = read_wantcurve_from_string("0 1\n4000 1\n4001 0\n24000 0\n");
+
+    int lens[] = { 21, 31, 51, 101, 401 };
+    for (int l = 0; l < (int)(sizeof(lens)/sizeof(*lens)); l++) {
+        audiobuf *buf = make_lsq(48000, flat, weights, lens[l]);
+        double e = 0;
+        for (int i = 0; i < buf->len; i++)
+            e = fmax(e, fabs(buf->td[i] - (i == buf->len/2)));
+        if ( !(e < 1e-4) ) {
+            fprintf(stderr, "lsq_weights: flat at %d taps is %g off an impulse\n", lens[l], e);
+            bad++;
+        }
+        free_buf(buf);
+    }
+
+    free_wantcurve(flat);
+    free_wantcurve(weights);
+    return bad;
+}
+
+// the largest response anywhere
+static double peak_gain(audiobuf *buf) {
+    double peak = 0;
+    for (int i = 0; i <= 1000; i++)
+        peak = fmax(peak, fabs(response(buf, buf->sr/2.0*i/1000)));
+    return peak;
+}
+
+static int check_riaa(char *path) {
+    int bad = 0;
+    wantcurve *riaa = read_wantcurve_from_path(path);
+    wantcurve *weights = read_wantcurve_from_string("0 1\n20000 1\n20001 0\n48000 0\n");
+
+    int lens[] = { 31, 63, 127, 255, 1023 };
+    for (int l = 0; l < (int)(sizeof(lens)/sizeof(*lens)); l++) {
+        // weighting only the band has to fit it at least as well as
+        // weighting everything, and stay bounded above it
+        audiobuf *band = make_lsq(96000, riaa, weights, lens[l]);
+        audiobuf *full = make_lsq(96000, riaa, NULL, lens[l]);
+        double e = band_error(band, riaa, 20000);
+        double efull = band_error(full, riaa, 20000);
+        double peak = peak_gain(band);
+        if ( !(e <= efull*1.001) || !(peak < 2) ) {
+            fprintf(stderr, "lsq_weights: riaa at %d taps is %g off in the weighted band (%g weighting "
+                            "everything), peak gain %g\n", lens[l], e, efull, peak);
+            bad++;
+        }
+        free_buf(band);
+        free_buf(full);
+    }
+
+    free_wantcurve(riaa);
+    free_wantcurve(weights);
+    return bad;
+}
+
+int main(int argc, char **argv) {
+    int bad = check_flat();
+    bad += check_riaa(argc > 1 ? argv[1] : "extra/riaa-playback-curve");
+
+    if ( bad )
+        return 1;
+    printf("lsq_weights: ok\n");
+    return 0;
+}